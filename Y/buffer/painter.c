@@ -30,6 +30,8 @@ painterCreate ()
   self -> c = NULL;
   self -> buffer = NULL;
   self -> state -> blendMode = COLOUR_BLEND_SOURCE_OVER;
+  self -> state -> blendOperator =
+    colourspanGetOperator (COLOUR_BLEND_SOURCE_OVER);
   self -> state -> penColour = 0xFF000000;
   self -> state -> fillColour = 0;
   self -> state -> scaleX = 1.0;
@@ -111,7 +113,7 @@ painterScale (struct Painter *self, double x, double y)
 }
 
 void
-painterClipTo (struct Painter *self, struct Rectangle *rect)
+painterClipTo (struct Painter *self, const struct Rectangle *rect)
 {
   struct Rectangle rectT = { rect->x, rect->y, rect->w, rect->h };
   painterTransformCoordinates (self, &rectT.x, &rectT.y, &rectT.w, &rectT.h);
@@ -184,7 +186,14 @@ painterClipCoordinates (struct Painter *self, int *x_p, int *y_p,
 void
 painterSetBlendMode (struct Painter *self, enum ColourBlendMode mode)
 {
+  const struct ColourSpanOperator *op = colourspanGetOperator (mode);
+  if (op == NULL)
+    {
+      Y_WARN ("Unknown blend mode %d", mode);
+      return;
+    }
   self -> state -> blendMode = mode;
+  self -> state -> blendOperator = op;
 }
 
 void
@@ -42,7 +42,7 @@ void     painterRestoreState (struct Painter *);
 void     painterTranslate (struct Painter *, double x, double y);
 void     painterScale (struct Painter *, double x, double y);
 
-void     painterClipTo (struct Painter *, struct Rectangle *);
+void     painterClipTo (struct Painter *, const struct Rectangle *);
 void     painterEnter (struct Painter *, struct Rectangle *);
 
 struct Rectangle *
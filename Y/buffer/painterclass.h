@@ -24,10 +24,12 @@ struct PainterClass;
 #include <Y/y.h>
 #include <Y/buffer/painter.h>
 #include <Y/util/colour.h>
+#include <Y/util/colourspan.h>
 
 struct PainterState
 {
   enum ColourBlendMode blendMode;
+  const struct ColourSpanOperator *blendOperator;
   uint32_t penColour, fillColour;
   double scaleX, scaleY, translateX, translateY;
   int clipping;
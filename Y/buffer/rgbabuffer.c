@@ -16,16 +16,26 @@
  *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
  */
 
+/* for the memfd seals */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <Y/buffer/rgbabuffer.h>
 #include <Y/buffer/bufferclass.h>
 #include <Y/buffer/painterclass.h>
 #include <Y/util/yutil.h>
 #include <Y/util/colour.h>
+#include <Y/util/region.h>
 
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* the minimum size of data in memory */
 #define RGBABUFFER_MIN_SIZE  64
@@ -36,6 +46,14 @@ struct RGBABuffer
   int dataWidth;
   int dataHeight;
   uint32_t *data;
+  /* non-zero if data is a read-only mapping of the client's memory */
+  size_t mappedLength;
+
+  /* pixels that may not be opaque; the buffer is opaque when this is
+   * empty */
+  struct Region *translucent;
+  /* some of the translucent region is known to have alpha */
+  bool hasAlpha;
 };
 
 
@@ -65,6 +83,14 @@ static void rgbabufferPDrawRGBAData   (struct Painter *painter,
                                        uint32_t *data,
                                        int x, int y, int w, int h, int s);
 
+static void rgbabufferScanOpacity (struct RGBABuffer *);
+
+static inline bool
+colourIsOpaque (uint32_t colour)
+{
+  return (colour & 0xFF000000) == 0xFF000000;
+}
+
 static struct PainterClass rgbabufferPainterClass =
 {
   name:             "RGBABuffer/Painter",
@@ -95,6 +121,9 @@ rgbabufferCreate ()
   self->dataWidth = RGBABUFFER_MIN_SIZE;
   self->dataHeight = RGBABUFFER_MIN_SIZE;
   self->data = ymalloc (self->dataWidth * self->dataHeight * sizeof (uint32_t));
+  self->mappedLength = 0;
+  self->translucent = regionCreate ();
+  self->hasAlpha = false;
   return self;
 }
 
@@ -108,6 +137,62 @@ rgbabufferCreateFromData (int w, int h, int dw, int dh, uint32_t *data)
   self->dataWidth = dw;
   self->dataHeight = dh;
   self->data = data;
+  self->mappedLength = 0;
+  self->translucent = regionCreate ();
+  rgbabufferScanOpacity (self);
+  return self;
+}
+
+struct RGBABuffer *
+rgbabufferCreateFromSharedMemory (int fd, int w, int h, int stride)
+{
+  struct RGBABuffer *self;
+  struct stat st;
+  size_t length;
+  void *data;
+
+  if (w <= 0 || h <= 0 || stride < w || stride > INT32_MAX / 4 / h)
+    {
+      Y_WARN ("bad shared image dimensions %dx%d (stride %d)", w, h, stride);
+      return NULL;
+    }
+  length = (size_t)stride * h * sizeof (uint32_t);
+
+  /* the client must not be able to shrink the memory out from under us,
+   * or reading it would fault */
+#ifdef F_GET_SEALS
+  int seals = fcntl (fd, F_GET_SEALS);
+  if (seals == -1 || !(seals & F_SEAL_SHRINK))
+    {
+      Y_WARN ("shared image memory is not sealed against shrinking");
+      return NULL;
+    }
+#endif
+  if (fstat (fd, &st) != 0 || (size_t)st.st_size < length)
+    {
+      Y_WARN ("shared image memory is smaller than %dx%d (stride %d)",
+              w, h, stride);
+      return NULL;
+    }
+
+  data = mmap (NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    {
+      Y_WARN ("could not map shared image: %s", strerror (errno));
+      return NULL;
+    }
+
+  self = ymalloc (sizeof (struct RGBABuffer));
+  bufferInitialise (&(self->buffer), &rgbabufferBufferClass);
+  self->buffer.width = w;
+  self->buffer.height = h;
+  self->dataWidth = stride;
+  self->dataHeight = h;
+  self->data = data;
+  self->mappedLength = length;
+  self->translucent = regionCreate ();
+  /* the client can change it at any time */
+  rgbabufferSetOpacity (self, RGBABUFFER_OPACITY_UNKNOWN);
   return self;
 }
 
@@ -123,13 +208,141 @@ rgbabufferAccessInternals (struct RGBABuffer *self, int *dw_p, int *dh_p,
     *data_p = self->data;
 }
 
+enum RGBABufferOpacity
+rgbabufferGetOpacity (struct RGBABuffer *self)
+{
+  if (regionIsEmpty (self->translucent))
+    return RGBABUFFER_OPACITY_OPAQUE;
+  else if (self->hasAlpha)
+    return RGBABUFFER_OPACITY_HAS_ALPHA;
+  else
+    return RGBABUFFER_OPACITY_UNKNOWN;
+}
+
+struct Region *
+rgbabufferGetOpaqueRegion (struct RGBABuffer *self)
+{
+  struct Rectangle r = { 0, 0, self->buffer.width, self->buffer.height };
+  struct Region *opaque = regionCreateRectangle (&r);
+  regionSubtract (opaque, opaque, self->translucent);
+  return opaque;
+}
+
+void
+rgbabufferSetOpacity (struct RGBABuffer *self, enum RGBABufferOpacity opacity)
+{
+  struct Rectangle r = { 0, 0, self->buffer.width, self->buffer.height };
+  regionClear (self->translucent);
+  if (opacity != RGBABUFFER_OPACITY_OPAQUE)
+    regionUnionRectangle (self->translucent, &r);
+  self->hasAlpha = (opacity == RGBABUFFER_OPACITY_HAS_ALPHA);
+}
+
+void
+rgbabufferCopyRegion (struct RGBABuffer *dest, struct RGBABuffer *src,
+                      const struct Region *region)
+{
+  const struct Rectangle *rects;
+  struct Region *translucent;
+  int count;
+
+  rects = regionGetRectangles (region, &count);
+  if (count == 0)
+    return;
+  for (int i = 0; i < count; ++i)
+    for (int j = 0; j < rects[i].h; ++j)
+      memcpy (dest->data + dest->dataWidth * (rects[i].y + j) + rects[i].x,
+              src->data + src->dataWidth * (rects[i].y + j) + rects[i].x,
+              rects[i].w * sizeof (uint32_t));
+
+  /* the copied pixels bring their opacity with them */
+  translucent = regionCreate ();
+  regionIntersect (translucent, src->translucent, region);
+  regionSubtract (dest->translucent, dest->translucent, region);
+  regionUnion (dest->translucent, dest->translucent, translucent);
+  regionDestroy (translucent);
+  dest->hasAlpha = false;
+
+  bufferNotifyModified (&(dest->buffer));
+}
+
+/* Work out the opacity of data that came from elsewhere. */
+static void
+rgbabufferScanOpacity (struct RGBABuffer *self)
+{
+  const uint32_t *line = self->data;
+  for (int j = 0; j < self->buffer.height; ++j, line += self->dataWidth)
+    for (int i = 0; i < self->buffer.width; ++i)
+      if (!colourIsOpaque (line[i]))
+        {
+          rgbabufferSetOpacity (self, RGBABUFFER_OPACITY_HAS_ALPHA);
+          return;
+        }
+  rgbabufferSetOpacity (self, RGBABUFFER_OPACITY_OPAQUE);
+}
+
+/* Update the opacity after the pixels in the given rectangle have been
+ * blended with MODE, from a source that is OPAQUE or possibly not.
+ */
+static void
+rgbabufferNoteDrawn (struct RGBABuffer *self, enum ColourBlendMode mode,
+                     bool opaque, int x, int y, int w, int h)
+{
+  struct Rectangle r = { x, y, w, h };
+  struct Rectangle bounds = { 0, 0, self->buffer.width, self->buffer.height };
+
+  if (!rectangleIntersect (&r, &r, &bounds) || r.w <= 0 || r.h <= 0)
+    return;
+
+  switch (mode)
+    {
+    case COLOUR_BLEND_SOURCE:
+    case COLOUR_BLEND_SOURCE_OVER:
+    case COLOUR_BLEND_DEST_OVER:
+    case COLOUR_BLEND_DEST_ATOP:
+      /* an opaque source leaves opaque pixels behind, whatever was
+       * there before */
+      if (opaque)
+        {
+          regionSubtractRectangle (self->translucent, &r);
+          self->hasAlpha = false;
+          return;
+        }
+      break;
+    case COLOUR_BLEND_SOURCE_IN:
+    case COLOUR_BLEND_DEST_IN:
+      if (opaque)
+        return;
+      break;
+    default:
+      break;
+    }
+
+  switch (mode)
+    {
+    case COLOUR_BLEND_DEST:
+    case COLOUR_BLEND_SOURCE_OVER:
+    case COLOUR_BLEND_SOURCE_ATOP:
+    case COLOUR_BLEND_DEST_OVER:
+      /* opaque pixels stay opaque, whatever the source */
+      break;
+    default:
+      regionUnionRectangle (self->translucent, &r);
+      break;
+    }
+}
+
 void
 rgbabufferDestroy (struct RGBABuffer *self)
 {
   if (self)
     {
       bufferFinalise (&(self->buffer));
-      yfree (self->data);
+      regionDestroy (self->translucent);
+      if (self->mappedLength > 0)
+        munmap (self->data, self->mappedLength);
+      else
+        yfree (self->data);
       yfree (self);
     }
 }
@@ -156,12 +369,19 @@ void
 rgbabufferBSetSize (struct Buffer *self_b, int w, int h)
 {
   struct RGBABuffer *self = (struct RGBABuffer *)self_b;
+  struct Rectangle r = { 0, 0, w, h };
   int dw = RGBABUFFER_MIN_SIZE;
   int dh = RGBABUFFER_MIN_SIZE;
 
   if (self->buffer.width == w && self->buffer.height == h)
     return;
 
+  if (self->mappedLength > 0)
+    {
+      Y_WARN ("cannot resize a shared image");
+      return;
+    }
+
   bufferNotifyModified (&(self->buffer));
 
   while (dw < w)
@@ -175,6 +395,25 @@ rgbabufferBSetSize (struct Buffer *self_b, int w, int h)
       memset(self->data, 0, dw * dh * sizeof(uint32_t));
       self->dataWidth = dw;
       self->dataHeight = dh;
+      self->buffer.width = w;
+      self->buffer.height = h;
+      rgbabufferSetOpacity (self, RGBABUFFER_OPACITY_HAS_ALPHA);
+      return;
+    }
+
+  /* anything uncovered by growing holds stale data */
+  regionIntersectRectangle (self->translucent, &r);
+  if (w > self->buffer.width)
+    {
+      struct Rectangle right = { self->buffer.width, 0,
+                                 w - self->buffer.width, h };
+      regionUnionRectangle (self->translucent, &right);
+    }
+  if (h > self->buffer.height)
+    {
+      struct Rectangle bottom = { 0, self->buffer.height,
+                                  w, h - self->buffer.height };
+      regionUnionRectangle (self->translucent, &bottom);
     }
   self->buffer.width = w;
   self->buffer.height = h;
@@ -197,9 +436,14 @@ rgbabufferBRender (struct Buffer *self_b, struct Renderer *renderer,
                    int x, int y)
 {
   struct RGBABuffer *self = (struct RGBABuffer *)self_b;
-  rendererBlitRGBAData (renderer, x, y, self->data,
-                        self->buffer.width, self->buffer.height,
-                        self->dataWidth);
+  if (regionIsEmpty (self->translucent))
+    rendererCopyRGBAData (renderer, x, y, self->data,
+                          self->buffer.width, self->buffer.height,
+                          self->dataWidth);
+  else
+    rendererBlitRGBAData (renderer, x, y, self->data,
+                          self->buffer.width, self->buffer.height,
+                          self->dataWidth);
 }
 
 void
@@ -238,6 +482,12 @@ rgbabufferPClearRectangle (struct Painter *painter, int x, int y, int w, int h)
       line += self->dataWidth;
     }
 
+  rgbabufferNoteDrawn (self, COLOUR_BLEND_SOURCE,
+                       colourIsOpaque (painter->state->fillColour),
+                       x, y, w, h);
+  if (!colourIsOpaque (painter->state->fillColour) && w > 0 && h > 0)
+    self->hasAlpha = true;
+
   bufferNotifyModified (&(self->buffer));
 }
 
@@ -248,7 +498,7 @@ rgbabufferPDrawRectangle (struct Painter *painter, int x, int y, int w, int h)
   /* fill the rectangle with the fill colour, and stroke with the pen colour */
   int xc = x, yc = y, wc = w, hc = h;
   uint32_t *line;
-  int i, j;
+  int j;
   int strokeLeft = 1, strokeRight = 1, strokeTop = 1, strokeBottom = 1;
   if (painterClipCoordinates (painter, &xc, &yc, &wc, &hc))
     {
@@ -276,15 +526,13 @@ rgbabufferPDrawRectangle (struct Painter *painter, int x, int y, int w, int h)
 
       if (w > 0)
         {
-          colourBlend (data, *data, colourLeft,
-                       0xFF, painter->state->blendMode);
+          painter->state->blendOperator->fill (data, colourLeft, 1);
           ++data;
         }
       if (colourCentre & 0xFF000000)
         {
-          for (i = 1; i < wc-1; ++i, ++data)
-          colourBlend (data, *data, colourCentre,
-                       0xFF, painter->state->blendMode);
+          painter->state->blendOperator->fill (data, colourCentre, wc-2);
+          data += MAX (wc-2, 0);
         }
       else
         {
@@ -292,13 +540,17 @@ rgbabufferPDrawRectangle (struct Painter *painter, int x, int y, int w, int h)
         }
       if (w > 1)
         {
-          colourBlend (data, *data, colourRight,
-                       0xFF, painter->state->blendMode);
+          painter->state->blendOperator->fill (data, colourRight, 1);
           ++data;
         }
       line += self->dataWidth;
     }
 
+  rgbabufferNoteDrawn (self, painter->state->blendMode,
+                       colourIsOpaque (painter->state->penColour)
+                       && colourIsOpaque (painter->state->fillColour),
+                       xc, yc, wc, hc);
+
   bufferNotifyModified (&(self->buffer));
 }
 
@@ -307,7 +559,6 @@ rgbabufferPDrawHLine (struct Painter *painter, int x, int y, int dx)
 {
   struct RGBABuffer *self = (struct RGBABuffer *)painter->buffer;
   uint32_t *data;
-  int i;
   int hc = 1;
 
   painterClipCoordinates (painter, &x, &y, &dx, &hc);
@@ -317,12 +568,11 @@ rgbabufferPDrawHLine (struct Painter *painter, int x, int y, int dx)
  
   data = self->data + self->dataWidth * y + x;
 
-  for (i=0; i<dx; ++i)
-    {
-      colourBlend (data, *data, painter->state->penColour,
-                   0xFF, painter->state->blendMode);
-      ++data;
-    }
+  painter->state->blendOperator->fill (data, painter->state->penColour, dx);
+
+  rgbabufferNoteDrawn (self, painter->state->blendMode,
+                       colourIsOpaque (painter->state->penColour),
+                       x, y, dx, hc);
 
   bufferNotifyModified (&(self->buffer));
 }
@@ -331,6 +581,7 @@ void
 rgbabufferPDrawVLine (struct Painter *painter, int x, int y, int dy)
 {
   struct RGBABuffer *self = (struct RGBABuffer *)painter->buffer;
+  const struct ColourSpanOperator *op = painter->state->blendOperator;
   uint32_t *data;
   int i;
   int wc = 1;
@@ -344,11 +595,14 @@ rgbabufferPDrawVLine (struct Painter *painter, int x, int y, int dy)
 
   for (i=0; i < dy; ++i)
     {
-      colourBlend (data, *data, painter->state->penColour,
-                   0xFF, painter->state->blendMode);
+      op->fill (data, painter->state->penColour, 1);
       data += self->dataWidth;
     }
 
+  rgbabufferNoteDrawn (self, painter->state->blendMode,
+                       colourIsOpaque (painter->state->penColour),
+                       x, y, wc, dy);
+
   bufferNotifyModified (&(self->buffer));
 }
 
@@ -362,6 +616,7 @@ rgbabufferPDrawLine (struct Painter *painter, int x, int y, int dx, int dy)
   int xc, yc, wc, hc;
   int xp = x;
   int yp = y;
+  const struct ColourSpanOperator *op = painter->state->blendOperator;
 
   xc = dx < 0 ? x + dx : x;
   yc = dy < 0 ? y + dy : y;
@@ -387,8 +642,7 @@ rgbabufferPDrawLine (struct Painter *painter, int x, int y, int dx, int dy)
         {
 	  if (xp >= xc && xp <= xc + wc &&
 	      yp >= yc && yp <= yc + hc)
-            colourBlend (data, *data, painter->state->penColour,
-                         0xFF, painter->state->blendMode);
+            op->fill (data, painter->state->penColour, 1);
           er += dy;
           if (er >= 0)
             {
@@ -409,8 +663,7 @@ rgbabufferPDrawLine (struct Painter *painter, int x, int y, int dx, int dy)
         {
 	  if (xp >= xc && xp <= xc + wc &&
 	      yp >= yc && yp <= yc + hc)
-            colourBlend (data, *data, painter->state->penColour,
-                         0xFF, painter->state->blendMode);
+            op->fill (data, painter->state->penColour, 1);
           er += dx;
           if (er >= 0)
             {
@@ -423,6 +676,10 @@ rgbabufferPDrawLine (struct Painter *painter, int x, int y, int dx, int dy)
         }
     }
 
+  /* a sloping line only plots some of the pixels in its box */
+  rgbabufferNoteDrawn (self, painter->state->blendMode, false,
+                       xc, yc, wc + 1, hc + 1);
+
   bufferNotifyModified (&(self->buffer));
 }
 
@@ -433,7 +690,7 @@ rgbabufferPDrawAlphamap (struct Painter *painter, uint8_t *alpha,
   struct RGBABuffer *self = (struct RGBABuffer *)painter->buffer;
   uint32_t *dline;
   uint8_t *sline;
-  int i,j;
+  int j;
   int xc = x, yc = y, wc = w, hc = h;
  
   painterClipCoordinates (painter, &xc, &yc, &wc, &hc);
@@ -443,19 +700,15 @@ rgbabufferPDrawAlphamap (struct Painter *painter, uint8_t *alpha,
  
   for (j=0; j<hc; ++j)
     {
-      uint32_t *dest = dline;
-      uint8_t *src = sline;
-      for (i=0; i<wc; ++i)
-        {
-          colourBlend (dest, *dest, painter->state->penColour,
-                       ((uint32_t)*src), painter->state->blendMode);
-          ++dest;
-          ++src;
-        }
+      painter->state->blendOperator->mask (dline, painter->state->penColour,
+                                           sline, wc);
       dline += self->dataWidth;
       sline += s;
     }
 
+  rgbabufferNoteDrawn (self, painter->state->blendMode, false,
+                       xc, yc, wc, hc);
+
   bufferNotifyModified (&(self->buffer));
 }
 
@@ -466,7 +719,7 @@ rgbabufferPDrawRGBAData (struct Painter *painter, uint32_t *data,
   struct RGBABuffer *self = (struct RGBABuffer *)painter->buffer;
   uint32_t *dline;
   uint32_t *sline;
-  int i,j;
+  int j;
   int xc = x, yc = y, wc = w, hc = h;
  
   painterClipCoordinates (painter, &xc, &yc, &wc, &hc);
@@ -476,19 +729,14 @@ rgbabufferPDrawRGBAData (struct Painter *painter, uint32_t *data,
  
   for (j=0; j<hc; ++j)
     {
-      uint32_t *dest = dline;
-      uint32_t *src = sline;
-      for (i=0; i<wc; ++i)
-        {
-          colourBlend (dest, *dest, *src, 0xFF,
-                       painter->state->blendMode);
-          ++dest;
-          ++src;
-        }
+      painter->state->blendOperator->blend (dline, sline, wc);
       dline += self->dataWidth;
       sline += s;
     }
 
+  rgbabufferNoteDrawn (self, painter->state->blendMode, false,
+                       xc, yc, wc, hc);
+
   bufferNotifyModified (&(self->buffer));
 }
 
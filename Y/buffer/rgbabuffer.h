@@ -23,6 +23,7 @@ struct RGBABuffer;
 
 #include <Y/y.h>
 #include <Y/util/rectangle.h>
+#include <Y/util/region.h>
 #include <Y/screen/renderer.h>
 #include <stdint.h>
 
@@ -43,11 +44,50 @@ struct RGBABuffer * rgbabufferCreate (void);
 struct RGBABuffer * rgbabufferCreateFromData (int w, int h, int dw, int dh,
                                               uint32_t *data);
 
+/** \brief create a read-only RGBA buffer from a client's shared memory
+ * \param fd     a memfd sealed against shrinking, holding \p h rows of
+ *               \p stride pixels; the caller keeps ownership of it
+ * \param w      the width of the image
+ * \param h      the height of the image
+ * \param stride the distance between rows, in pixels
+ * \returns NULL if the memory cannot be used
+ *
+ * The pixels are read straight from the client's memory whenever the
+ * buffer is drawn.  The buffer must not be painted on or resized.
+ */
+struct RGBABuffer * rgbabufferCreateFromSharedMemory (int fd, int w, int h,
+                                                      int stride);
+
 void rgbabufferDestroy   (struct RGBABuffer *);
 
 void rgbabufferAccessInternals (struct RGBABuffer *,
                                 int *dw_p, int *dh_p, uint32_t **data_p);
 
+/* What is known about the alpha channel of the buffer's contents.  The
+ * painter operations keep this up to date; anyone who changes the data
+ * by other means must call rgbabufferSetOpacity afterwards.
+ */
+enum RGBABufferOpacity
+{
+  RGBABUFFER_OPACITY_UNKNOWN,
+  RGBABUFFER_OPACITY_OPAQUE,     /* every pixel has alpha 0xFF */
+  RGBABUFFER_OPACITY_HAS_ALPHA   /* some pixels are translucent */
+};
+
+enum RGBABufferOpacity rgbabufferGetOpacity (struct RGBABuffer *);
+void rgbabufferSetOpacity (struct RGBABuffer *, enum RGBABufferOpacity);
+
+/* A new region of the pixels known to be opaque: the whole buffer,
+ * less anything that may be translucent.
+ */
+struct Region *rgbabufferGetOpaqueRegion (struct RGBABuffer *);
+
+/* Copy the pixels in REGION from SRC to the same place in DEST.  Both
+ * buffers must already be large enough to contain REGION.
+ */
+void rgbabufferCopyRegion (struct RGBABuffer *dest, struct RGBABuffer *src,
+                           const struct Region *region);
+
 struct Buffer *rgbabufferToBuffer (struct RGBABuffer *);
 
 bool bufferIsRGBABuffer (struct Buffer *);
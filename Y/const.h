@@ -11,6 +11,32 @@ enum YMessageOperation
   YMO_FIND_CLASS,
   YMO_INVOKE_CLASS_METHOD,
   YMO_INVOKE_INSTANCE_METHOD,
+  /* (string) -> reply with the atom for a method name as its id, or 0
+   * if there isn't one.  The atom can then be sent instead of the name
+   * as the first value of an invocation. */
+  YMO_FIND_ATOM,
+};
+
+/* Operations in a Canvas display list, as sent to Canvas.drawList.
+ * A display list is a sequence of 32 bit words in network byte order:
+ * each operation is followed by the arguments given beside it.
+ */
+enum YCanvasOperation
+{
+  YCO_SAVE_STATE,          /* */
+  YCO_RESTORE_STATE,       /* */
+  YCO_SET_BLEND_MODE,      /* mode */
+  YCO_SET_PEN_COLOUR,      /* colour */
+  YCO_SET_FILL_COLOUR,     /* colour */
+  YCO_CLEAR_RECTANGLE,     /* x, y, w, h */
+  YCO_DRAW_RECTANGLE,      /* x, y, w, h */
+  YCO_DRAW_HLINE,          /* x, y, dx */
+  YCO_DRAW_VLINE,          /* x, y, dy */
+  YCO_DRAW_LINE,           /* x, y, dx, dy */
+  /* x, y, w, h, then w * h bytes of alpha padded to a whole word,
+   * drawn in the pen colour */
+  YCO_DRAW_ALPHAMAP,
+  YCO_LAST
 };
 
 /* The Keyboard Codes are cunningly taken from SDL, since that seems
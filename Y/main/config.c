@@ -200,7 +200,7 @@ parseSignedInteger (const char **c, struct Value *v)
   long int i = strtol(*c, &end, 0);
 
   /* Must be terminated with whitespace */
-  if (!isspace(*c))
+  if (end == *c || (*end != '\0' && !isspace(*end)))
     return false;
 
   *c = end;
@@ -219,7 +219,7 @@ parseUnsignedInteger (const char **c, struct Value *v)
   unsigned long int i = strtoul(*c, &end, 0);
 
   /* Must be terminated with whitespace */
-  if (!isspace(*c))
+  if (end == *c || (*end != '\0' && !isspace(*end)))
     return false;
 
   *c = end;
@@ -20,19 +20,35 @@
 #include <Y/util/yutil.h>
 #include <Y/util/index.h>
 #include <Y/util/pqueue.h>
+#include <Y/util/log.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <signal.h>
-#include <sys/time.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/epoll.h>
 #include <assert.h>
 
 static int controlRunning = 1;
 
+/* the most file descriptors despatched per iteration */
+#define CONTROL_MAX_EVENTS 64
+
 struct ControlFileDescriptor
 {
   int fd;
   int watchMask;
   void *userData;
   void (*callback)(int, int, void *);
+  /* the events it is registered with epoll for, or 0 if it isn't */
+  uint32_t events;
+  /* file descriptors unregistered while despatching are kept on a list
+   * until the end of the iteration, as they may still have events */
+  struct ControlFileDescriptor *nextUnregistered;
 };
 
 static int
@@ -122,27 +138,57 @@ controlSignalHandlerSetDestructorFunction (void *obj_v)
 
 struct ControlTimedEvent
 {
-  struct timeval time;
-  int id;
+  /* when it's due, in microseconds on the monotonic clock */
+  int64_t time;
+  /* the order it was made in */
+  unsigned int sequence;
+  /* its slot in timedEventSlots; the callback is NULL once cancelled */
+  int slot;
   void *userData;
   void (*callback)(void *);
 };
 
-static int nextTimedEventID = 1;
+/* Timers are found from their ids in constant time.  The low bits of
+ * an id are the timer's slot in timedEventSlots, and the rest count the
+ * timers that have used that slot, so that an id kept after its timer
+ * has gone cancels nothing.  Cancelled timers are left in timedEvents,
+ * and thrown away once they reach the front of it.
+ */
+#define CONTROL_TIMER_SLOT_BITS 16
+#define CONTROL_TIMER_SLOT_MASK ((1 << CONTROL_TIMER_SLOT_BITS) - 1)
+#define CONTROL_TIMER_SERIAL_MASK (INT_MAX >> CONTROL_TIMER_SLOT_BITS)
+
+struct ControlTimerSlot
+{
+  struct ControlTimedEvent *event;
+  int serial;
+  /* the next free slot, while this one is free */
+  int nextFree;
+};
+
+static unsigned int nextTimedEventSequence = 0;
+static struct ControlTimerSlot *timedEventSlots = NULL;
+static int timedEventSlotsUsed = 0, timedEventSlotsSize = 0;
+static int firstFreeTimedEventSlot = -1;
 
 static int
 controlTimedEventsComparisonFunction (const void *obj1_v, const void *obj2_v)
 {
   const struct ControlTimedEvent *obj1 = obj1_v;
   const struct ControlTimedEvent *obj2 = obj2_v;
-  if (obj1 -> time.tv_sec == obj2 -> time.tv_sec)
-    {
-       return obj1 -> time.tv_usec - obj2 -> time.tv_usec;
-    }
+  /* events due at the same time happen in the order they were made */
+  if (obj1 -> time != obj2 -> time)
+    return obj1 -> time < obj2 -> time ? -1 : 1;
   else
-    {
-       return obj1 -> time.tv_sec - obj2 -> time.tv_sec;
-    }
+    return (int)(obj1 -> sequence - obj2 -> sequence);
+}
+
+int64_t
+controlGetTime (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * (int64_t)1000000 + now.tv_nsec / 1000;
 }
 
 static void
@@ -153,6 +199,9 @@ controlTimedEventDestructorFunction (void *obj_v)
 
 static struct Index *fileDescriptors, *signalHandlers;
 static struct PQueue *timedEvents; 
+static int epollFD = -1;
+static int despatching = 0;
+static struct ControlFileDescriptor *unregisteredFileDescriptors = NULL;
 
 static void
 exitSignalHandler (int signo, void *userData)
@@ -172,6 +221,13 @@ controlInitialise (void)
                                 controlSignalHandlerSetComparisonFunction);
   timedEvents = pqueueCreate (controlTimedEventsComparisonFunction);
 
+  epollFD = epoll_create1 (EPOLL_CLOEXEC);
+  if (epollFD == -1)
+    {
+      Y_FATAL ("Could not create epoll instance: %s", strerror (errno));
+      abort ();
+    }
+
   /* Block all the signals, except the ones which we should not handle (fatal errors) */
   sigfillset(&block_mask);
   sigdelset(&block_mask, SIGSTOP);
@@ -195,6 +251,46 @@ controlInitialise (void)
   controlRegisterSignalHandler(SIGINT, NULL, &exitSignalHandler);
 }
 
+/* Bring the epoll registration of a file descriptor up to date with its
+ * watch mask.  A file descriptor that isn't watched for anything is
+ * taken out of the epoll set altogether, since epoll would otherwise
+ * keep reporting hangups and errors on it.
+ */
+static void
+controlUpdateEvents (struct ControlFileDescriptor *obj)
+{
+  struct epoll_event ev;
+  uint32_t events = 0;
+  int op;
+
+  if (obj -> watchMask & CONTROL_WATCH_READ)
+    events |= EPOLLIN;
+  if (obj -> watchMask & CONTROL_WATCH_WRITE)
+    events |= EPOLLOUT;
+  if (obj -> watchMask & CONTROL_WATCH_EXCEPT)
+    events |= EPOLLPRI;
+
+  if (events == obj -> events)
+    return;
+  else if (obj -> events == 0)
+    op = EPOLL_CTL_ADD;
+  else if (events == 0)
+    op = EPOLL_CTL_DEL;
+  else
+    op = EPOLL_CTL_MOD;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.events = events;
+  ev.data.ptr = obj;
+  if (epoll_ctl (epollFD, op, obj -> fd, &ev) == -1)
+    {
+      Y_WARN ("Could not watch file descriptor %d: %s",
+              obj -> fd, strerror (errno));
+      return;
+    }
+  obj -> events = events;
+}
+
 void
 controlRegisterFileDescriptor (int fd, int watchMask, void *userData,
               void (*callback)(int fd, int causeMask, void *userData))
@@ -205,24 +301,39 @@ controlRegisterFileDescriptor (int fd, int watchMask, void *userData,
   obj -> watchMask = watchMask;
   obj -> userData = userData;
   obj -> callback = callback;
+  obj -> events = 0;
+  obj -> nextUnregistered = NULL;
   indexAdd (fileDescriptors, obj);
+  controlUpdateEvents (obj);
 }
 
 void
 controlChangeFileDescriptorMask (int fd, int watchMask)
 {
   struct ControlFileDescriptor *obj = indexFind (fileDescriptors, &fd);
-  if (obj != NULL)
+  if (obj != NULL && obj -> watchMask != watchMask)
     {
       obj -> watchMask = watchMask;
+      controlUpdateEvents (obj);
     }
 }
 
 void
 controlUnregisterFileDescriptor (int fd)
 {
-  void *obj = indexRemove (fileDescriptors, &fd);
-  yfree (obj);
+  struct ControlFileDescriptor *obj = indexRemove (fileDescriptors, &fd);
+  if (obj == NULL)
+    return;
+  obj -> watchMask = 0;
+  controlUpdateEvents (obj);
+  if (despatching)
+    {
+      obj -> callback = NULL;
+      obj -> nextUnregistered = unregisteredFileDescriptors;
+      unregisteredFileDescriptors = obj;
+    }
+  else
+    yfree (obj);
 }
 
 void
@@ -294,153 +405,161 @@ controlPollSignals (void)
       }
 }
 
+static int
+controlAllocateTimerSlot (void)
+{
+  int slot = firstFreeTimedEventSlot;
+  if (slot != -1)
+    {
+      firstFreeTimedEventSlot = timedEventSlots[slot].nextFree;
+      return slot;
+    }
+
+  if (timedEventSlotsUsed == timedEventSlotsSize)
+    {
+      int size = timedEventSlotsSize ? timedEventSlotsSize * 2 : 16;
+      struct ControlTimerSlot *slots;
+      if (size > CONTROL_TIMER_SLOT_MASK + 1)
+        {
+          Y_FATAL ("More than %d timers pending", CONTROL_TIMER_SLOT_MASK + 1);
+          abort ();
+        }
+      slots = ymalloc (sizeof (struct ControlTimerSlot) * size);
+      if (timedEventSlotsUsed > 0)
+        memcpy (slots, timedEventSlots,
+                sizeof (struct ControlTimerSlot) * timedEventSlotsUsed);
+      yfree (timedEventSlots);
+      timedEventSlots = slots;
+      timedEventSlotsSize = size;
+    }
+  slot = timedEventSlotsUsed++;
+  timedEventSlots[slot].serial = 0;
+  return slot;
+}
+
+static void
+controlFreeTimerSlot (int slot)
+{
+  timedEventSlots[slot].event = NULL;
+  timedEventSlots[slot].nextFree = firstFreeTimedEventSlot;
+  firstFreeTimedEventSlot = slot;
+}
+
 int
 controlTimerDelay (int minIntervalSeconds, int minIntervalMilliseconds,
                    void *userData, void (*callback)(void *userData))
 {
-  struct timeval now;
   struct ControlTimedEvent *event;
+  struct ControlTimerSlot *slot;
 
   event = ymalloc (sizeof (struct ControlTimedEvent));
   event -> userData = userData;
   event -> callback = callback;
-  event -> id = nextTimedEventID ++;
-
-  gettimeofday (&now, NULL);
-
-  event -> time.tv_usec = (minIntervalMilliseconds * 1000 + now.tv_usec);
-  event -> time.tv_sec = minIntervalSeconds + now.tv_sec;
-  if (event -> time.tv_usec >= 1000000)
-    {
-      event -> time.tv_sec++;
-      event -> time.tv_usec -= 1000000;
-    }
+  event -> sequence = nextTimedEventSequence ++;
+  event -> time = controlGetTime () + minIntervalSeconds * (int64_t)1000000
+                  + minIntervalMilliseconds * (int64_t)1000;
+  event -> slot = controlAllocateTimerSlot ();
+
+  /* serials start from 1, so that no id is 0 */
+  slot = timedEventSlots + event -> slot;
+  slot -> event = event;
+  slot -> serial = (slot -> serial & CONTROL_TIMER_SERIAL_MASK) + 1;
+  if (slot -> serial > CONTROL_TIMER_SERIAL_MASK)
+    slot -> serial = 1;
 
   pqueueInsert (timedEvents, event); 
 
-  return event -> id;
+  return (slot -> serial << CONTROL_TIMER_SLOT_BITS) | event -> slot;
 }
 
-static int
-controlCancelTimerDelayTestFunction (void *timedEvent_v, void *id_v)
+void
+controlCancelTimerDelay (int id)
 {
-  int *id = id_v;
-  struct ControlTimedEvent *timedEvent = timedEvent_v;
-  if (timedEvent -> id == *id)
-    {
-      yfree(timedEvent);
-      return 1;
-    }
-  else
-    return 0;
+  int slot = id & CONTROL_TIMER_SLOT_MASK;
+
+  if (id <= 0 || slot >= timedEventSlotsUsed
+      || timedEventSlots[slot].event == NULL
+      || timedEventSlots[slot].serial != id >> CONTROL_TIMER_SLOT_BITS)
+    return;
+
+  timedEventSlots[slot].event -> callback = NULL;
+  controlFreeTimerSlot (slot);
 }
 
-void
-controlCancelTimerDelay (int id)
+/* The next timer that hasn't been cancelled, throwing away any that
+ * have on the way */
+static struct ControlTimedEvent *
+controlPeekTimedEvent (void)
 {
-  pqueueRemove (timedEvents, &id, controlCancelTimerDelayTestFunction);  
+  struct ControlTimedEvent *tev;
+  while ((tev = pqueuePeekNext (timedEvents)) != NULL && tev -> callback == NULL)
+    yfree (pqueueGetNext (timedEvents));
+  return tev;
 }
 
 static int
 controlIteration (void)
 {
   struct ControlTimedEvent *tev;
-  struct IndexIterator *iter;
-  struct timeval timeout;
-  int maxFd = 0;
+  struct epoll_event events[CONTROL_MAX_EVENTS];
+  int timeout;
   int retval;
-  fd_set fds[3];
-  FD_ZERO (&fds[0]); 
-  FD_ZERO (&fds[1]);  
-  FD_ZERO (&fds[2]);
 
-  iter = indexGetStartIterator (fileDescriptors);
-  while (indexiteratorHasValue (iter))
-    {
-      struct ControlFileDescriptor *cfd = indexiteratorGet (iter);
-      if (cfd -> watchMask & CONTROL_WATCH_READ)
-        FD_SET (cfd -> fd, &fds[0]);
-      if (cfd -> watchMask & CONTROL_WATCH_WRITE)
-        FD_SET (cfd -> fd, &fds[1]);
-      if (cfd -> watchMask & CONTROL_WATCH_EXCEPT)
-        FD_SET (cfd -> fd, &fds[2]);
-      indexiteratorNext (iter);
-    }
-
-  /* need to find maximum file descriptor */
-  indexiteratorPrevious (iter); /* back up one place */
-  {
-    struct ControlFileDescriptor *cfd = indexiteratorGet (iter);
-    if (cfd != NULL)
-      maxFd = cfd -> fd;
-  }
-  indexiteratorDestroy (iter);
-
-  /* work out time to next poll or timer event */
-  tev = pqueuePeekNext (timedEvents);
+  /* work out time to next poll or timer event, rounding up so that we
+   * don't wake before the timer is due */
+  tev = controlPeekTimedEvent ();
   if (tev)
     {
-      struct timeval now;
-      gettimeofday (&now, NULL);
-      timeout.tv_sec = tev -> time.tv_sec - now.tv_sec;
-      timeout.tv_usec = tev -> time.tv_usec - now.tv_usec;
-      if (timeout.tv_usec < 0)
-        {
-          timeout.tv_sec--;
-          timeout.tv_usec += 1000000;
-        }
+      int64_t delay = tev -> time - controlGetTime ();
+      timeout = delay <= 0 ? 0 : (int)MIN ((delay + 999) / 1000, 5000);
     }
   else
-    {
-      timeout.tv_sec = 5;
-      timeout.tv_usec = 0;
-    }
-
-  /* select () */
-  if (timeout.tv_sec < 0 || (timeout.tv_sec == 0 && timeout.tv_usec == 0))
-    {
-      timeout.tv_sec = 0; timeout.tv_usec = 100; 
-    }
+    timeout = 5000;
 
-  retval = select (maxFd + 1, &fds[0], &fds[1], &fds[2], &timeout);
+  retval = epoll_wait (epollFD, events, CONTROL_MAX_EVENTS, timeout);
+  if (retval == -1 && errno != EINTR)
+    Y_WARN ("epoll_wait failed: %s", strerror (errno));
 
   /* despatch whatever woke us up */
-  if (retval > 0)
+  despatching = 1;
+  for (int i = 0; i < retval; ++i)
     {
-      int i = 0;
-      for (i = 0; i <= maxFd; ++i)
-        {
-          int mask = 0;
-          if (FD_ISSET (i, &fds[0]))
-            mask |= CONTROL_WATCH_READ;
-          if (FD_ISSET (i, &fds[1]))
-            mask |= CONTROL_WATCH_WRITE;
-          if (FD_ISSET (i, &fds[2]))
-            mask |= CONTROL_WATCH_EXCEPT;
-          if (mask)
-            {
-              struct ControlFileDescriptor *cfd = indexFind (fileDescriptors, &i);
-              if (cfd)
-                cfd -> callback (i, mask, cfd -> userData);
-            }
-        }
+      struct ControlFileDescriptor *cfd = events[i].data.ptr;
+      int mask = 0;
+      if (cfd -> callback == NULL)
+        continue;
+      if (events[i].events & EPOLLIN)
+        mask |= CONTROL_WATCH_READ;
+      if (events[i].events & EPOLLOUT)
+        mask |= CONTROL_WATCH_WRITE;
+      if (events[i].events & EPOLLPRI)
+        mask |= CONTROL_WATCH_EXCEPT;
+      /* let the owner find out about errors from the calls it's
+       * waiting to make, as select would have */
+      if (events[i].events & (EPOLLERR | EPOLLHUP))
+        mask |= cfd -> watchMask;
+      if (mask)
+        cfd -> callback (cfd -> fd, mask, cfd -> userData);
+    }
+  despatching = 0;
+  while (unregisteredFileDescriptors != NULL)
+    {
+      struct ControlFileDescriptor *cfd = unregisteredFileDescriptors;
+      unregisteredFileDescriptors = cfd -> nextUnregistered;
+      yfree (cfd);
     }
 
   /* call whatever timers have expired */
-  if ((tev = pqueuePeekNext (timedEvents)) != NULL)
+  if ((tev = controlPeekTimedEvent ()) != NULL)
     {
-      struct timeval now;
-      gettimeofday (&now, NULL);
-      while (now.tv_sec > tev -> time.tv_sec
-             || (now.tv_sec == tev -> time.tv_sec
-                 && now.tv_usec > tev -> time.tv_usec))
+      int64_t now = controlGetTime ();
+      while (tev != NULL && tev -> time <= now)
         {
-          tev = pqueueGetNext (timedEvents);
+          pqueueGetNext (timedEvents);
+          controlFreeTimerSlot (tev -> slot);
           tev -> callback (tev -> userData);
           yfree (tev);
-          tev = pqueuePeekNext (timedEvents);
-          if (tev == NULL)
-            break;
+          tev = controlPeekTimedEvent ();
         }
     }
 
@@ -468,6 +587,12 @@ controlFinalise (void)
   indexDestroy (fileDescriptors, controlFileDescriptorsDestructorFunction);
   indexDestroy (signalHandlers, controlSignalHandlerSetDestructorFunction);
   pqueueDestroy (timedEvents, controlTimedEventDestructorFunction);
+  yfree (timedEventSlots);
+  timedEventSlots = NULL;
+  timedEventSlotsUsed = timedEventSlotsSize = 0;
+  firstFreeTimedEventSlot = -1;
+  close (epollFD);
+  epollFD = -1;
 }
 
 /* arch-tag: 902f698b-690f-44a7-a931-588a000282db
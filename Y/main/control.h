@@ -20,6 +20,7 @@
 #define Y_CONTROL_CONTROL_H
 
 #include <Y/y.h>
+#include <stdint.h>
 
 void controlInitialise (void);
 
@@ -38,6 +39,11 @@ int  controlTimerDelay (int minIntervalSeconds, int minIntervalMilliseconds,
                         void *userData, void (*callback)(void *userData));
 void controlCancelTimerDelay (int id);
 
+/* The time now in microseconds on the clock timers are measured by,
+ * which only ever goes forwards whatever happens to the time of day.
+ */
+int64_t controlGetTime (void);
+
 void controlRegisterSignalHandler (int signo, void *userData,
                                    void (*callback)(int signo, void *userData));
 void controlUnregisterSignalHandler (int signo, void *userData,
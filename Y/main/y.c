@@ -39,6 +39,7 @@
 #include <Y/text/font.h>
 #include <Y/util/yutil.h>
 #include <Y/util/dbuffer.h>
+#include <Y/util/atom.h>
 #include <Y/message/client.h>
 
 #include <Y/widget/window.h>
@@ -55,6 +56,7 @@ final (void)
   ykbFinalise ();
   keymapFinalise ();
   classFinalise ();
+  atomFinalise ();
   fontFinalise ();
   screenFinalise ();
   controlFinalise ();
@@ -235,7 +237,7 @@ main (int argc, char **argv)
   serverConfig = configRead (configFile);;
 
   controlInitialise ();
-  screenInitialise ();
+  screenInitialise (serverConfig);
   fontInitialise (serverConfig);
   classInitialise ();
   clientInitialise ();
@@ -21,6 +21,7 @@
 #include <Y/message/message.h>
 #include <Y/util/index.h>
 #include <Y/util/yutil.h>
+#include <Y/util/log.h>
 
 #include <Y/object/class.h>
 
@@ -29,6 +30,16 @@
 #include <netinet/in.h>
 #include <assert.h>
 
+/* the most file descriptors held for messages not yet despatched */
+#define CLIENT_MAX_QUEUED_FDS 16
+
+struct QueuedFileDescriptor
+{
+  int fd;
+  /* position in the stream of the last byte that came with it */
+  uint64_t pos;
+};
+
 struct SignalSubscription
 {
   char *name;
@@ -86,6 +97,19 @@ signalsubscriptionDestructorFunction (void *obj)
   yfree(sig);
 }
 
+/* close any queued descriptors that arrived before stream position END */
+static void
+clientDiscardFileDescriptors (struct Client *c, uint64_t end)
+{
+  struct QueuedFileDescriptor q;
+  while (dbuffer_get(c->fdq, (char *)&q, sizeof(q)) == sizeof(q)
+         && q.pos < end)
+    {
+      dbuffer_remove(c->fdq, sizeof(q));
+      close (q.fd);
+    }
+}
+
 static void
 clientDestructorFunction (void *obj)
 {
@@ -94,6 +118,8 @@ clientDestructorFunction (void *obj)
   indexDestroy (c -> signals, signalsubscriptionDestructorFunction);
   free_dbuffer(c -> recvq);
   free_dbuffer(c -> sendq);
+  clientDiscardFileDescriptors (c, UINT64_MAX);
+  free_dbuffer(c -> fdq);
   c -> c -> close (c);
 }
 
@@ -119,6 +145,8 @@ clientRegister (struct Client *c)
   c -> signals = indexCreate (signalsubscriptionComparisonFunction, signalsubscriptionComparisonFunction);
   c -> recvq = new_dbuffer();
   c -> sendq = new_dbuffer();
+  c -> recvpos = 0;
+  c -> fdq = new_dbuffer();
   indexAdd (clients, c);
 }
 
@@ -161,17 +189,42 @@ clientSendMessage (struct Client *c, struct Message *m)
   if (c == NULL)
     return;
 
-  char *buf;
-  size_t len;
-  messageToString(m, &buf, &len);
+  /* measure the message, then encode it straight into the send queue */
+  size_t len = messageEncodedLength(m);
   uint32_t nlen = htonl(len);
   dbuffer_add(c->sendq, (char *)&nlen, sizeof(nlen));
-  dbuffer_add(c->sendq, buf, len);
-  yfree(buf);
+  messageToDBuffer(m, c->sendq);
   c -> c -> writeData (c, len);
 }
 
 void
+clientQueueFileDescriptor (struct Client *c, int fd)
+{
+  struct QueuedFileDescriptor q = { fd, c->recvpos + dbuffer_len(c->recvq) - 1 };
+  if (dbuffer_len(c->fdq) >= CLIENT_MAX_QUEUED_FDS * sizeof(q))
+    {
+      Y_WARN ("Client %d has too many file descriptors queued; "
+              "discarding one", c->id);
+      close (fd);
+      return;
+    }
+  dbuffer_add(c->fdq, (char *)&q, sizeof(q));
+}
+
+int
+clientTakeFileDescriptor (struct Client *c)
+{
+  struct QueuedFileDescriptor q;
+  if (c == NULL || dbuffer_get(c->fdq, (char *)&q, sizeof(q)) < sizeof(q))
+    return -1;
+  /* recvpos is past the end of the message being despatched */
+  if (q.pos >= c->recvpos)
+    return -1;
+  dbuffer_remove(c->fdq, sizeof(q));
+  return q.fd;
+}
+
+bool
 clientReadData (struct Client *c)
 {
   uint32_t packet_len;
@@ -183,23 +236,26 @@ clientReadData (struct Client *c)
       if (dbuffer_len(c->recvq) < (sizeof(packet_len) + packet_len))
         break;
 
-      char buf[packet_len];
+      /* the message keeps this buffer, and borrows its strings from it */
+      char *buf = ymalloc(packet_len + 1);
       dbuffer_remove(c->recvq, sizeof(packet_len));
       dbuffer_extract(c->recvq, buf, packet_len);
+      c->recvpos += sizeof(packet_len) + packet_len;
 
       struct Message *m;
-      if (!messageFromString(buf, packet_len, &m))
+      if (!messageFromBuffer(buf, packet_len, &m))
         {
           /* Protocol error */
-          /* FIXME: this causes re-entrancy problems in the IPC
-           * drivers, which will be fixed when they're refactored
-           */
           Y_TRACE ("Protocol error from client %d (packet_len == %lu)", c->id, (long unsigned int)packet_len);
           clientClose(c);
-          return;
+          return false;
         }
       messageDespatch(c, m);
+
+      /* descriptors only go to the message they were sent with */
+      clientDiscardFileDescriptors (c, c->recvpos);
     }
+  return true;
 }
 
 void
@@ -31,7 +31,8 @@ void           clientInitialise (void);
 void           clientFinalise (void);
 
 void           clientRegister (struct Client *);
-void           clientReadData (struct Client *);
+/* returns false if the client had to be closed */
+bool           clientReadData (struct Client *);
 void           clientClose (struct Client *);
 
 int            clientGetID (const struct Client *);
@@ -48,6 +49,18 @@ void           clientUnsubscribedSignal (struct Client *, struct Object *, const
 
 void           clientSendMessage (struct Client *, struct Message *);
 
+/* File descriptors passed by the client, for IPC drivers that can carry
+ * them.  The driver queues them straight after adding the data they
+ * came with to the receive queue, and each belongs to the message that
+ * holds the last byte of that data.  Methods that expect one take them
+ * in the order they were sent; clientTakeFileDescriptor returns -1 if
+ * the message being despatched has none left, and the caller owns the
+ * descriptor it returns.  Any the method does not take are closed once
+ * it returns.
+ */
+void           clientQueueFileDescriptor (struct Client *, int fd);
+int            clientTakeFileDescriptor (struct Client *);
+
 #endif /* header guard */
 
 /* arch-tag: 7a621d95-8378-4d45-8caf-4fd02a1188d7
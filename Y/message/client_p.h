@@ -25,6 +25,7 @@
 #include <Y/util/dbuffer.h>
 
 #include <sys/types.h>
+#include <stdint.h>
 
 struct Client
 {
@@ -34,6 +35,11 @@ struct Client
   struct Index *signals;
   struct dbuffer *recvq;
   struct dbuffer *sendq;
+  /* how many bytes have been removed from the front of recvq */
+  uint64_t recvpos;
+  /* file descriptors passed by the client, as an array of struct
+   * QueuedFileDescriptor, in the order they arrived */
+  struct dbuffer *fdq;
 };
 
 struct ClientClass
@@ -23,7 +23,9 @@
 #include <Y/object/class.h>
 #include <Y/object/object.h>
 #include <Y/util/yutil.h>
+#include <Y/util/dbuffer.h>
 #include <Y/util/log.h>
+#include <Y/util/atom.h>
 #include <string.h>
 #include <sys/types.h>
 #include <assert.h>
@@ -42,6 +44,7 @@ messageCreate (enum YMessageOperation op)
   m->seq = 0;
   m->meta = 0;
   m->tuple = NULL;
+  m->buffer = NULL;
   return m;
 }
 
@@ -51,6 +54,15 @@ messageDestroy (struct Message *m)
   if (m == NULL)
     return;
 
+  /* a message from messageFromBuffer was allocated in one piece, and
+   * its strings belong to the buffer */
+  if (m->buffer)
+    {
+      yfree (m->buffer);
+      yfree (m);
+      return;
+    }
+
   tupleDestroy (m->tuple);
   yfree (m);
 }
@@ -65,43 +77,38 @@ messageBuildReply(const struct Client *from, const struct Message *m)
   return rm;
 }
 
-void
-messageToString (const struct Message *m, char **str, size_t *slen)
+/* Number of scalars at the start of every message: seq, to, from, op,
+ * id, meta and the value count */
+#define MESSAGE_HEADER_SCALARS 7
+
+/* Values always have at least a length and a type */
+#define MESSAGE_MIN_VALUE_LENGTH (2 * sizeof(uint32_t))
+
+/* A message decoded by messageFromBuffer, allocated in one piece */
+struct MessageBuffer
+{
+  struct Message message;
+  struct Tuple tuple;
+  struct Value list[];
+};
+
+/* Number of bytes needed to encode a message */
+size_t
+messageEncodedLength (const struct Message *m)
 {
   if (!m)
-    {
-      if (str)
-        *str = NULL;
-      *slen = 0;
-      return;
-    }
+    return 0;
 
-  uint32_t packet_len;
-
-  *slen = 0;
-  *slen += sizeof(m->seq);
-  *slen += sizeof(m->to);
-  *slen += sizeof(m->from);
-  *slen += sizeof(m->op);
-  *slen += sizeof(m->id);
-  *slen += sizeof(m->meta);
-  *slen += sizeof(m->tuple->count);
+  size_t slen = MESSAGE_HEADER_SCALARS * sizeof(uint32_t);
   if (m->tuple)
     for (uint32_t i = 0; i < m->tuple->count; i++)
-      {
-        size_t value_len;
-        valueToString(&m->tuple->list[i], NULL, &value_len);
-        *slen += sizeof(uint32_t);
-        *slen += value_len;
-      }
-
-  if (!str)
-    return;
-
-  *str = ymalloc(*slen);
-
-  char *p = *str;
+      slen += sizeof(uint32_t) + valueEncodedLength(&m->tuple->list[i]);
+  return slen;
+}
 
+static char *
+messageEncodeHeader (const struct Message *m, char *p)
+{
   uint32_t seq = htonl(m->seq);
   ADD_SCALAR(p, seq);
   uint32_t to = htonl(m->to);
@@ -116,139 +123,184 @@ messageToString (const struct Message *m, char **str, size_t *slen)
   ADD_SCALAR(p, meta);
   uint32_t value_count = htonl(m->tuple ? m->tuple->count : 0);
   ADD_SCALAR(p, value_count);
+  return p;
+}
+
+/* Encode a message into the messageEncodedLength() bytes at p, and
+ * return a pointer to the byte after it.
+ */
+char *
+messageEncode (const struct Message *m, char *p)
+{
+  p = messageEncodeHeader(m, p);
   if (m->tuple)
     for (uint32_t i = 0; i < m->tuple->count; i++)
       {
-        char *value_str;
-        size_t value_len;
-        valueToString(&m->tuple->list[i], &value_str, &value_len);
-        uint32_t len = htonl(value_len);
+        uint32_t len = htonl(valueEncodedLength(&m->tuple->list[i]));
         ADD_SCALAR(p, len);
-        ADD_DATA(p, value_str, value_len);
-        yfree(value_str);
+        p = valueEncode(&m->tuple->list[i], p);
       }
+  return p;
+}
+
+void
+messageToString (const struct Message *m, char **str, size_t *slen)
+{
+  if (!m)
+    {
+      if (str)
+        *str = NULL;
+      *slen = 0;
+      return;
+    }
+
+  *slen = messageEncodedLength(m);
+
+  if (!str)
+    return;
+
+  *str = ymalloc(*slen);
+  char *p = messageEncode(m, *str);
 
   assert(p == (*str + *slen));
 }
 
+/* Append the encoding of a message, as produced by messageToString,
+ * straight onto the end of a dbuffer.  The values are encoded in place,
+ * so no temporary copies are made of the message or its strings.
+ */
+void
+messageToDBuffer (const struct Message *m, struct dbuffer *buf)
+{
+  if (!m)
+    return;
+
+  char header[MESSAGE_HEADER_SCALARS * sizeof(uint32_t)];
+  char *p = messageEncodeHeader(m, header);
+  dbuffer_add(buf, header, p - header);
+  if (m->tuple)
+    for (uint32_t i = 0; i < m->tuple->count; i++)
+      {
+        uint32_t len = htonl(valueEncodedLength(&m->tuple->list[i]));
+        DBUFFER_ADD_SCALAR(buf, len);
+        valueToDBuffer(&m->tuple->list[i], buf);
+      }
+}
+
+/* Decode a message from the first slen bytes of str, which must have
+ * been allocated with ymalloc and have one spare byte after them.  The
+ * message takes over str: its string values point into it rather than
+ * being copied, and it is freed along with the message.  If the
+ * message can't be parsed, str is freed and false is returned.
+ */
 bool
-messageFromString (const char *str, size_t slen, struct Message **m)
+messageFromBuffer (char *str, size_t slen, struct Message **m)
 {
+  if (m)
+    *m = NULL;
   if (!str || slen == 0)
     {
-      if (m)
-        *m = NULL;
-      return 0;
+      yfree(str);
+      return false;
     }
 
-  struct Message tmp;
-
-  const char *p = str;
+  char *p = str;
   size_t l = slen;
 
-  if (!GET_SCALAR(p, l, tmp.seq))
-    {
-      Y_TRACE ("Failed to parse message (too short for seq)");
-      return false;
-    }
-  if (!GET_SCALAR(p, l, tmp.to))
-    {
-      Y_TRACE ("Failed to parse message (too short for to)");
-      return false;
-    }
-  if (!GET_SCALAR(p, l, tmp.from))
-    {
-      Y_TRACE ("Failed to parse message (too short for from)");
-      return false;
-    }
-  if (!GET_SCALAR(p, l, tmp.op))
-    {
-      Y_TRACE ("Failed to parse message (too short for op)");
-      return false;
-    }
-  if (!GET_SCALAR(p, l, tmp.id))
-    {
-      Y_TRACE ("Failed to parse message (too short for id)");
-      return false;
-    }
-  if (!GET_SCALAR(p, l, tmp.meta))
-    {
-      Y_TRACE ("Failed to parse message (too short for meta)");
-      return false;
-    }
-  uint32_t nvalue_count;
-  if (!GET_SCALAR(p, l, nvalue_count))
+  uint32_t header[MESSAGE_HEADER_SCALARS];
+  for (int i = 0; i < MESSAGE_HEADER_SCALARS; i++)
+    if (!GET_SCALAR(p, l, header[i]))
+      {
+        Y_TRACE ("Failed to parse message (too short for header)");
+        yfree(str);
+        return false;
+      }
+
+  uint32_t value_count = ntohl(header[6]);
+  if (value_count > l / MESSAGE_MIN_VALUE_LENGTH)
     {
-      Y_TRACE ("Failed to parse message (too short for nvalue_count)");
+      Y_TRACE ("Failed to parse message (too short for %lu values)", (long unsigned int)value_count);
+      yfree(str);
       return false;
     }
 
-  /* This part is a little less obvious */
-  uint32_t value_count = ntohl(nvalue_count);
-  size_t value_len[value_count];
-  const char *value_data[value_count];
+  struct MessageBuffer *mb = ymalloc(sizeof(*mb) + value_count * sizeof(mb->list[0]));
   for (uint32_t i = 0; i < value_count; i++)
     {
-      /* Get the length of the value, and record it for when we parse
-       * properly later
-       */
       uint32_t nmlen;
       if (!GET_SCALAR(p, l, nmlen))
         {
           Y_TRACE ("Failed to parse message (too short for nmlen, i == %lu)", (long unsigned int)i);
-          return false;
+          goto fail;
         }
-      value_len[i] = ntohl(nmlen);
-      /* Record the pointer */
-      value_data[i] = p;
-      /* Check that we have that much data available */
-      if (!SKIP_DATA(p, l, value_len[i]))
+      size_t value_len = ntohl(nmlen);
+      char *value_data = p;
+      if (!SKIP_DATA(p, l, value_len))
         {
           Y_TRACE ("Failed to parse message (too short for member data, i == %lu)", (long unsigned int)i);
-          return false;
+          goto fail;
         }
-      /* And check that the value is parseable */
-      if (!valueFromString(value_data[i], value_len[i], NULL))
+      if (!valueDecode(value_data, value_len, &mb->list[i]))
         {
           Y_TRACE ("Failed to parse message (failed to parse value, i == %lu)", (long unsigned int)i);
-          return false;
+          goto fail;
         }
     }
 
   if (l != 0)
     {
       Y_TRACE ("Failed to parse message (%lu bytes left over at end)", (long unsigned int)l);
-      return false;
+      goto fail;
     }
 
-  if (!m)
-    return true;
-
-  *m = messageCreate(ntohl(tmp.op));
-  (*m)->seq = ntohl(tmp.seq);
-  (*m)->to = ntohl(tmp.to);
-  (*m)->from = ntohl(tmp.from);
-  (*m)->id = ntohl(tmp.id);
-  (*m)->meta = ntohl(tmp.meta);
-  (*m)->tuple = tupleCreate(value_count);
-
-  /* Now, we use those two arrays we built earlier (of pointer/length
-   * pairs) to actually parse the tuple
+  /* Terminate the strings so they can be treated as ASCIIZ.  Each one is
+   * followed by the length of the next value, which has already been
+   * read, or by the spare byte at the end.
    */
   for (uint32_t i = 0; i < value_count; i++)
+    if (mb->list[i].type == t_string)
+      mb->list[i].string.data[mb->list[i].string.len] = '\0';
+
+  if (!m)
     {
-      struct Value *value;
-      if (!valueFromString(value_data[i], value_len[i], &value))
-        /* This is impossible (because it worked earlier), and we've
-         * already committed to allocating, so abort
-         */
-        abort();
-      /* And copy it into the message */
-      memcpy(&((*m)->tuple->list[i]), value, sizeof(*value));
-      yfree(value);
+      yfree(mb);
+      yfree(str);
+      return true;
     }
 
+  *m = &mb->message;
+  (*m)->op = ntohl(header[3]);
+  (*m)->seq = ntohl(header[0]);
+  (*m)->to = ntohl(header[1]);
+  (*m)->from = ntohl(header[2]);
+  (*m)->id = ntohl(header[4]);
+  (*m)->meta = ntohl(header[5]);
+  (*m)->tuple = &mb->tuple;
+  (*m)->buffer = str;
+  mb->tuple.error = false;
+  mb->tuple.count = value_count;
+  mb->tuple.list = value_count > 0 ? mb->list : NULL;
   return true;
+
+ fail:
+  yfree(mb);
+  yfree(str);
+  return false;
+}
+
+bool
+messageFromString (const char *str, size_t slen, struct Message **m)
+{
+  if (!str || slen == 0)
+    {
+      if (m)
+        *m = NULL;
+      return 0;
+    }
+
+  char *copy = ymalloc(slen + 1);
+  memcpy(copy, str, slen);
+  return messageFromBuffer(copy, slen, m);
 }
 
 static void
@@ -276,6 +328,22 @@ messageDespatchFindClass (const struct Client *clientFrom, const struct Message
     messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Class not found"));
 }
 
+static void
+messageDespatchFindAtom (const struct Client *clientFrom, const struct Message *m)
+{
+  if (m->tuple->count != 1 || m->tuple->list[0].type != t_string)
+    {
+      messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Type mismatch"));
+      return;
+    }
+
+  /* Only names the server already knows have atoms; clients can't add
+   * to the table */
+  struct Message *rm = messageBuildReply(clientFrom, m);
+  rm->id = atomFind (m->tuple->list[0].string.data);
+  messageDespatch(NULL, rm);
+}
+
 static void
 messageDespatchInvokeClassMethod (struct Client *clientFrom, const struct Message *m)
 {
@@ -284,7 +352,8 @@ messageDespatchInvokeClassMethod (struct Client *clientFrom, const struct Messag
       messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Type mismatch"));
       return;
     }
-  else if (m->tuple->list[0].type != t_string)
+  /* the method is named by a string or an atom */
+  else if (m->tuple->list[0].type != t_string && m->tuple->list[0].type != t_uint32)
     {
       messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Type mismatch"));
       return;
@@ -302,9 +371,13 @@ messageDespatchInvokeClassMethod (struct Client *clientFrom, const struct Messag
       .count = m->tuple->count - 1,
       .list = m->tuple->list + 1
     };
-  struct Tuple *t = classInvokeClassMethod (class, clientFrom, m->tuple->list[0].string.data, &args);
+  struct Tuple *t;
+  if (m->tuple->list[0].type == t_uint32)
+    t = classInvokeClassMethodAtom (class, clientFrom, m->tuple->list[0].uint32, &args);
+  else
+    t = classInvokeClassMethod (class, clientFrom, m->tuple->list[0].string.data, &args);
   /* Only send a response if one was requested (but always send errors) */
-  if (m->meta && (!t || !t->error))
+  if (m->meta || (t && t->error))
     {
       struct Message *rm = messageBuildReply(clientFrom, m);
       rm->tuple = t;
@@ -326,7 +399,8 @@ messageDespatchInvokeInstanceMethod (struct Client *clientFrom, const struct Mes
       messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Type mismatch"));
       return;
     }
-  else if (m->tuple->list[0].type != t_string)
+  /* the method is named by a string or an atom */
+  else if (m->tuple->list[0].type != t_string && m->tuple->list[0].type != t_uint32)
     {
       messageDespatch(NULL, messageBuildReplyError(clientFrom, m, "Type mismatch"));
       return;
@@ -344,9 +418,13 @@ messageDespatchInvokeInstanceMethod (struct Client *clientFrom, const struct Mes
       .count = m->tuple->count - 1,
       .list = m->tuple->list + 1
     };
-  struct Tuple *t = classInvokeInstanceMethod (object, clientFrom, m->tuple->list[0].string.data, &args);
+  struct Tuple *t;
+  if (m->tuple->list[0].type == t_uint32)
+    t = classInvokeInstanceMethodAtom (object, clientFrom, m->tuple->list[0].uint32, &args);
+  else
+    t = classInvokeInstanceMethod (object, clientFrom, m->tuple->list[0].string.data, &args);
   /* Only send a response if one was requested (but always send errors) */
-  if (m->meta && (!t || !t->error))
+  if (m->meta || (t && t->error))
     {
       struct Message *rm = messageBuildReply(clientFrom, m);
       rm->tuple = t;
@@ -399,6 +477,9 @@ messageDoDespatch (struct Client *clientFrom, struct Message *m)
     case YMO_INVOKE_INSTANCE_METHOD:
       messageDespatchInvokeInstanceMethod (clientFrom, m);
       return;
+    case YMO_FIND_ATOM:
+      messageDespatchFindAtom (clientFrom, m);
+      return;
     case YMO_QUIT:
       Y_TRACE ("YMO_QUIT from client %d", clientGetID(clientFrom));
       clientClose (clientFrom);
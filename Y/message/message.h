@@ -32,6 +32,8 @@ struct Message
   uint32_t op;
   uint32_t id, meta;
   struct Tuple *tuple;
+  /* the received data the tuple's strings point into, if any */
+  char *buffer;
 };
 
 #include <Y/y.h>
@@ -49,8 +51,12 @@ struct Message *messageBuildReply(const struct Client *from, const struct Messag
     rm;                                                                 \
   })
 
+size_t messageEncodedLength (const struct Message *m);
+char *messageEncode (const struct Message *m, char *p);
 void messageToString (const struct Message *m, char **str, size_t *len);
+void messageToDBuffer (const struct Message *m, struct dbuffer *buf);
 bool messageFromString (const char *str, size_t len, struct Message **m);
+bool messageFromBuffer (char *str, size_t len, struct Message **m);
 
 void   messageDespatch (struct Client *, struct Message *);
 
@@ -24,6 +24,9 @@
 #define ADD_SCALAR(P, S) do {memcpy((P), &(S), sizeof(S)); (P) += sizeof(S);} while(0)
 #define ADD_DATA(P, S, L) do {size_t l = (L); memcpy((P), (S), l); (P) += l;} while(0)
 
+/* The same, appending to a dbuffer */
+#define DBUFFER_ADD_SCALAR(B, S) dbuffer_add((B), (const char *)&(S), sizeof(S))
+
 /* These macros are used to safely parse a the buffer represented by
  * p/l; after extracting a value, p is incremented to point after it
  * and l is decremented by the amount of data removed, so l is always
@@ -20,6 +20,7 @@
 #include <object/object.h>
 #include <assert.h>
 #include <Y/util/yutil.h>
+#include <Y/util/dbuffer.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -198,41 +199,29 @@ tupleBuild_(const struct Value *list)
   return t;
 }
 
-void
-valueToString (const struct Value *m, char **str, size_t *slen)
+/* Number of bytes needed to encode a value (excluding the length
+ * that precedes it in a message).
+ */
+size_t
+valueEncodedLength (const struct Value *m)
 {
-  if (!m)
-    {
-      if (str)
-        *str = NULL;
-      *slen = 0;
-      return;
-    }
-
-  *slen = 0;
-  *slen += sizeof(m->type);
   switch((enum Type)m->type)
     {
     case t_string:
-      *slen += m->string.len;
-      break;
+      return sizeof(uint32_t) + m->string.len;
     case t_object:
     case t_uint32:
-      *slen += sizeof(m->uint32);
-      break;
+      return sizeof(uint32_t) + sizeof(m->uint32);
     case t_int32:
-      *slen += sizeof(m->int32);
-      break;
+      return sizeof(uint32_t) + sizeof(m->int32);
     default:
       abort();
     }
+}
 
-  if (!str)
-    return;
-
-  *str = ymalloc(*slen);
-  char *p = *str;
-
+static char *
+valueEncodeType (const struct Value *m, char *p)
+{
   uint32_t type;
   switch((enum Type)m->type)
     {
@@ -248,6 +237,16 @@ valueToString (const struct Value *m, char **str, size_t *slen)
       abort();
     }
   ADD_SCALAR(p, type);
+  return p;
+}
+
+/* Encode a value into the valueEncodedLength() bytes at p, and return
+ * a pointer to the byte after it.
+ */
+char *
+valueEncode (const struct Value *m, char *p)
+{
+  p = valueEncodeType(m, p);
 
   switch((enum Type)m->type)
     {
@@ -277,10 +276,96 @@ valueToString (const struct Value *m, char **str, size_t *slen)
     default:
       abort();
     }
+  return p;
+}
+
+void
+valueToString (const struct Value *m, char **str, size_t *slen)
+{
+  if (!m)
+    {
+      if (str)
+        *str = NULL;
+      *slen = 0;
+      return;
+    }
+
+  *slen = valueEncodedLength(m);
+
+  if (!str)
+    return;
+
+  *str = ymalloc(*slen);
+  char *p = valueEncode(m, *str);
 
   assert(p == (*str + *slen));
 }
 
+/* As valueToString, but appends the encoded value straight onto the
+ * end of a dbuffer, without building it in a temporary string first.
+ */
+void
+valueToDBuffer (const struct Value *m, struct dbuffer *buf)
+{
+  char scalar[2 * sizeof(uint32_t)];
+  if (m->type == t_string)
+    {
+      /* don't copy the string anywhere but the buffer */
+      char *p = valueEncodeType(m, scalar);
+      dbuffer_add(buf, scalar, p - scalar);
+      dbuffer_add(buf, m->string.data, m->string.len);
+    }
+  else
+    {
+      char *p = valueEncode(m, scalar);
+      dbuffer_add(buf, scalar, p - scalar);
+    }
+}
+
+/* Decode a value in place.  Unlike valueFromString, nothing is
+ * allocated: a string value points straight into str, and is not
+ * terminated.
+ */
+bool
+valueDecode (char *str, size_t slen, struct Value *m)
+{
+  char *p = str;
+  size_t l = slen;
+
+  uint32_t type;
+  if (!GET_SCALAR(p, l, type))
+    return false;
+  m->type = ntohl(type);
+
+  switch((enum Type)m->type)
+    {
+    case t_string:
+      m->string.len = l;
+      m->string.data = p;
+      return true;
+    case t_uint32:
+      {
+        uint32_t uint32;
+        if (!GET_SCALAR(p, l, uint32))
+          return false;
+        m->uint32 = ntohl(uint32);
+        break;
+      }
+    case t_int32:
+      {
+        int32_t int32;
+        if (!GET_SCALAR(p, l, int32))
+          return false;
+        m->int32 = ntohl(int32);
+        break;
+      }
+    default:
+      return false;
+    }
+
+  return l == 0;
+}
+
 bool
 valueFromString (const char *str, size_t slen, struct Value **m)
 {
@@ -744,7 +829,7 @@ tupleStaticCast(const struct Tuple *t, const struct TupleType *type)
           return rt;
         }
       /* Check that the value is present */
-      if (rt->count < i)
+      if (rt->count <= i)
         {
           tupleDestroy(rt);
           return NULL;
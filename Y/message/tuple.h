@@ -24,6 +24,8 @@
 #include <stdbool.h>
 #include <string.h>
 
+struct dbuffer;
+
 enum Type
   {
     /* These can be sent over the wire */
@@ -92,6 +94,10 @@ struct Tuple *tupleDup(const struct Tuple *t);
 void tupleDestroy(struct Tuple *);
 
 void valueToString (const struct Value *m, char **str, size_t *len);
+void valueToDBuffer (const struct Value *m, struct dbuffer *buf);
+size_t valueEncodedLength (const struct Value *m);
+char *valueEncode (const struct Value *m, char *p);
+bool valueDecode (char *str, size_t len, struct Value *m);
 bool valueFromString (const char *str, size_t len, struct Value **m);
 
 struct Value *valueCreate(void);
@@ -190,6 +190,20 @@ themeWindowPaint (struct Window *w, struct Painter *p)
     }
 }
 
+struct Region *
+themeWindowGetOpaqueRegion (struct Window *w)
+{
+  struct Theme *current = topTheme;
+
+  while (current != NULL)
+    {
+      if (current -> windowGetOpaqueRegion != NULL)
+        return current -> windowGetOpaqueRegion (w);
+      current = current -> nextTheme;
+    }
+  return NULL;
+}
+
 static int
 themeWindowGetRegion (struct Window *w, int x, int y)
 {
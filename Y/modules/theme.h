@@ -37,6 +37,8 @@ struct Font *
 
 void themeWindowInit           (struct Window *);
 void themeWindowPaint          (struct Window *, struct Painter *);
+struct Region *
+     themeWindowGetOpaqueRegion(struct Window *);
 int  themeWindowPointerMotion  (struct Window *, int32_t, int32_t, int32_t, int32_t);
 int  themeWindowPointerButton  (struct Window *, int32_t, int32_t, uint32_t, bool);
 void themeWindowReconfigure    (struct Window *, int32_t *, int32_t *, int32_t *, int32_t *,
@@ -23,6 +23,7 @@ struct Theme;
 
 #include <Y/modules/module.h>
 #include <Y/buffer/painter.h>
+#include <Y/util/region.h>
 #include <Y/widget/widget.h>
 #include <Y/widget/button.h>
 #include <Y/widget/checkbox.h>
@@ -61,6 +62,11 @@ struct Theme
    */
   void (*windowInit)          (struct Window *);
   void (*windowPaint)         (struct Window *, struct Painter *);
+  /* a new region, in window coordinates, of pixels that windowPaint
+   * always leaves opaque, or NULL if there are none; used to skip
+   * rendering whatever is underneath */
+  struct Region *
+       (*windowGetOpaqueRegion)(struct Window *);
   int  (*windowGetRegion)     (struct Window *, int32_t, int32_t);
   int  (*windowPointerMotion) (struct Window *, int32_t, int32_t, int32_t, int32_t);
   int  (*windowPointerButton) (struct Window *, int32_t, int32_t, uint32_t, bool);
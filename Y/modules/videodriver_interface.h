@@ -58,6 +58,13 @@ struct VideoDriver
   struct Renderer * (*getRenderer) (struct VideoDriver *,
                                     const struct Rectangle *);
 
+  /* Optional.  The rate the display refreshes at in Hz, or 0 if it
+   * isn't known. */
+  int  (*getRefreshRate)     (struct VideoDriver *);
+  /* Optional.  Wait for the next vertical blank, to present a frame
+   * without tearing.  Returns -1 if the display can't do that. */
+  int  (*waitForVSync)       (struct VideoDriver *);
+
 };
 
 #endif
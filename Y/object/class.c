@@ -21,6 +21,7 @@
 #include <Y/object/object_p.h>
 #include <Y/util/yutil.h>
 #include <Y/util/index.h>
+#include <Y/util/atom.h>
 #include <string.h>
 #include <assert.h>
 
@@ -28,6 +29,21 @@ static struct Index *classNameIndex = NULL;
 static struct Index *classIDIndex = NULL;
 static int classNextID = 1;
 static bool preinitDone = false;
+/* Moves on whenever a method is added anywhere, as that can change the
+ * dispatch tables of any subclass */
+static uint32_t classGeneration = 1;
+
+/* Every method a class responds to, including the inherited ones,
+ * indexed by the atom of the method name.  Built on first use, and
+ * again if classGeneration has moved on since.
+ */
+struct ClassTables
+{
+  uint32_t generation;
+  uint32_t size;
+  const struct Method **classMethods;
+  const struct Method **instanceMethods;
+};
 
 struct Class
 {
@@ -39,11 +55,12 @@ struct Class
   struct Index *classMethods;
   struct Index *instanceMethods;
   struct Index *properties;
+  struct ClassTables *tables;
 };
 
 struct Method
 {
-  char *name;
+  uint32_t atom;
   /* Precisely one of these fields will be NULL and the other will be used */
   ClassMethod *classFunc;
   InstanceMethod *instanceFunc;
@@ -51,7 +68,7 @@ struct Method
 
 struct Property
 {
-  char *name;
+  uint32_t atom;
   enum Type type;
   PropertyHook *hook;
 };
@@ -72,12 +89,20 @@ classNameComparisonFunction (const void *obj1_v, const void *obj2_v)
   return strcmp (classGetName (obj1), classGetName (obj2));
 }
 
+static int
+atomCompare (uint32_t a, uint32_t b)
+{
+  if (a == b)
+    return 0;
+  return (a < b) ? -1 : 1;
+}
+
 static int
 methodKeyFunction (const void *key_v, const void *obj_v)
 {
-  const char *key = key_v;
+  const uint32_t *key = key_v;
   const struct Method *obj = obj_v;
-  return strcmp (key, obj->name);
+  return atomCompare (*key, obj->atom);
 }
 
 static int
@@ -85,25 +110,21 @@ methodComparisonFunction (const void *obj1_v, const void *obj2_v)
 {
   const struct Method *obj1 = obj1_v;
   const struct Method *obj2 = obj2_v;
-  return strcmp (obj1->name, obj2->name);
+  return atomCompare (obj1->atom, obj2->atom);
 }
 
 static void
 methodDestructorFunction (void *obj_v)
 {
-  struct Method *obj = obj_v;
-  if (!obj)
-    return;
-  yfree(obj->name);
-  yfree(obj);
+  yfree(obj_v);
 }
 
 static int
 propertyKeyFunction (const void *key_v, const void *obj_v)
 {
-  const char *key = key_v;
+  const uint32_t *key = key_v;
   const struct Property *obj = obj_v;
-  return strcmp (key, obj->name);
+  return atomCompare (*key, obj->atom);
 }
 
 static int
@@ -111,17 +132,13 @@ propertyComparisonFunction (const void *obj1_v, const void *obj2_v)
 {
   const struct Property *obj1 = obj1_v;
   const struct Property *obj2 = obj2_v;
-  return strcmp (obj1->name, obj2->name);
+  return atomCompare (obj1->atom, obj2->atom);
 }
 
 static void
 propertyDestructorFunction (void *obj_v)
 {
-  struct Property *obj = obj_v;
-  if (!obj)
-    return;
-  yfree(obj->name);
-  yfree(obj);
+  yfree(obj_v);
 }
 
 static int
@@ -161,6 +178,9 @@ classDestructorFunction (void *obj_v)
   indexDestroy(c->classMethods, methodDestructorFunction);
   indexDestroy(c->instanceMethods, methodDestructorFunction);
   indexDestroy(c->properties, propertyDestructorFunction);
+  yfree(c->tables->classMethods);
+  yfree(c->tables->instanceMethods);
+  yfree(c->tables);
   yfree(c);
 }
 
@@ -188,6 +208,8 @@ classSetup(struct Class *c)
       /* This will have to be revisited later */
       assert(c->superList[i]);
     }
+  /* the inherited methods can be found now */
+  classGeneration++;
 }
 
 void
@@ -227,75 +249,142 @@ classGetID (const struct Class *c)
   return c -> id;
 }
 
-static int
-classCompareMethod (const void *key_v, const void *memb_v)
+static void
+classFillTable (const struct Method **table, struct Index *methods)
 {
-  const char *key = key_v;
-  const struct Method *memb = memb_v;
-  return strcmp (key, memb->name);
+  struct IndexIterator *i;
+  for (i = indexGetStartIterator(methods); indexiteratorHasValue(i); indexiteratorNext(i))
+    {
+      const struct Method *m = indexiteratorGet(i);
+      table[m->atom] = m;
+    }
+  indexiteratorDestroy(i);
+}
+
+static void
+classCopyTable (const struct Method **to, const struct Method **from, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; i++)
+    if (from[i])
+      to[i] = from[i];
+}
+
+/* Bring a class's dispatch tables up to date */
+static struct ClassTables *
+classUpdateTables (const struct Class *c)
+{
+  struct ClassTables *t = c->tables;
+  if (t->generation == classGeneration)
+    return t;
+
+  /* every method name was interned when it was added, so they're all
+   * below the current limit */
+  t->size = atomLimit();
+  yfree(t->classMethods);
+  yfree(t->instanceMethods);
+  t->classMethods = ymalloc(sizeof(t->classMethods[0]) * t->size);
+  t->instanceMethods = ymalloc(sizeof(t->instanceMethods[0]) * t->size);
+  memset(t->classMethods, 0, sizeof(t->classMethods[0]) * t->size);
+  memset(t->instanceMethods, 0, sizeof(t->instanceMethods[0]) * t->size);
+
+  /* Methods are searched for in this class, then depth first through
+   * each superclass in turn, so copy the superclasses in reverse order
+   * and let each one override the last.
+   */
+  if (c->superList)
+    for (uint32_t i = c->superCount; i-- > 0; )
+      {
+        const struct ClassTables *st = classUpdateTables(c->superList[i]);
+        uint32_t size = MIN(st->size, t->size);
+        classCopyTable(t->classMethods, st->classMethods, size);
+        classCopyTable(t->instanceMethods, st->instanceMethods, size);
+      }
+  classFillTable(t->classMethods, c->classMethods);
+  classFillTable(t->instanceMethods, c->instanceMethods);
+
+  /* until the superclasses are set up, the tables are incomplete */
+  if (c->superList || c->superCount == 0)
+    t->generation = classGeneration;
+  else
+    t->generation = 0;
+  return t;
 }
 
 static const struct Method *
-classFindClassMethod (const struct Class *c, const char *method)
+classFindClassMethod (const struct Class *c, uint32_t method)
 {
-  const struct Method *m = indexFind(c->classMethods, method);
+  const struct ClassTables *t = classUpdateTables(c);
+  return (method < t->size) ? t->classMethods[method] : NULL;
+}
 
-  if (m)
-    return m;
+static const struct Method *
+classFindInstanceMethod (const struct Class *c, uint32_t method)
+{
+  const struct ClassTables *t = classUpdateTables(c);
+  return (method < t->size) ? t->instanceMethods[method] : NULL;
+}
 
-  for (uint32_t i = 0; i < c->superCount; i++)
-    {
-      m = classFindClassMethod(c->superList[i], method);
-      if (m)
-        return m;
-    }
+static struct Tuple *
+classClassMethodNotFound (const struct Class *c, const char *method)
+{
+  return tupleBuildError(tb_string("Class method not found"), tb_string(classGetName(c)), tb_string(method));
+}
 
-  return NULL;
+static struct Tuple *
+classInstanceMethodNotFound (struct Object *o, const char *method)
+{
+  return tupleBuildError(tb_string("Instance method not found"),
+                         tb_string(classGetName(objectClass(o))),
+                         tb_string(method),
+                         tb_uint32(objectGetID(o)));
 }
 
 struct Tuple *
 classInvokeClassMethod (const struct Class *c, struct Client *from, const char *method,
                         const struct Tuple *args)
 {
-  const struct Method *m = classFindClassMethod(c, method);
+  const struct Method *m = classFindClassMethod(c, atomFind(method));
 
   if (m)
     return m->classFunc(from, args);
   else
-    return tupleBuildError(tb_string("Class method not found"), tb_string(classGetName(c)), tb_string(method));
+    return classClassMethodNotFound(c, method);
 }
 
-static const struct Method *
-classFindInstanceMethod (const struct Class *c, const char *method)
+struct Tuple *
+classInvokeClassMethodAtom (const struct Class *c, struct Client *from, uint32_t method,
+                            const struct Tuple *args)
 {
-  const struct Method *m = indexFind(c->instanceMethods, method);
+  const struct Method *m = classFindClassMethod(c, method);
 
   if (m)
-    return m;
-
-  for (uint32_t i = 0; i < c->superCount; i++)
-    {
-      m = classFindInstanceMethod(c->superList[i], method);
-      if (m)
-        return m;
-    }
-
-  return NULL;
+    return m->classFunc(from, args);
+  else
+    return classClassMethodNotFound(c, atomName(method) ? atomName(method) : "");
 }
 
 struct Tuple *
 classInvokeInstanceMethod (struct Object *o, struct Client *from, const char *method,
                            const struct Tuple *args)
+{
+  const struct Method *m = classFindInstanceMethod(objectClass(o), atomFind(method));
+
+  if (m)
+    return m->instanceFunc(o, from, args);
+  else
+    return classInstanceMethodNotFound(o, method);
+}
+
+struct Tuple *
+classInvokeInstanceMethodAtom (struct Object *o, struct Client *from, uint32_t method,
+                               const struct Tuple *args)
 {
   const struct Method *m = classFindInstanceMethod(objectClass(o), method);
 
   if (m)
     return m->instanceFunc(o, from, args);
   else
-    return tupleBuildError(tb_string("Instance method not found"),
-                           tb_string(classGetName(objectClass(o))),
-                           tb_string(method),
-                           tb_uint32(objectGetID(o)));
+    return classInstanceMethodNotFound(o, atomName(method) ? atomName(method) : "");
 }
 
 bool
@@ -349,6 +438,11 @@ classCreate(const char *name, uint32_t superc, const char **superv)
   c->classMethods = indexCreate (methodKeyFunction, methodComparisonFunction);
   c->instanceMethods = indexCreate (methodKeyFunction, methodComparisonFunction);
   c->properties = indexCreate(propertyKeyFunction, propertyComparisonFunction);
+  c->tables = ymalloc(sizeof(*c->tables));
+  c->tables->generation = 0;
+  c->tables->size = 0;
+  c->tables->classMethods = NULL;
+  c->tables->instanceMethods = NULL;
   c->id = classNextID++;
   indexAdd (classNameIndex, c);
   indexAdd (classIDIndex, c);
@@ -363,9 +457,11 @@ classAddInstanceMethod(struct Class *class, const char *name, InstanceMethod *me
   assert(name);
   assert(method);
   struct Method *m = ymalloc(sizeof(*m));
-  m->name = ystrdup(name);
+  m->atom = atomIntern(name);
+  m->classFunc = NULL;
   m->instanceFunc = method;
   indexAdd (class->instanceMethods, m);
+  classGeneration++;
 }
 
 void
@@ -375,9 +471,11 @@ classAddClassMethod(struct Class *class, const char *name, ClassMethod *method)
   assert(name);
   assert(method);
   struct Method *m = ymalloc(sizeof(*m));
-  m->name = ystrdup(name);
+  m->atom = atomIntern(name);
   m->classFunc = method;
+  m->instanceFunc = NULL;
   indexAdd (class->classMethods, m);
+  classGeneration++;
 }
 
 void
@@ -387,7 +485,7 @@ classAddProperty(struct Class *class, const char *name, enum Type type, Property
   assert(name);
 
   struct Property *p = ymalloc(sizeof(*p));
-  p->name = ystrdup(name);
+  p->atom = atomIntern(name);
   p->type = type;
   p->hook = hook;
   indexAdd (class->properties, p);
@@ -399,7 +497,8 @@ classGetProperty(const struct Class *class, const char *name)
   assert(class);
   assert(name);
 
-  struct Property *p = indexFind (class->properties, name);
+  uint32_t atom = atomFind(name);
+  struct Property *p = indexFind (class->properties, &atom);
   if (!p)
     return t_undef;
   return p->type;
@@ -409,7 +508,8 @@ void
 classCallPropertyHook(struct Object *o, const char *name, const struct Value *old, const struct Value *new)
 {
   const struct Class *c = objectClass(o);
-  const struct Property *p = indexFind (c->properties, name);
+  uint32_t atom = atomFind(name);
+  const struct Property *p = indexFind (c->properties, &atom);
   if (!p)
     return;
   if (!p->hook)
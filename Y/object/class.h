@@ -48,6 +48,11 @@ struct Tuple *classInvokeClassMethod (const struct Class *, struct Client *,
                                       const char *method, const struct Tuple *);
 struct Tuple *classInvokeInstanceMethod (struct Object *, struct Client *,
                                          const char *method, const struct Tuple *);
+/* The same, with the method name given as an atom */
+struct Tuple *classInvokeClassMethodAtom (const struct Class *, struct Client *,
+                                          uint32_t method, const struct Tuple *);
+struct Tuple *classInvokeInstanceMethodAtom (struct Object *, struct Client *,
+                                             uint32_t method, const struct Tuple *);
 
 struct Class *classFindByName (const char *name);
 struct Class *classFindByID   (int id);
@@ -22,18 +22,20 @@
 #include <Y/const.h>
 #include <Y/object/class_p.h>
 #include <Y/util/yutil.h>
+#include <Y/util/atom.h>
+#include <Y/util/log.h>
 #include <stdlib.h>
 #include <string.h>
 
 struct PropertyValue
 {
-  char *name;
+  uint32_t atom;
   struct Value *v;
 };
 
 struct Signal
 {
-  char *name;
+  uint32_t atom;
   struct Index *clients;
 };
 
@@ -69,12 +71,20 @@ objectComparisonFunction (const void *obj1_v, const void *obj2_v)
     return 1; 
 }
 
+static int
+atomCompare (uint32_t a, uint32_t b)
+{
+  if (a == b)
+    return 0;
+  return (a < b) ? -1 : 1;
+}
+
 static int
 propertyKeyFunction (const void *key_v, const void *obj_v)
 {
-  const char *key = key_v;
+  const uint32_t *key = key_v;
   const struct PropertyValue *obj = obj_v;
-  return strcmp (key, obj -> name);
+  return atomCompare (*key, obj -> atom);
 }
 
 static int
@@ -82,7 +92,7 @@ propertyComparisonFunction (const void *obj1_v, const void *obj2_v)
 {
   const struct PropertyValue *obj1 = obj1_v;
   const struct PropertyValue *obj2 = obj2_v;
-  return strcmp (obj1 -> name, obj2 -> name);
+  return atomCompare (obj1 -> atom, obj2 -> atom);
 }
 
 static void
@@ -90,16 +100,15 @@ propertyDestructorFunction (void *obj)
 {
   struct PropertyValue *prop = obj;
   valueDestroy(prop->v);
-  yfree(prop->name);
   yfree(prop);
 }
 
 static int
 signalKeyFunction (const void *key_v, const void *obj_v)
 {
-  const char *key = key_v;
+  const uint32_t *key = key_v;
   const struct Signal *obj = obj_v;
-  return strcmp (key, obj -> name);
+  return atomCompare (*key, obj -> atom);
 }
 
 static int
@@ -107,7 +116,7 @@ signalComparisonFunction (const void *obj1_v, const void *obj2_v)
 {
   const struct Signal *obj1 = obj1_v;
   const struct Signal *obj2 = obj2_v;
-  return strcmp (obj1 -> name, obj2 -> name);
+  return atomCompare (obj1 -> atom, obj2 -> atom);
 }
 
 static void
@@ -115,10 +124,19 @@ signalDestructorFunction (void *obj)
 {
   struct Signal *sig = obj;
   indexDestroy(sig->clients, NULL);
-  yfree(sig->name);
   yfree(sig);
 }
 
+/* The signal called NAME, if anyone has subscribed to it */
+static struct Signal *
+objectFindSignal (const struct Object *o, const char *name)
+{
+  uint32_t atom = atomFind (name);
+  if (atom == 0)
+    return NULL;
+  return indexFind (o->signals, &atom);
+}
+
 static int
 stringComparisonFunction (const void *str1, const void *str2)
 {
@@ -174,12 +192,21 @@ objectFind (uint32_t oid)
   return obj;
 }
 
+bool
+objectSignalSubscribed (const struct Object *o, const char *name)
+{
+  return objectFindSignal (o, name) != NULL;
+}
+
 void
 objectEmitSignal_(struct Object *o, const char *name, struct Tuple *args)
 {
-  struct Signal *sig = indexFind (o->signals, name);
+  struct Signal *sig = objectFindSignal (o, name);
   if (!sig)
-    return;
+    {
+      tupleDestroy(args);
+      return;
+    }
 
   struct IndexIterator *i;
   for (i = indexGetStartIterator (sig->clients); indexiteratorHasValue(i); indexiteratorNext(i))
@@ -195,14 +222,45 @@ objectEmitSignal_(struct Object *o, const char *name, struct Tuple *args)
   tupleDestroy(args);
 }
 
+/* The names of the signals the server emits.  Clients may only
+ * subscribe to names that already have atoms, so that they cannot grow
+ * the atom table without limit; these are interned before the first
+ * subscription so that they always can.
+ */
+static const char *signalNames[] =
+{
+  "propertyChanged",
+  "clicked",
+  "resize",
+  "requestClose",
+  "keyPress",
+  NULL
+};
+
 bool
 objectSubscribeSignal (struct Client *c, struct Object *o, const char *name)
 {
-  struct Signal *sig = indexFind (o->signals, name);
+  static bool signalNamesInterned = false;
+  if (!signalNamesInterned)
+    {
+      for (const char **n = signalNames; *n != NULL; ++n)
+        atomIntern (*n);
+      signalNamesInterned = true;
+    }
+
+  uint32_t atom = atomFind (name);
+  if (atom == 0)
+    {
+      Y_TRACE ("Client %d subscribed to unknown signal %s",
+               clientGetID (c), name);
+      return false;
+    }
+
+  struct Signal *sig = indexFind (o->signals, &atom);
   if (!sig)
     {
       sig = ymalloc (sizeof(*sig));
-      sig->name = ystrdup (name);
+      sig->atom = atom;
       sig->clients = indexCreate (clientComparisonFunction, clientComparisonFunction);
       indexAdd (o->signals, sig);
     }
@@ -221,27 +279,72 @@ void
 objectUnsubscribeSignal (struct Client *c, struct Object *o, const char *name)
 {
   /* Find the signal object */
-  struct Signal *sig = indexFind (o->signals, name);
+  struct Signal *sig = objectFindSignal (o, name);
   /* (or not) */
   if (!sig)
     return;
   /* Unsubscribe the client */
-  if (indexRemove (sig->clients, name))
+  if (indexRemove (sig->clients, c))
     clientUnsubscribedSignal(c, o, name);
   /* And remove the signal object if it's now unused */
   if (indexCount (sig->clients) == 0)
-    signalDestructorFunction (indexRemove (o->signals, sig));
+    signalDestructorFunction (indexRemove (o->signals, &(sig->atom)));
 }
 
 const struct Value *
 objectGetProperty (struct Object *o, const char *name)
 {
-  struct PropertyValue *p = indexFind (o->properties, name);
+  uint32_t atom = atomFind (name);
+  if (atom == 0)
+    return NULL;
+  struct PropertyValue *p = indexFind (o->properties, &atom);
   if (!p)
     return NULL;
   return p->v;
 }
 
+/* Tell the clients subscribed to O's propertyChanged signal that NAME
+ * is now V, or has been unset if V is NULL.  This is sent for every
+ * change, even one to the same value, and the client that made it is
+ * told so, so that it can match the event up with its own request.
+ */
+static void
+objectPropertyChanged (struct Object *o, const char *name,
+                       const struct Value *v)
+{
+  struct Signal *sig = objectFindSignal (o, "propertyChanged");
+  if (!sig)
+    return;
+
+  struct Tuple *args;
+  if (v)
+    {
+      /* the tuple owns its values, so give it a copy of the property's */
+      struct Value *copy = valueDup (v);
+      args = tupleBuild (tb_string ("propertyChanged"), tb_string (name),
+                         tb_uint32 (0), tb_value (*copy));
+      yfree (copy);
+    }
+  else
+    args = tupleBuild (tb_string ("propertyChanged"), tb_string (name),
+                       tb_uint32 (0));
+
+  struct Client *origin = getCurrentClient ();
+  struct IndexIterator *i;
+  for (i = indexGetStartIterator (sig->clients); indexiteratorHasValue(i); indexiteratorNext(i))
+    {
+      struct Client *client = indexiteratorGet(i);
+      struct Message *m = messageCreate(YMO_EVENT);
+      m->to = clientGetID(client);
+      m->id = o->oid;
+      m->tuple = tupleDup(args);
+      m->tuple->list[2].uint32 = client == origin;
+      messageDespatch (NULL, m);
+    }
+  indexiteratorDestroy(i);
+  tupleDestroy(args);
+}
+
 bool
 objectSetProperty(struct Object *o, const char *name, const struct Value *v_in)
 {
@@ -254,12 +357,19 @@ objectSetProperty(struct Object *o, const char *name, const struct Value *v_in)
       return false;
     }
 
+  /* properties were interned when their class was set up */
+  uint32_t atom = atomFind (name);
+
   /* NULL or t_undef means "unset" */
   if (!v_in || v_in->type == t_undef)
     {
-      struct PropertyValue *p = indexRemove (o->properties, name);
-      classCallPropertyHook(o, name, p->v, NULL);
-      propertyDestructorFunction(p);
+      struct PropertyValue *p = indexRemove (o->properties, &atom);
+      if (p)
+        {
+          classCallPropertyHook(o, name, p->v, NULL);
+          propertyDestructorFunction(p);
+        }
+      objectPropertyChanged(o, name, NULL);
       return true;
     }
 
@@ -269,13 +379,13 @@ objectSetProperty(struct Object *o, const char *name, const struct Value *v_in)
     return false;
 
   /* Now, is the property already set? */
-  struct PropertyValue *p = indexFind (o->properties, name);
+  struct PropertyValue *p = indexFind (o->properties, &atom);
   struct Value *old = NULL;
   if (!p)
     {
       /* No, need to create one */
       p = ymalloc(sizeof(*p));
-      p->name = ystrdup(name);
+      p->atom = atom;
       indexAdd(o->properties, p);
     }
   else
@@ -283,8 +393,9 @@ objectSetProperty(struct Object *o, const char *name, const struct Value *v_in)
 
   /* Store the value */
   p->v = v;
-  classCallPropertyHook(o, name, v, old);
+  classCallPropertyHook(o, name, old, v);
   valueDestroy(old);
+  objectPropertyChanged(o, name, v);
   return true;
 }
 
@@ -300,13 +411,16 @@ objectDestroy (struct Object *o)
       for (j = indexGetStartIterator (sig->clients); indexiteratorHasValue(j); indexiteratorNext(j))
         {
           struct Client *client = indexiteratorGet(j);
-          clientUnsubscribedSignal(client, o, sig->name);
+          clientUnsubscribedSignal(client, o, atomName(sig->atom));
         }
       indexiteratorDestroy(j);
     }
   indexiteratorDestroy(i);
 
-  classInvokeInstanceMethod(o, NULL, "DESTROY", NULL);
+  static uint32_t destroyAtom = 0;
+  if (destroyAtom == 0)
+    destroyAtom = atomIntern ("DESTROY");
+  classInvokeInstanceMethodAtom(o, NULL, destroyAtom, NULL);
 }
 
 /* METHOD
@@ -341,10 +455,14 @@ objectCGetProperty(struct Object *o, const struct Tuple *args)
     return tupleBuildError(tb_string("Property not found"));
 
   const struct Value *property = objectGetProperty (o, name);
-  if (property)
-    return tupleBuild(tb_value(*property));
-  else
+  if (!property)
     return tupleBuild();
+
+  /* the tuple owns its values, so give it a copy of the property's */
+  struct Value *copy = valueDup (property);
+  struct Tuple *t = tupleBuild(tb_value(*copy));
+  yfree (copy);
+  return t;
 }
 
 /* METHOD
@@ -39,9 +39,13 @@ int objectKeyFunction (const void *, const void *);
 const struct Value *objectGetProperty (struct Object *, const char *);
 bool objectSetProperty(struct Object *, const char *, const struct Value *);
 
+bool         objectSignalSubscribed (const struct Object *, const char *);
 void         objectEmitSignal_(struct Object *, const char *, struct Tuple *);
-#define      objectEmitSignal(obj, name, ...) \
-  objectEmitSignal_(obj, name, tupleBuild(tb_string(name), ##__VA_ARGS__))
+/* Only build the event if some client will receive it */
+#define      objectEmitSignal(obj, name, ...)                                 \
+  ({ struct Object *o_ = (obj);                                           \
+     if (objectSignalSubscribed (o_, name))                               \
+       objectEmitSignal_(o_, name, tupleBuild(tb_string(name), ##__VA_ARGS__)); })
 
 bool         objectSubscribeSignal (struct Client *, struct Object *, const char *);
 void         objectUnsubscribeSignal (struct Client *, struct Object *, const char *);
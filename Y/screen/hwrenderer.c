@@ -46,6 +46,7 @@ struct RendererClass hwrendererClass =
   destroy:             hwrendererDestroy,
   renderBuffer:        hwrendererRenderBuffer,
   blitRGBAData:        hwrendererBlitRGBAData,
+  copyRGBAData:        NULL,
   drawFilledRectangle: hwrendererDrawFilledRectangle
 };
 
@@ -140,6 +140,22 @@ rendererLeave (struct Renderer *self)
     }
 }
 
+bool
+rendererGetClip (struct Renderer *self, struct Rectangle *rect)
+{
+  struct RenderRegion *reg;
+  if (self == NULL)
+    return false;
+  reg = llist_node_data (llist_head (self -> regions));
+  if (reg == NULL)
+    return false;
+  rect -> x = reg -> clip.x - reg -> translateX;
+  rect -> y = reg -> clip.y - reg -> translateY;
+  rect -> w = reg -> clip.w;
+  rect -> h = reg -> clip.h;
+  return true;
+}
+
 bool
 rendererRenderBuffer (struct Renderer *self, struct Buffer *buffer,
                       int x, int y)
@@ -188,6 +204,30 @@ rendererBlitRGBAData (struct Renderer *self, int x, int y, const uint32_t *data,
     }
 }
 
+void
+rendererCopyRGBAData (struct Renderer *self, int x, int y, const uint32_t *data,
+                      int w, int h, int s)
+{
+  struct Rectangle r = { x, y, w, h };
+  struct Rectangle r2 = r;
+  if (self != NULL)
+    {
+      struct RenderRegion *reg = llist_node_data (llist_head (self->regions));
+      if (reg != NULL)
+        {
+          r.x += reg -> translateX;
+          r.y += reg -> translateY;
+          if (!rectangleIntersect (&r2, &r, &(reg -> clip)))
+            return;
+        }
+      data += (r2.x - r.x) + s * (r2.y - r.y);
+      if (self -> c -> copyRGBAData != NULL)
+        self -> c -> copyRGBAData (self, r2.x, r2.y, data, r2.w, r2.h, s);
+      else
+        self -> c -> blitRGBAData (self, r2.x, r2.y, data, r2.w, r2.h, s);
+    }
+}
+
 void
 rendererDrawFilledRectangle (struct Renderer *self, uint32_t colour,
                              int x, int y, int w, int h)
@@ -58,6 +58,11 @@ int rendererEnter (struct Renderer *, const struct Rectangle *rect,
  */
 void rendererLeave (struct Renderer *);
 
+/* Get the clip rectangle of the current region, in the current region's
+ * co-ordinates.  Returns false if no region has been entered.
+ */
+bool rendererGetClip (struct Renderer *, struct Rectangle *rect);
+
 /* \brief attempt to render the buffer to the given co-ordinates
  *
  * \returns true if the buffer successfully rendered, or false if the
@@ -75,6 +80,13 @@ bool rendererRenderBuffer (struct Renderer *, struct Buffer *, int x, int y);
 void rendererBlitRGBAData (struct Renderer *, int x, int y, const uint32_t *data,
                            int w, int h, int s);
 
+/* Copy a rectangle of RGBA data, as for rendererBlitRGBAData, where every
+ * pixel of the data is known to be fully opaque.  No blending is needed,
+ * so renderers may copy the data straight across.
+ */
+void rendererCopyRGBAData (struct Renderer *, int x, int y, const uint32_t *data,
+                           int w, int h, int s);
+
 /* Draw a rectangle filled with a solid colour, COLOUR. The rectangle should
  * placed with the upper-left corner at the device independent co-ordinates
  * (X,Y), and be W by H in size.
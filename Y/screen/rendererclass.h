@@ -41,6 +41,9 @@ struct RendererClass
                         int, int, int, int);
   void (*blitRGBAData) (struct Renderer *, int, int, const uint32_t *,
                         int, int, int);
+  /* optional: falls back to blitRGBAData */
+  void (*copyRGBAData) (struct Renderer *, int, int, const uint32_t *,
+                        int, int, int);
   void (*drawFilledRectangle) (struct Renderer *, uint32_t,
                                int, int, int, int);
 };
@@ -18,16 +18,27 @@
 
 #include <Y/object/class.h>
 #include <Y/screen/screen.h>
+#include <Y/main/config.h>
 #include <Y/util/yutil.h>
 #include <Y/util/index.h>
+#include <Y/util/region.h>
+#include <Y/util/colourspan.h>
+#include <Y/util/log.h>
 
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 static struct Index *viewports;
 static struct Widget *rootWidget = NULL;
 static struct Rectangle *screenRectangle = NULL;
+static bool screenCompositing = false;
+/* damage that arrived while compositing, for the next frame */
+static struct Region *screenPendingDamage = NULL;
+static pthread_mutex_t screenPendingDamageLock = PTHREAD_MUTEX_INITIALIZER;
+/* the refresh rate viewports aim for, or 0 for their display's own */
+static int screenRefreshRate = 0;
 
 DEFINE_CLASS(Screen);
 #include "Screen.yc"
@@ -135,11 +146,86 @@ viewportCCall (const struct Tuple *args)
   return viewportCall (vp, &vargs);
 }
 
+/* METHOD
+ * setRefreshRate :: (uint32, uint32) -> ()
+ */
+struct Tuple *
+viewportCSetRefreshRate (const struct Tuple *args)
+{
+  uint32_t vpid = args->list[0].uint32;
+  struct Viewport *vp = indexFind (viewports, &vpid);
+
+  if (vp == NULL)
+    return tupleBuildError (tb_string ("No such viewport"));
+  viewportSetRefreshRate (vp, args->list[1].uint32);
+  return NULL;
+}
+
+/* Returns the number of frames shown, the mean and worst time from
+ * damage to its being shown and the mean and worst time taken to render
+ * and show a frame, in microseconds, and the target refresh rate.
+ */
+/* METHOD
+ * frameStatistics :: (uint32) -> (uint32, uint32, uint32, uint32, uint32, uint32)
+ */
+struct Tuple *
+viewportCFrameStatistics (const struct Tuple *args)
+{
+  uint32_t vpid = args->list[0].uint32;
+  struct Viewport *vp = indexFind (viewports, &vpid);
+  struct ViewportFrameStatistics stats;
+
+  if (vp == NULL)
+    return tupleBuildError (tb_string ("No such viewport"));
+  viewportGetFrameStatistics (vp, &stats);
+  return tupleBuild (tb_uint32 (stats.frames),
+                     tb_uint32 (stats.frames ? stats.totalLatency / stats.frames : 0),
+                     tb_uint32 (stats.maxLatency),
+                     tb_uint32 (stats.frames ? stats.totalFrameTime / stats.frames : 0),
+                     tb_uint32 (stats.maxFrameTime),
+                     tb_uint32 (viewportGetRefreshRate (vp)));
+}
+
+/* METHOD
+ * resetFrameStatistics :: (uint32) -> ()
+ */
+struct Tuple *
+viewportCResetFrameStatistics (const struct Tuple *args)
+{
+  uint32_t vpid = args->list[0].uint32;
+  struct Viewport *vp = indexFind (viewports, &vpid);
+
+  if (vp == NULL)
+    return tupleBuildError (tb_string ("No such viewport"));
+  viewportResetFrameStatistics (vp);
+  return NULL;
+}
+
 void
-screenInitialise ()
+screenInitialise (struct Config *serverConfig)
 {
   viewports = indexCreate (viewportsKeyFunction, viewportsComparisonFunction);
   screenRectangle = rectangleCreate (0, 0, 800, 600);
+  screenPendingDamage = regionCreate ();
+  /* choose the span code now, before any compositing threads start */
+  colourspanSetImplementation (COLOURSPAN_IMPLEMENTATION_AUTO);
+
+  struct TupleType refreshType = {.count = 1, .list = (enum Type []) {t_uint32}};
+  struct Tuple *refreshTuple = configGet(serverConfig, "screen", "refresh", &refreshType);
+  if (refreshTuple)
+    {
+      if (refreshTuple->error)
+        Y_WARN("Error retrieving screen:refresh from config file: %s", refreshTuple->list[0].string.data);
+      else
+        screenRefreshRate = refreshTuple->list[0].uint32;
+      tupleDestroy(refreshTuple);
+    }
+}
+
+int
+screenGetRefreshRate (void)
+{
+  return screenRefreshRate;
 }
 
 void
@@ -222,6 +308,17 @@ screenInvalidateRectangle (struct Rectangle *r)
 {
   struct IndexIterator *iterator;
 
+  if (screenCompositing)
+    {
+      /* the viewports are busy with the current frame; hold on to it
+       * until they have finished */
+      pthread_mutex_lock (&screenPendingDamageLock);
+      regionUnionRectangle (screenPendingDamage, r);
+      pthread_mutex_unlock (&screenPendingDamageLock);
+      rectangleDestroy (r);
+      return;
+    }
+
   /* for each viewport, call viewportInvalidateRectangle */
   iterator = indexGetStartIterator (viewports);
   while (indexiteratorHasValue (iterator))
@@ -288,6 +385,34 @@ screenUpdate ()
 
 }
 
+void
+screenPrepareRender (void)
+{
+  pointerGetCurrentImage ();
+  widgetPrepareRender (rootWidget);
+}
+
+void
+screenBeginCompositing (void)
+{
+  screenCompositing = true;
+}
+
+void
+screenEndCompositing (void)
+{
+  const struct Rectangle *rects;
+  int count;
+
+  screenCompositing = false;
+
+  rects = regionGetRectangles (screenPendingDamage, &count);
+  for (int i = 0; i < count; ++i)
+    screenInvalidateRectangle (rectangleCreate (rects[i].x, rects[i].y,
+                                                rects[i].w, rects[i].h));
+  regionClear (screenPendingDamage);
+}
+
 void
 screenRender (struct Renderer *renderer)
 {
@@ -332,6 +457,7 @@ void
 screenFinalise ()
 {
   rectangleDestroy (screenRectangle);
+  regionDestroy (screenPendingDamage);
   indexDestroy (viewports, NULL);
 }
 
@@ -22,10 +22,11 @@
 #include <Y/screen/viewport.h>
 #include <Y/util/rectangle.h>
 #include <Y/widget/widget.h>
+#include <Y/main/config.h>
 
 /* There is only one screen, so it is not an object */
 
-void           screenInitialise (void);
+void           screenInitialise (struct Config *);
 void           screenFinalise (void);
 
 void           screenRegisterViewport  (struct Viewport *);
@@ -40,7 +41,22 @@ void           screenInvalidateRectangle (struct Rectangle *);
 
 void           screenViewportsChanged (void);
 
+/* The refresh rate in Hz that viewports should aim for, as configured,
+ * or 0 to use their display's own. */
+int            screenGetRefreshRate (void);
+
 void           screenUpdate (void);
+
+/* Rendering happens in two phases.  screenPrepareRender brings every
+ * widget's buffers up to date, on the main thread.  Between
+ * screenBeginCompositing and screenEndCompositing the widget tree is
+ * only read, so screenRender may be run on several renderers at once
+ * from different threads.  Anything invalidated while compositing is
+ * held back, and invalidated once compositing ends.
+ */
+void           screenPrepareRender (void);
+void           screenBeginCompositing (void);
+void           screenEndCompositing (void);
 void           screenRender (struct Renderer *);
 
 #endif
@@ -22,10 +22,14 @@
 #include <Y/util/yutil.h>
 #include <Y/util/colour.h>
 
+#include <string.h>
+
 static void simplerendererComplete (struct Renderer *);
 static void simplerendererDestroy (struct Renderer *);
 static void simplerendererBlitRGBAData (struct Renderer *, int, int,
                                         const uint32_t *, int, int, int);
+static void simplerendererCopyRGBAData (struct Renderer *, int, int,
+                                        const uint32_t *, int, int, int);
 static void simplerendererDrawFilledRectangle (struct Renderer *, uint32_t,
                                                int, int, int, int);
 
@@ -44,6 +48,7 @@ struct RendererClass simplerendererClass =
   destroy:             simplerendererDestroy,
   renderBuffer:        NULL,
   blitRGBAData:        simplerendererBlitRGBAData,
+  copyRGBAData:        simplerendererCopyRGBAData,
   drawFilledRectangle: simplerendererDrawFilledRectangle
 };
 
@@ -113,6 +118,20 @@ simplerendererBlitRGBAData (struct Renderer *self_r, int x, int y,
     }
 }
 
+void
+simplerendererCopyRGBAData (struct Renderer *self_r, int x, int y,
+                            const uint32_t *data, int w, int h, int s)
+{
+  struct SimpleRenderer *self = castBack (self_r);
+  int j;
+  for (j=0; j < h; ++j)
+    {
+      uint32_t *toLine = self -> data + self -> w * (y + j - self -> y)
+                                          + (x - self -> x);
+      memcpy (toLine, data + s * j, w * sizeof (uint32_t));
+    }
+}
+
 void
 simplerendererDrawFilledRectangle (struct Renderer *self_r, uint32_t colour,
                                int x, int y, int w, int h)
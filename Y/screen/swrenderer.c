@@ -20,21 +20,33 @@
 #include <Y/screen/rendererclass.h>
 #include <Y/modules/videodriver_interface.h>
 #include <Y/util/yutil.h>
-#include <Y/util/colour.h>
+#include <Y/util/region.h>
+#include <Y/util/colourspan.h>
+
+#include <string.h>
 
 static void swrendererComplete (struct Renderer *);
 static void swrendererDestroy (struct Renderer *);
 static void swrendererBlitRGBAData (struct Renderer *, int, int,
                                     const uint32_t *, int, int, int);
+static void swrendererCopyRGBAData (struct Renderer *, int, int,
+                                    const uint32_t *, int, int, int);
 static void swrendererDrawFilledRectangle (struct Renderer *, uint32_t,
                                            int, int, int, int);
 
-struct SWRenderer
+struct SWBackBuffer
 {
-  struct Renderer renderer;
   struct VideoDriver *video;
-  int x, y, w, h;
+  int w, h;
   uint32_t *data;
+  struct Region *damage;
+};
+
+struct SWRenderer
+{
+  struct Renderer renderer;
+  struct SWBackBuffer *backBuffer;
+  struct Rectangle rect;
 };
 
 struct RendererClass swrendererClass =
@@ -44,6 +56,7 @@ struct RendererClass swrendererClass =
   destroy:             swrendererDestroy,
   renderBuffer:        NULL,
   blitRGBAData:        swrendererBlitRGBAData,
+  copyRGBAData:        swrendererCopyRGBAData,
   drawFilledRectangle: swrendererDrawFilledRectangle
 };
 
@@ -54,19 +67,80 @@ castBack (struct Renderer *self_r)
   return (struct SWRenderer *)self_r;
 }
 
+struct SWBackBuffer *
+swbackbufferCreate (struct VideoDriver *video)
+{
+  struct SWBackBuffer *self = ymalloc (sizeof (struct SWBackBuffer));
+  self -> video = video;
+  self -> w = 0;
+  self -> h = 0;
+  self -> data = NULL;
+  self -> damage = regionCreate ();
+  return self;
+}
+
+void
+swbackbufferDestroy (struct SWBackBuffer *self)
+{
+  if (self == NULL)
+    return;
+  regionDestroy (self -> damage);
+  yfree (self -> data);
+  yfree (self);
+}
+
+/* keep the back buffer the same size as the display */
+static void
+swbackbufferCheckSize (struct SWBackBuffer *self)
+{
+  int w, h;
+  self -> video -> getPixelDimensions (self -> video, &w, &h);
+  if (w == self -> w && h == self -> h)
+    return;
+  yfree (self -> data);
+  self -> w = MAX (w, 0);
+  self -> h = MAX (h, 0);
+  self -> data = ymalloc (self -> w * self -> h * sizeof (uint32_t));
+  regionClear (self -> damage);
+}
+
+void
+swbackbufferPresent (struct SWBackBuffer *self)
+{
+  const struct Rectangle *rects;
+  int count;
+
+  rects = regionGetRectangles (self -> damage, &count);
+  for (int i = 0; i < count; ++i)
+    self -> video -> blit (self -> video,
+                           self -> data + rects[i].y * self -> w + rects[i].x,
+                           rects[i].x, rects[i].y, rects[i].w, rects[i].h,
+                           self -> w);
+  regionClear (self -> damage);
+}
+
 struct SWRenderer *
-swrendererCreate (struct VideoDriver *video, const struct Rectangle *rect)
+swrendererCreate (struct SWBackBuffer *backBuffer, const struct Rectangle *rect)
 {
   struct SWRenderer *self = ymalloc (sizeof (struct SWRenderer));
+  struct Rectangle bounds;
   self -> renderer.c = &swrendererClass;
   rendererInitialise (&(self -> renderer));
-  self -> video = video;
-  self -> x = rect -> x;
-  self -> y = rect -> y;
-  self -> w = rect -> w;
-  self -> h = rect -> h;
-  self -> data = ymalloc (self -> w * self -> h * sizeof (uint32_t));
-  rendererEnter (&(self -> renderer), rect, 0, 0);
+  self -> backBuffer = backBuffer;
+  swbackbufferCheckSize (backBuffer);
+  bounds.x = 0;
+  bounds.y = 0;
+  bounds.w = backBuffer -> w;
+  bounds.h = backBuffer -> h;
+  if (!rectangleIntersect (&(self -> rect), rect, &bounds))
+    {
+      self -> rect.w = 0;
+      self -> rect.h = 0;
+    }
+  rendererEnter (&(self -> renderer), &(self -> rect), 0, 0);
+  /* renderers only touch their own part of the back buffer until they
+   * complete, so several may render at once */
+  rendererSetOption (&(self -> renderer), "concurrent", "yes");
   return self;
 }
 
@@ -74,7 +148,6 @@ static void
 swrendererDestroy (struct Renderer *self_r)
 {
   struct SWRenderer *self = castBack (self_r);
-  yfree (self -> data);
   yfree (self);
 }
 
@@ -88,49 +161,38 @@ void
 swrendererBlitRGBAData (struct Renderer *self_r, int x, int y,
                         const uint32_t *data, int w, int h, int s)
 {
-  struct SWRenderer *self = castBack (self_r);
-  int i, j;
+  struct SWBackBuffer *backBuffer = castBack (self_r) -> backBuffer;
+  int j;
   for (j=0; j < h; ++j)
     {
-      uint32_t *toLine = self -> data + self -> w * (y + j - self -> y)
-                                          + (x - self -> x);
-      const uint32_t *frLine = data + s * j;
-      for (i=0; i < w; ++i)
-        {
-          colourBlendSourceOver (toLine, *toLine, *frLine, 0xFF);
-          ++toLine; ++frLine;
-        }
+      uint32_t *toLine = backBuffer -> data + backBuffer -> w * (y + j) + x;
+      colourspanSourceOver (toLine, data + s * j, w);
     }
 }
 
 void
-swrendererDrawFilledRectangle (struct Renderer *self_r, uint32_t colour,
-                               int x, int y, int w, int h)
+swrendererCopyRGBAData (struct Renderer *self_r, int x, int y,
+                        const uint32_t *data, int w, int h, int s)
 {
-  struct SWRenderer *self = castBack (self_r);
-  int i, j;
-  if ((colour & 0xFF000000) == 0xFF000000)
+  struct SWBackBuffer *backBuffer = castBack (self_r) -> backBuffer;
+  int j;
+  for (j=0; j < h; ++j)
     {
-      for (j=0; j<h; ++j)
-        {
-          uint32_t *line = self -> data + self -> w * (y + j - self -> y)
-                                            + (x - self -> x);
-          for (i=0; i<w; ++i)
-            *(line++) = colour;
-        }
+      uint32_t *toLine = backBuffer -> data + backBuffer -> w * (y + j) + x;
+      memcpy (toLine, data + s * j, w * sizeof (uint32_t));
     }
-  else
+}
+
+void
+swrendererDrawFilledRectangle (struct Renderer *self_r, uint32_t colour,
+                               int x, int y, int w, int h)
+{
+  struct SWBackBuffer *backBuffer = castBack (self_r) -> backBuffer;
+  int j;
+  for (j=0; j<h; ++j)
     {
-      for (j=0; j<h; ++j)
-        {
-          uint32_t *line = self -> data + self -> w * (y + j - self -> y)
-                                            + (x - self -> x);
-          for (i=0; i<w; ++i)
-            {
-              colourBlendSourceOver (line, *line, colour, 0xFF);
-              ++line;
-            }
-        }
+      uint32_t *line = backBuffer -> data + backBuffer -> w * (y + j) + x;
+      colourspanFillSourceOver (line, colour, w);
     }
 }
 
@@ -138,8 +200,8 @@ void
 swrendererComplete (struct Renderer *self_r)
 {
   struct SWRenderer *self = castBack (self_r);
-  self -> video -> blit (self -> video, self -> data,
-                         self -> x, self -> y, self -> w, self -> h, self -> w);
+  /* the pixels are presented with the rest of the update */
+  regionUnionRectangle (self -> backBuffer -> damage, &(self -> rect));
 }
 
 /* arch-tag: d1a749d1-8e4f-4837-8a4e-8920bb63877d
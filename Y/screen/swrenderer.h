@@ -25,7 +25,20 @@ struct SWRenderer;
 #include <Y/modules/videodriver_interface.h>
 #include <Y/util/rectangle.h>
 
-struct SWRenderer *swrendererCreate (struct VideoDriver *,
+struct SWBackBuffer;
+
+/* A SWBackBuffer is a long-lived copy of the whole video display, owned
+ * by the video driver.  SWRenderers draw into the part of it they cover,
+ * and the driver presents the parts that were drawn when it finishes
+ * its updates.
+ */
+struct SWBackBuffer *swbackbufferCreate (struct VideoDriver *);
+void                 swbackbufferDestroy (struct SWBackBuffer *);
+
+/* Blit everything rendered since the last present to the video driver. */
+void                 swbackbufferPresent (struct SWBackBuffer *);
+
+struct SWRenderer *swrendererCreate (struct SWBackBuffer *,
                                      const struct Rectangle *);
 struct Renderer   *swrendererGetRenderer (struct SWRenderer *);
 
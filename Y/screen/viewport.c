@@ -21,19 +21,42 @@
 #include <Y/screen/swrenderer.h>
 #include <Y/main/control.h>
 #include <Y/util/llist.h>
+#include <Y/util/region.h>
+#include <Y/util/threadpool.h>
 #include <Y/util/yutil.h>
+#include <Y/util/log.h>
 
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+
+/* Large updates are split into tiles of this size and composited by a
+ * pool of threads, one per processor, shared by every viewport.
+ */
+#define VIEWPORT_TILE_SIZE 256
+#define VIEWPORT_MAX_THREADS 16
+
+/* used when neither the configuration nor the display give a rate */
+#define VIEWPORT_DEFAULT_REFRESH_RATE 60
+
+static struct ThreadPool *viewportThreadPool = NULL;
 
 struct Viewport
 {
   int id;
   struct VideoDriver *video;
-  struct llist *invalidRectangles;
+  struct Region *invalidRegion;
   int updateEventID;
   int x, y, w, h;
+
+  /* frames are started at least this many microseconds apart */
+  int refreshRate;
+  int64_t frameInterval;
+  int64_t lastFrame;
+  /* when the oldest damage not yet shown was done, or 0 */
+  int64_t damageTime;
+  struct ViewportFrameStatistics statistics;
 };
 
 static int nextViewportID = 0;
@@ -44,7 +67,7 @@ viewportCreate (struct VideoDriver *video)
   struct Viewport *self = ymalloc (sizeof (struct Viewport));
   self -> id = nextViewportID++;
   self -> video = video;
-  self -> invalidRectangles = new_llist ();
+  self -> invalidRegion = regionCreate ();
   self -> x = 0;
   self -> y = 0;
   video -> getPixelDimensions (video, &(self -> w), &(self -> h)); 
@@ -53,6 +76,17 @@ viewportCreate (struct VideoDriver *video)
   if (self -> h <= 0)
     self -> h = 600;
   self -> updateEventID = 0;
+  self -> lastFrame = 0;
+  self -> damageTime = 0;
+  viewportResetFrameStatistics (self);
+
+  if (screenGetRefreshRate () > 0)
+    viewportSetRefreshRate (self, screenGetRefreshRate ());
+  else if (video -> getRefreshRate != NULL
+           && video -> getRefreshRate (video) > 0)
+    viewportSetRefreshRate (self, video -> getRefreshRate (video));
+  else
+    viewportSetRefreshRate (self, VIEWPORT_DEFAULT_REFRESH_RATE);
 
 #if 0
   if (video -> setPointer)
@@ -68,7 +102,9 @@ viewportCreate (struct VideoDriver *video)
 void
 viewportDestroy (struct Viewport *self)
 {
-  llist_destroy (self->invalidRectangles, rectangleDestroy);
+  if (self -> updateEventID != 0)
+    controlCancelTimerDelay (self -> updateEventID);
+  regionDestroy (self -> invalidRegion);
   yfree (self);
 }
 
@@ -89,15 +125,59 @@ viewportGetRectangle (struct Viewport *self)
   return rect;
 }
 
+void
+viewportSetRefreshRate (struct Viewport *self, int hz)
+{
+  self -> refreshRate = MAX (hz, 1);
+  self -> frameInterval = 1000000 / self -> refreshRate;
+}
+
+int
+viewportGetRefreshRate (const struct Viewport *self)
+{
+  return self -> refreshRate;
+}
+
+void
+viewportGetFrameStatistics (const struct Viewport *self,
+                            struct ViewportFrameStatistics *statistics)
+{
+  *statistics = self -> statistics;
+}
+
+void
+viewportResetFrameStatistics (struct Viewport *self)
+{
+  memset (&(self -> statistics), 0, sizeof (self -> statistics));
+}
+
+static void
+viewportFrame (void *self_v)
+{
+  struct Viewport *self = self_v;
+  self -> updateEventID = 0;
+  viewportUpdate (self);
+}
+
 void
 viewportInvalidateRectangle (struct Viewport *self, const struct Rectangle *r)
 {
-  llist_add_tail (self->invalidRectangles, rectangleDuplicate (r));
-  if (self -> updateEventID == 0)
-    {
-      self -> updateEventID =
-        controlTimerDelay (0, 10, self, (void (*)(void *))viewportUpdate);
-    }
+  int64_t now, delay;
+
+  if (r -> w <= 0 || r -> h <= 0)
+    return;
+  regionUnionRectangle (self -> invalidRegion, r);
+  if (self -> updateEventID != 0)
+    return;
+
+  /* show it with everything else done before the next frame is due */
+  now = controlGetTime ();
+  if (self -> damageTime == 0)
+    self -> damageTime = now;
+  delay = MAX (self -> lastFrame + self -> frameInterval - now, 0);
+  delay = (delay + 999) / 1000;
+  self -> updateEventID = controlTimerDelay (delay / 1000, delay % 1000,
+                                             self, viewportFrame);
 }
 
 void
@@ -145,48 +225,160 @@ viewportSetResolution (struct Viewport *self, const char *name)
     self -> video -> setResolution (self -> video, name);
 }
 
+static struct ThreadPool *
+viewportGetThreadPool (void)
+{
+  if (viewportThreadPool == NULL)
+    {
+      long processors = sysconf (_SC_NPROCESSORS_ONLN);
+      if (processors < 1)
+        processors = 1;
+      viewportThreadPool =
+        threadpoolCreate (MIN (processors, VIEWPORT_MAX_THREADS));
+    }
+  return viewportThreadPool;
+}
+
+/* Split the rectangles of REGION along a grid of tiles, so the work can
+ * be shared out evenly.  Returns a newly allocated array.
+ */
+static struct Rectangle *
+viewportSplitIntoTiles (const struct Region *region, int *count_p)
+{
+  const struct Rectangle *rects;
+  struct Rectangle *tiles;
+  int count, tileCount = 0, size = 0;
+
+  rects = regionGetRectangles (region, &count);
+  for (int i = 0; i < count; ++i)
+    {
+      int columns = (rects[i].x + rects[i].w - 1) / VIEWPORT_TILE_SIZE
+                    - rects[i].x / VIEWPORT_TILE_SIZE + 1;
+      int rows = (rects[i].y + rects[i].h - 1) / VIEWPORT_TILE_SIZE
+                 - rects[i].y / VIEWPORT_TILE_SIZE + 1;
+      size += columns * rows;
+    }
+
+  tiles = ymalloc (sizeof (struct Rectangle) * MAX (size, 1));
+  for (int i = 0; i < count; ++i)
+    {
+      const struct Rectangle *r = rects + i;
+      for (int y = r -> y; y < r -> y + r -> h;
+           y = (y / VIEWPORT_TILE_SIZE + 1) * VIEWPORT_TILE_SIZE)
+        {
+          int h = MIN ((y / VIEWPORT_TILE_SIZE + 1) * VIEWPORT_TILE_SIZE,
+                       r -> y + r -> h) - y;
+          for (int x = r -> x; x < r -> x + r -> w;
+               x = (x / VIEWPORT_TILE_SIZE + 1) * VIEWPORT_TILE_SIZE)
+            {
+              struct Rectangle *tile = tiles + tileCount++;
+              tile -> x = x;
+              tile -> y = y;
+              tile -> w = MIN ((x / VIEWPORT_TILE_SIZE + 1) * VIEWPORT_TILE_SIZE,
+                               r -> x + r -> w) - x;
+              tile -> h = h;
+            }
+        }
+    }
+
+  *count_p = tileCount;
+  return tiles;
+}
+
+static void
+viewportRenderTile (void *renderers_v, int index)
+{
+  struct Renderer **renderers = renderers_v;
+  screenRender (renderers[index]);
+}
+
 void
 viewportUpdate (struct Viewport *self)
 {
-  struct Rectangle *viewportRectangle = viewportGetRectangle (self);
+  struct Rectangle viewportRectangle = { self -> x, self -> y,
+                                         self -> w, self -> h };
+  struct ThreadPool *pool = viewportGetThreadPool ();
+  struct Region *invalid;
+  struct Rectangle *tiles;
+  struct Renderer **renderers;
+  bool concurrent = (threadpoolGetThreads (pool) > 1);
+  int64_t frameStart = controlGetTime (), damageTime, frameEnd;
+  int count;
 
-  if (llist_length (self -> invalidRectangles) == 0)
-    return;
+  /* bring the widgets up to date first, so that anything they
+   * invalidate while repainting is included in this update */
+  screenPrepareRender ();
 
-  rectanglelistUnionOverlaps (self -> invalidRectangles);
+  if (self -> updateEventID != 0)
+    {
+      controlCancelTimerDelay (self -> updateEventID);
+      self -> updateEventID = 0;
+    }
+  invalid = self -> invalidRegion;
+  self -> invalidRegion = regionCreate ();
+  damageTime = self -> damageTime ? self -> damageTime : frameStart;
+  self -> damageTime = 0;
+
+  regionIntersectRectangle (invalid, &viewportRectangle);
+  if (regionIsEmpty (invalid))
+    {
+      regionDestroy (invalid);
+      return;
+    }
+  self -> lastFrame = frameStart;
+
+  /* create a renderer (visitor) for each tile of the damaged region */
+  tiles = viewportSplitIntoTiles (invalid, &count);
+  renderers = ymalloc (sizeof (struct Renderer *) * count);
 
   self -> video -> beginUpdates (self -> video);
 
-  /* for each rectangle in the collection */
-  for (struct llist_node *node = llist_head (self->invalidRectangles);
-       node != NULL;
-       node = llist_node_next (node))
+  for (int i = 0; i < count; ++i)
     {
-      /* compute the intersected rectangle */
-      struct Rectangle *invalid = llist_node_data (node);
-      struct Rectangle *visible = ymalloc (sizeof (struct Rectangle));
-      if (rectangleIntersect (visible, invalid, viewportRectangle))
-        {
-          /* create a renderer (visitor) and pass it over the widget structure
-           */
-          struct Renderer *renderer =
-                  self -> video -> getRenderer (self -> video, visible);
-          screenRender (renderer);
-          rendererComplete (renderer);
-          rendererDestroy (renderer);
-        }
-      rectangleDestroy (visible);
+      renderers[i] = self -> video -> getRenderer (self -> video, tiles + i);
+      if (renderers[i] == NULL
+          || rendererGetOption (renderers[i], "concurrent") == NULL)
+        concurrent = false;
+    }
+
+  /* and pass them over the widget structure */
+  screenBeginCompositing ();
+  if (concurrent)
+    threadpoolRun (pool, count, viewportRenderTile, renderers);
+  else
+    {
+      for (int i = 0; i < count; ++i)
+        if (renderers[i] != NULL)
+          screenRender (renderers[i]);
     }
+  screenEndCompositing ();
 
-  rectangleDestroy (viewportRectangle);
+  for (int i = 0; i < count; ++i)
+    {
+      rendererComplete (renderers[i]);
+      rendererDestroy (renderers[i]);
+    }
 
+  if (self -> video -> waitForVSync != NULL
+      && self -> video -> waitForVSync (self -> video) != 0)
+    {
+      Y_WARN ("Viewport %d can't wait for vertical blank", self -> id);
+      self -> video -> waitForVSync = NULL;
+    }
   self -> video -> endUpdates (self -> video);
 
-  llist_destroy (self->invalidRectangles, rectangleDestroy);
-  self -> invalidRectangles = new_llist ();
-
-  self -> updateEventID = 0;
+  frameEnd = controlGetTime ();
+  self -> statistics.frames++;
+  self -> statistics.totalLatency += frameEnd - damageTime;
+  self -> statistics.maxLatency = MAX (self -> statistics.maxLatency,
+                                       (uint32_t)(frameEnd - damageTime));
+  self -> statistics.totalFrameTime += frameEnd - frameStart;
+  self -> statistics.maxFrameTime = MAX (self -> statistics.maxFrameTime,
+                                         (uint32_t)(frameEnd - frameStart));
 
+  yfree (renderers);
+  yfree (tiles);
+  regionDestroy (invalid);
 }
 
 /* arch-tag: 24ab628b-2e9c-4bd2-9e84-f5428e71b764
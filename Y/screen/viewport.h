@@ -24,6 +24,7 @@ struct Viewport;
 #include <Y/modules/videodriver_interface.h>
 #include <Y/util/llist.h>
 #include <Y/util/rectangle.h>
+#include <stdint.h>
 
 /*
  * A Viewport is the concept of a view onto the abstract display.
@@ -55,10 +56,32 @@ void              viewportSetResolution (struct Viewport *, const char *name);
 /* Get the device independent co-ordinates of the Viewport. */
 struct Rectangle *viewportGetRectangle (struct Viewport *);
 
-/* Invalidate a region of the viewport. */
+/* Invalidate a region of the viewport.  Everything invalidated is
+ * shown together in the next frame, and frames are shown no more often
+ * than the viewport's refresh rate. */
 void              viewportInvalidateRectangle (struct Viewport *,
                                                const struct Rectangle *);
 
+/* Set the number of frames per second the viewport aims for. */
+void              viewportSetRefreshRate (struct Viewport *, int hz);
+int               viewportGetRefreshRate (const struct Viewport *);
+
+/* Times are in microseconds. */
+struct ViewportFrameStatistics
+{
+  uint32_t frames;
+  /* from the first damage in a frame until the frame is shown */
+  uint64_t totalLatency;
+  uint32_t maxLatency;
+  /* from the start of rendering a frame until it is shown */
+  uint64_t totalFrameTime;
+  uint32_t maxFrameTime;
+};
+
+void              viewportGetFrameStatistics (const struct Viewport *,
+                                              struct ViewportFrameStatistics *);
+void              viewportResetFrameStatistics (struct Viewport *);
+
 void              viewportSetSize (struct Viewport *, int, int);
 
 /* Cause the viewport to update itself. */ 
@@ -17,6 +17,7 @@
  */
 
 #include <Y/text/font.h>
+#include <Y/text/glyphcache.h>
 
 #include <Y/buffer/painterclass.h>
 #include <Y/util/index.h>
@@ -28,6 +29,7 @@
 #include FT_IMAGE_H
 #include FT_GLYPH_H
 #include FT_SIZES_H
+#include FT_OUTLINE_H
 
 #include <string.h>
 #include <unistd.h>
@@ -266,6 +268,7 @@ fontInitialise (struct Config *serverConfig)
 void
 fontFinalise ()
 {
+  glyphcacheFinalise ();
   indexDestroy (faces, (void (*)(void *))faceDestroy);
   FT_Done_FreeType (ft_library);
 }
@@ -273,8 +276,8 @@ fontFinalise ()
 struct FontGlyph
 {
   FT_UInt   index;
-  FT_Vector pos;
-  FT_Glyph  image;
+  /* pixels from the origin to the glyph's pen position */
+  int       x;
 };
 
 struct FontString
@@ -354,17 +357,78 @@ fontGetMetrics (struct Font *self, int *ascent_p, int *descent_p, int *linegap_p
   
 }
 
+/* Fetch a glyph's bitmap from the glyph cache, rasterising it first
+ * if it isn't there.  The font's size must be active. */
+static const struct CachedGlyph *
+fontGetGlyph (struct Font *self, FT_UInt index)
+{
+  struct CachedGlyph metrics;
+  const struct CachedGlyph *glyph;
+  FT_GlyphSlot slot = self -> ft_face -> glyph;
+  FT_BBox bbox;
+  bool outline;
+
+  metrics.key.face = self -> face;
+  metrics.key.size = self -> ptSize;
+  metrics.key.index = index;
+  glyph = glyphcacheFind (&(metrics.key));
+  if (glyph != NULL)
+    return glyph;
+
+  if (FT_Load_Glyph (self -> ft_face, index, FT_LOAD_DEFAULT))
+    return NULL;
+
+  /* measure the outline, as the bitmap may be narrower */
+  outline = (slot -> format == ft_glyph_format_outline);
+  if (outline)
+    {
+      FT_Outline_Get_CBox (&(slot -> outline), &bbox);
+      metrics.xMin = bbox.xMin >> 6;
+      metrics.xMax = (bbox.xMax + 63) >> 6;
+    }
+
+  if (FT_Render_Glyph (slot, ft_render_mode_normal))
+    return NULL;
+
+  if (!outline)
+    {
+      metrics.xMin = slot -> bitmap_left;
+      metrics.xMax = slot -> bitmap_left + slot -> bitmap.width;
+    }
+  metrics.left = slot -> bitmap_left;
+  metrics.top = slot -> bitmap_top;
+  metrics.width = slot -> bitmap.width;
+  metrics.rows = slot -> bitmap.rows;
+  metrics.pitch = slot -> bitmap.pitch;
+  metrics.advance = slot -> advance.x;
+  return glyphcacheAdd (&metrics, slot -> bitmap.buffer);
+}
+
+static long
+fontGetKerning (struct Font *self, FT_UInt left, FT_UInt right)
+{
+  long delta;
+  if (!glyphcacheFindKerning (self -> face, self -> ptSize, left, right,
+                              &delta))
+    {
+      FT_Vector vector;
+      FT_Get_Kerning (self -> ft_face, left, right, ft_kerning_default,
+                      &vector);
+      delta = vector.x;
+      glyphcacheAddKerning (self -> face, self -> ptSize, left, right, delta);
+    }
+  return delta;
+}
+
 static struct FontString *
 fontstringGenerate (struct Font *self, const wchar_t *string)
 {
   struct FontString *fs = ymalloc (sizeof (struct FontString));
 
-  FT_GlyphSlot      slot = self->ft_face->glyph;
-  FT_BBox           glyph_bbox;
   FT_Bool           use_kerning;
   FT_UInt           previous;
-  FT_Error          error;
-  int               pen_x, pen_y, n;
+  long              pen_x;
+  int               n;
   struct FontGlyph *glyph;
 
   fs -> string_length = wcslen (string);
@@ -378,51 +442,44 @@ fontstringGenerate (struct Font *self, const wchar_t *string)
 
   FT_Activate_Size (self -> size);
 
-  pen_x = 0;   /* start at (0,0) !! */
-  pen_y = 0;
+  pen_x = 0;   /* in 26.6, from the origin */
 
-  fs -> num_glyphs  = 0;
   use_kerning = FT_HAS_KERNING(self -> ft_face);
   previous    = 0;
 
   glyph = fs -> glyphs;
   for (n = 0; n < fs -> string_length; n++)
     {
+      const struct CachedGlyph *cached;
+      int xMin, xMax;
+
       Y_SILENT ("string[%d]: 0x%08lx '%c'", n, string[n], (char)string[n]);
       glyph->index = FT_Get_Char_Index (self->ft_face, string[n]);
 
       if ( use_kerning && previous && glyph->index )
-        {
-          FT_Vector  delta;
-
-          FT_Get_Kerning( self->ft_face, previous, glyph->index,
-                          ft_kerning_default, &delta );
+        pen_x += fontGetKerning (self, previous, glyph->index);
 
-          pen_x += delta.x;
-        }
+      cached = fontGetGlyph (self, glyph->index);
+      if (cached == NULL) continue;
 
       /* store current pen position */
-      glyph->pos.x = pen_x;
-      glyph->pos.y = pen_y;
-
-      error = FT_Load_Glyph (self->ft_face, glyph->index, FT_LOAD_DEFAULT);
-      if (error) continue;
-
-      error = FT_Get_Glyph (self->ft_face->glyph, &glyph->image);
-      if (error) continue;
-
-      /* translate the glyph image now.. */
-      FT_Glyph_Transform (glyph->image, 0, &glyph->pos);
+      glyph->x = (pen_x + 32) >> 6;
 
-      /* calculate its bounds */
-      FT_Glyph_Get_CBox (fs->glyphs[n].image, ft_glyph_bbox_pixels,
-                         &glyph_bbox);
-      if (glyph_bbox.xMin < fs -> offset)
-        fs -> offset = glyph_bbox.xMin;
-      if (glyph_bbox.xMax > fs -> width)
-        fs -> width = glyph_bbox.xMax;
+      /* calculate its bounds; FreeType leaves the box of a blank glyph
+       * at the origin, wherever the glyph is */
+      xMin = cached->xMin;
+      xMax = cached->xMax;
+      if (xMin != xMax)
+        {
+          xMin += glyph->x;
+          xMax += glyph->x;
+        }
+      if (xMin < fs -> offset)
+        fs -> offset = xMin;
+      if (xMax > fs -> width)
+        fs -> width = xMax;
 
-      pen_x   += slot->advance.x;
+      pen_x   += cached->advance;
       previous = glyph->index;
 
       /* move to next glyph */
@@ -440,16 +497,27 @@ fontstringGenerate (struct Font *self, const wchar_t *string)
 static void
 fontstringDestroy (struct FontString *self)
 {
-  int n;
   if (self == NULL)
     return;
   yfree (self -> string);
-  for (n=0; n<self->num_glyphs; ++n)
-    FT_Done_Glyph (self->glyphs[n].image);
   yfree (self -> glyphs);
   yfree (self);
 }
 
+/* Lay out a string, reusing the last layout if it was of the same
+ * string.  The font's size must be active. */
+static struct FontString *
+fontGetString (struct Font *self, const wchar_t *string)
+{
+  if (self -> cachedString == NULL
+      || wcscmp (self -> cachedString -> string, string) != 0)
+    {
+       fontstringDestroy (self -> cachedString);
+       self -> cachedString = fontstringGenerate (self, string);
+    }
+  return self -> cachedString;
+}
+
 void
 fontDestroy (struct Font *self)
 {
@@ -472,14 +540,7 @@ fontMeasureWCString (struct Font *self, const wchar_t *string,
 
   FT_Activate_Size (self -> size);
 
-  if (self -> cachedString == NULL
-      || wcscmp (self -> cachedString -> string, string) != 0)
-    {
-       fontstringDestroy (self -> cachedString);
-       self -> cachedString = fontstringGenerate (self, string);
-    }
-
-  fs = self -> cachedString;
+  fs = fontGetString (self, string);
 
   if (offset_p != NULL)
     *offset_p = fs -> offset;
@@ -493,8 +554,6 @@ void
 fontRenderWCString (struct Font *self, struct Painter *painter,
                     const wchar_t *text, int x, int y)
 {
-  FT_Vector  start;
-  FT_Error   error;
   struct FontString *fs;
   int n;
 
@@ -505,58 +564,57 @@ fontRenderWCString (struct Font *self, struct Painter *painter,
 
   FT_Activate_Size (self -> size);
 
-  if (self -> cachedString == NULL
-      || wcscmp (self -> cachedString -> string, text) != 0)
+  fs = fontGetString (self, text);
+
+  /* the glyphs were cached when the string was laid out, but may have
+   * been pushed out since by others */
+  for ( n = 0; n < fs->num_glyphs; n++ )
     {
-       fontstringDestroy (self -> cachedString);
-       self -> cachedString = fontstringGenerate (self, text);
+      const struct CachedGlyph *glyph = fontGetGlyph (self, fs->glyphs[n].index);
+      if (glyph == NULL || glyph->bitmap == NULL)
+        continue;
+
+      painterDrawAlphamap (painter, glyph->bitmap,
+                           x + fs->glyphs[n].x + glyph->left, y - glyph->top,
+                           glyph->width, glyph->rows, glyph->pitch);
     }
+}
+
+void
+fontRenderWCStringAlphamap (struct Font *self, const wchar_t *text,
+                            uint8_t *alpha, int w, int h, int stride,
+                            int x, int y)
+{
+  struct FontString *fs;
+  int n;
 
-  start.x = x * 64;
-  start.y = -y * 64;
+  if (self == NULL)
+    return;
+  if (text == NULL)
+    return;
 
-  fs = self -> cachedString;
+  FT_Activate_Size (self -> size);
+
+  fs = fontGetString (self, text);
 
   for ( n = 0; n < fs->num_glyphs; n++ )
     {
-      FT_Glyph  image;
-      FT_BBox   bbox;
-
-      /* create a copy of the original glyph */
-      error = FT_Glyph_Copy( fs->glyphs[n].image, &image );
-      if (error) continue;
-
-      /* transform copy (this will also translate it to the correct
-       * position */
-      FT_Glyph_Transform( image, NULL, &start );
-
-      /* check bounding box, if the transformed glyph image
-       * is not in our target surface, we can avoid rendering it */
-      FT_Glyph_Get_CBox( image, ft_glyph_bbox_pixels, &bbox );
-/*
-      at some point check that the glyph needs to be rendered
-      using the painter.
-      if ( bbox.xMax <= 0 || bbox.xMin >= my_target_width  ||
-           bbox.yMax <= 0 || bbox.yMin >= my_target_height )
+      const struct CachedGlyph *glyph = fontGetGlyph (self, fs->glyphs[n].index);
+      if (glyph == NULL || glyph->bitmap == NULL)
         continue;
-*/
-
-      /* convert glyph image to bitmap (destroy the glyph copy !!) */
-      error = FT_Glyph_To_Bitmap( &image,
-                                  ft_render_mode_normal,
-                                  0,      /* no additional translation */
-                                  1 );    /* destroy copy in "image" */
-      if (!error)
-        {
-          FT_BitmapGlyph bitmap = (FT_BitmapGlyph)image;
 
-          painterDrawAlphamap (painter, bitmap->bitmap.buffer,
-                               bitmap->left, -bitmap->top,
-                               bitmap->bitmap.width,
-                               bitmap->bitmap.rows,
-                               bitmap->bitmap.pitch);
+      /* clip the glyph to the map */
+      int gx = x + fs->glyphs[n].x + glyph->left;
+      int gy = y - glyph->top;
+      int x1 = MAX (gx, 0), y1 = MAX (gy, 0);
+      int x2 = MIN (gx + glyph->width, w), y2 = MIN (gy + glyph->rows, h);
 
-          FT_Done_Glyph (image);
+      for (int j = y1; j < y2; ++j)
+        {
+          const uint8_t *src = glyph->bitmap + (j - gy) * glyph->pitch - gx;
+          uint8_t *dst = alpha + j * stride;
+          for (int i = x1; i < x2; ++i)
+            dst[i] = MAX (dst[i], src[i]);
         }
     }
 }
@@ -81,6 +81,14 @@ void         fontRenderWCString (struct Font *, struct Painter *,
 void         fontRenderString (struct Font *, struct Painter *,
                                const char *, int x, int y); 
 
+/* Draw the coverage of a string into an 8-bit alpha map of w by h
+ * pixels, whose rows are stride bytes apart, with the origin at x,y.
+ * Glyphs are clipped to the map and combined with what is there.
+ */
+void         fontRenderWCStringAlphamap (struct Font *, const wchar_t *,
+                                         uint8_t *alpha, int w, int h,
+                                         int stride, int x, int y);
+
 
 
 #endif
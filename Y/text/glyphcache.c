@@ -0,0 +1,243 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include <Y/text/glyphcache.h>
+#include <Y/util/index.h>
+#include <Y/util/yutil.h>
+
+#include <string.h>
+
+#define GLYPHCACHE_KERNING_SLOTS 1024
+
+struct KerningPair
+{
+  const void *face;
+  int size;
+  uint32_t left, right;
+  long delta;
+};
+
+static struct Index *glyphIndex = NULL;
+static struct CachedGlyph *glyphsHead = NULL;
+static struct CachedGlyph *glyphsTail = NULL;
+static size_t glyphsUsage = 0;
+static size_t glyphsBudget = GLYPHCACHE_DEFAULT_BUDGET;
+static struct KerningPair kerning[GLYPHCACHE_KERNING_SLOTS];
+
+static int
+glyphcacheKeyCompare (const struct GlyphCacheKey *key1,
+                      const struct GlyphCacheKey *key2)
+{
+  if (key1 -> face != key2 -> face)
+    return (uintptr_t)key1 -> face < (uintptr_t)key2 -> face ? -1 : 1;
+  if (key1 -> size != key2 -> size)
+    return key1 -> size < key2 -> size ? -1 : 1;
+  if (key1 -> index != key2 -> index)
+    return key1 -> index < key2 -> index ? -1 : 1;
+  return 0;
+}
+
+static int
+glyphcacheKeyFunction (const void *key_v, const void *obj_v)
+{
+  const struct CachedGlyph *obj = obj_v;
+  return glyphcacheKeyCompare (key_v, &(obj -> key));
+}
+
+static int
+glyphcacheComparisonFunction (const void *obj1_v, const void *obj2_v)
+{
+  const struct CachedGlyph *obj1 = obj1_v;
+  const struct CachedGlyph *obj2 = obj2_v;
+  return glyphcacheKeyCompare (&(obj1 -> key), &(obj2 -> key));
+}
+
+static size_t
+glyphcacheCost (const struct CachedGlyph *glyph)
+{
+  return glyph -> rows * glyph -> pitch;
+}
+
+static void
+glyphcacheUnlink (struct CachedGlyph *glyph)
+{
+  if (glyph -> prev)
+    glyph -> prev -> next = glyph -> next;
+  else
+    glyphsHead = glyph -> next;
+  if (glyph -> next)
+    glyph -> next -> prev = glyph -> prev;
+  else
+    glyphsTail = glyph -> prev;
+}
+
+static void
+glyphcacheLinkHead (struct CachedGlyph *glyph)
+{
+  glyph -> prev = NULL;
+  glyph -> next = glyphsHead;
+  if (glyphsHead)
+    glyphsHead -> prev = glyph;
+  else
+    glyphsTail = glyph;
+  glyphsHead = glyph;
+}
+
+static void
+glyphcacheRemove (struct CachedGlyph *glyph)
+{
+  glyphcacheUnlink (glyph);
+  indexRemove (glyphIndex, &(glyph -> key));
+  glyphsUsage -= glyphcacheCost (glyph);
+  yfree (glyph -> bitmap);
+  yfree (glyph);
+}
+
+const struct CachedGlyph *
+glyphcacheFind (const struct GlyphCacheKey *key)
+{
+  if (glyphIndex == NULL)
+    return NULL;
+
+  struct CachedGlyph *glyph = indexFind (glyphIndex, key);
+  if (glyph != NULL && glyph != glyphsHead)
+    {
+      glyphcacheUnlink (glyph);
+      glyphcacheLinkHead (glyph);
+    }
+  return glyph;
+}
+
+const struct CachedGlyph *
+glyphcacheAdd (const struct CachedGlyph *metrics, const uint8_t *bitmap)
+{
+  int pitch = metrics -> pitch;
+  int rows = metrics -> rows;
+
+  if (glyphIndex == NULL)
+    glyphIndex = indexCreate (glyphcacheKeyFunction,
+                              glyphcacheComparisonFunction);
+
+  struct CachedGlyph *old = indexFind (glyphIndex, &(metrics -> key));
+  if (old != NULL)
+    glyphcacheRemove (old);
+
+  struct CachedGlyph *glyph = ymalloc (sizeof (struct CachedGlyph));
+  *glyph = *metrics;
+  /* bitmaps are stored top down, whichever way FreeType had them */
+  glyph -> pitch = pitch < 0 ? -pitch : pitch;
+  glyph -> bitmap = NULL;
+  if (glyphcacheCost (glyph) > 0)
+    {
+      glyph -> bitmap = ymalloc (glyphcacheCost (glyph));
+      for (int j = 0; j < rows; ++j)
+        memcpy (glyph -> bitmap + j * glyph -> pitch,
+                pitch < 0 ? bitmap - (rows - 1 - j) * pitch
+                          : bitmap + j * pitch,
+                glyph -> pitch);
+    }
+
+  /* make room, but always keep the new glyph so the caller can use it */
+  while (glyphsTail != NULL
+         && glyphsUsage + glyphcacheCost (glyph) > glyphsBudget)
+    glyphcacheRemove (glyphsTail);
+
+  glyphsUsage += glyphcacheCost (glyph);
+  indexAdd (glyphIndex, glyph);
+  glyphcacheLinkHead (glyph);
+  return glyph;
+}
+
+static struct KerningPair *
+glyphcacheKerningSlot (const void *face, int size,
+                       uint32_t left, uint32_t right)
+{
+  uint32_t hash = (uint32_t)(uintptr_t)face;
+  hash = (hash ^ (uint32_t)size) * 2654435761u;
+  hash = (hash ^ left) * 2654435761u;
+  hash = (hash ^ right) * 2654435761u;
+  return kerning + (hash >> 16) % GLYPHCACHE_KERNING_SLOTS;
+}
+
+bool
+glyphcacheFindKerning (const void *face, int size,
+                       uint32_t left, uint32_t right, long *delta_p)
+{
+  const struct KerningPair *pair = glyphcacheKerningSlot (face, size,
+                                                           left, right);
+  if (pair -> face != face || pair -> size != size
+      || pair -> left != left || pair -> right != right)
+    return false;
+  *delta_p = pair -> delta;
+  return true;
+}
+
+void
+glyphcacheAddKerning (const void *face, int size,
+                      uint32_t left, uint32_t right, long delta)
+{
+  struct KerningPair *pair = glyphcacheKerningSlot (face, size, left, right);
+  pair -> face = face;
+  pair -> size = size;
+  pair -> left = left;
+  pair -> right = right;
+  pair -> delta = delta;
+}
+
+void
+glyphcacheSetBudget (size_t budget)
+{
+  glyphsBudget = budget;
+  while (glyphsTail != NULL && glyphsUsage > glyphsBudget)
+    glyphcacheRemove (glyphsTail);
+}
+
+size_t
+glyphcacheGetUsage (void)
+{
+  return glyphsUsage;
+}
+
+void
+glyphcacheFlush (const void *face)
+{
+  struct CachedGlyph *glyph = glyphsHead;
+  while (glyph != NULL)
+    {
+      struct CachedGlyph *next = glyph -> next;
+      if (face == NULL || glyph -> key.face == face)
+        glyphcacheRemove (glyph);
+      glyph = next;
+    }
+
+  for (int i = 0; i < GLYPHCACHE_KERNING_SLOTS; ++i)
+    if (face == NULL || kerning[i].face == face)
+      kerning[i].face = NULL;
+}
+
+void
+glyphcacheFinalise (void)
+{
+  glyphcacheFlush (NULL);
+  if (glyphIndex)
+    indexDestroy (glyphIndex, NULL);
+  glyphIndex = NULL;
+}
+
+/* arch-tag: 6c1e9a52-d8f3-4b07-a46e-2b5f80d3c917
+ */
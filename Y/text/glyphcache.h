@@ -0,0 +1,91 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#ifndef Y_TEXT_GLYPHCACHE_H
+#define Y_TEXT_GLYPHCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The glyph cache keeps rasterised glyphs, so that drawing text that
+ * has been drawn before needs no work from FreeType.  It is shared by
+ * every font: glyphs are keyed by face, size and glyph index.  When
+ * the bitmaps take more than the budget, the glyphs used least recently
+ * are thrown away.
+ *
+ * Pairs of glyphs' kerning is kept too, in a small table where a new
+ * pair replaces whatever pair was in its slot.
+ *
+ * Glyphs returned remain valid until the next glyphcacheAdd.
+ */
+
+#define GLYPHCACHE_DEFAULT_BUDGET (1024 * 1024)
+
+struct GlyphCacheKey
+{
+  const void *face;
+  int size;
+  uint32_t index;
+};
+
+struct CachedGlyph
+{
+  struct GlyphCacheKey key;
+  /* position of the bitmap's top left relative to the pen */
+  int left, top;
+  int width, rows, pitch;
+  /* horizontal extent of the glyph's outline relative to the pen, in
+   * whole pixels; this may be wider than the bitmap */
+  int xMin, xMax;
+  /* in 26.6 fixed point */
+  long advance;
+  uint8_t *bitmap;
+
+  /* least recently used list, most recent first */
+  struct CachedGlyph *prev, *next;
+};
+
+/* Return a cached glyph and mark it used, or NULL. */
+const struct CachedGlyph *glyphcacheFind (const struct GlyphCacheKey *);
+/* Copy a rasterised glyph into the cache, making room if necessary.
+ * The key and metrics are taken from GLYPH; its bitmap and list links
+ * are ignored.  A negative pitch means the rows of BITMAP are stored
+ * bottom up, as in FreeType. */
+const struct CachedGlyph *glyphcacheAdd (const struct CachedGlyph *glyph,
+                                         const uint8_t *bitmap);
+
+/* Kerning between two glyphs of the same face and size, in 26.6 */
+bool   glyphcacheFindKerning (const void *face, int size,
+                              uint32_t left, uint32_t right, long *delta_p);
+void   glyphcacheAddKerning (const void *face, int size,
+                             uint32_t left, uint32_t right, long delta);
+
+/* Bytes of bitmaps that may be kept; 0 keeps only the latest glyph */
+void   glyphcacheSetBudget (size_t budget);
+/* Bytes of bitmaps that are kept now */
+size_t glyphcacheGetUsage (void);
+
+/* Forget everything about FACE, or everything if it is NULL */
+void   glyphcacheFlush (const void *face);
+void   glyphcacheFinalise (void);
+
+#endif
+
+/* arch-tag: 3d8b6f0e-91c4-4a7d-b2e5-07f9a4c1d68e
+ */
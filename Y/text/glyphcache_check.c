@@ -0,0 +1,165 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/text/glyphcache.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+const char *checkName;
+const char *checkModule;
+
+/* two faces; only their addresses matter */
+static int faceA, faceB;
+
+static uint8_t bitmap[16 * 16];
+
+static const struct CachedGlyph *
+glyphcache_check_add (const void *face, int size, uint32_t index)
+{
+  struct CachedGlyph glyph;
+  glyph.key.face = face;
+  glyph.key.size = size;
+  glyph.key.index = index;
+  glyph.left = 1;
+  glyph.top = 12;
+  glyph.width = 10;
+  glyph.rows = 16;
+  glyph.pitch = 16;
+  glyph.xMin = 0;
+  glyph.xMax = 12;
+  glyph.advance = index * 64;
+  return glyphcacheAdd (&glyph, bitmap);
+}
+
+static const struct CachedGlyph *
+glyphcache_check_find (const void *face, int size, uint32_t index)
+{
+  struct GlyphCacheKey key = { face, size, index };
+  return glyphcacheFind (&key);
+}
+
+static int
+glyphcache_check_lru (void)
+{
+  const struct CachedGlyph *glyph;
+
+  checkModule = "lru";
+
+  for (int i = 0; i < (int)sizeof (bitmap); ++i)
+    bitmap[i] = i;
+
+  /* room for exactly four 16x16 glyphs */
+  glyphcacheSetBudget (4 * 256);
+
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 1) == NULL );
+
+  /* the bitmap and metrics are copied */
+  glyph = glyphcache_check_add (&faceA, 10, 1);
+  CHECK_THAT ( glyph != NULL );
+  CHECK_THAT ( glyph -> bitmap != bitmap );
+  CHECK_THAT ( memcmp (glyph -> bitmap, bitmap, sizeof (bitmap)) == 0 );
+  CHECK_THAT ( glyph -> left == 1 && glyph -> top == 12 );
+  CHECK_THAT ( glyph -> advance == 64 );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 1) == glyph );
+  CHECK_THAT ( glyphcacheGetUsage () == 256 );
+
+  /* face, size and index all distinguish glyphs */
+  glyphcache_check_add (&faceB, 10, 1);
+  glyphcache_check_add (&faceA, 12, 1);
+  glyphcache_check_add (&faceA, 10, 2);
+  CHECK_THAT ( glyphcacheGetUsage () == 4 * 256 );
+  CHECK_THAT ( glyphcache_check_find (&faceB, 10, 1) -> key.face == &faceB );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 12, 1) -> key.size == 12 );
+
+  /* using a glyph protects it; the least recently used goes first */
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 1) != NULL );
+  glyphcache_check_add (&faceA, 10, 3);
+  CHECK_THAT ( glyphcacheGetUsage () == 4 * 256 );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 2) == NULL );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 1) != NULL );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 3) != NULL );
+
+  /* a smaller budget throws glyphs away at once */
+  glyphcacheSetBudget (2 * 256);
+  CHECK_THAT ( glyphcacheGetUsage () == 2 * 256 );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 3) != NULL );
+
+  /* even with no budget the glyph just added is kept */
+  glyphcacheSetBudget (0);
+  CHECK_THAT ( glyphcacheGetUsage () == 0 );
+  glyph = glyphcache_check_add (&faceB, 10, 7);
+  CHECK_THAT ( glyph != NULL && glyph -> bitmap[255] == 255 );
+  glyphcache_check_add (&faceB, 10, 8);
+  CHECK_THAT ( glyphcache_check_find (&faceB, 10, 7) == NULL );
+
+  /* flushing a face leaves the others */
+  glyphcacheSetBudget (GLYPHCACHE_DEFAULT_BUDGET);
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      glyphcache_check_add (&faceA, 10, i);
+      glyphcache_check_add (&faceB, 10, i);
+    }
+  glyphcacheFlush (&faceA);
+  CHECK_THAT ( glyphcacheGetUsage () == 100 * 256 );
+  CHECK_THAT ( glyphcache_check_find (&faceA, 10, 50) == NULL );
+  CHECK_THAT ( glyphcache_check_find (&faceB, 10, 50) != NULL );
+
+  glyphcacheFinalise ();
+  CHECK_THAT ( glyphcacheGetUsage () == 0 );
+  CHECK_THAT ( glyphcache_check_find (&faceB, 10, 50) == NULL );
+
+  return 0;
+}
+
+static int
+glyphcache_check_kerning (void)
+{
+  long delta = 0;
+
+  checkModule = "kerning";
+
+  CHECK_THAT ( !glyphcacheFindKerning (&faceA, 10, 1, 2, &delta) );
+  glyphcacheAddKerning (&faceA, 10, 1, 2, -128);
+  CHECK_THAT ( glyphcacheFindKerning (&faceA, 10, 1, 2, &delta) );
+  CHECK_THAT ( delta == -128 );
+  CHECK_THAT ( !glyphcacheFindKerning (&faceA, 10, 2, 1, &delta) );
+  CHECK_THAT ( !glyphcacheFindKerning (&faceA, 11, 1, 2, &delta) );
+  CHECK_THAT ( !glyphcacheFindKerning (&faceB, 10, 1, 2, &delta) );
+
+  glyphcacheFlush (&faceA);
+  CHECK_THAT ( !glyphcacheFindKerning (&faceA, 10, 1, 2, &delta) );
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int failed = 0;
+  checkName = "glyphcache";
+  failed = glyphcache_check_lru () ? 1 : failed;
+  failed = glyphcache_check_kerning () ? 1 : failed;
+  return failed;
+}
+
+/* arch-tag: a5f20c7d-6e91-4b38-8d04-c17b3e9f5a62
+ */
@@ -0,0 +1,129 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include <Y/util/atom.h>
+#include <Y/util/index.h>
+#include <Y/util/yutil.h>
+
+#include <string.h>
+
+struct Atom
+{
+  char *name;
+  uint32_t atom;
+};
+
+static struct Index *atomIndex = NULL;
+/* atoms by number; atomList[0] is unused */
+static struct Atom **atomList = NULL;
+static uint32_t atomCount = 1;
+static uint32_t atomSpace = 0;
+
+static int
+atomKeyFunction (const void *key_v, const void *obj_v)
+{
+  const char *key = key_v;
+  const struct Atom *obj = obj_v;
+  return strcmp (key, obj -> name);
+}
+
+static int
+atomComparisonFunction (const void *obj1_v, const void *obj2_v)
+{
+  const struct Atom *obj1 = obj1_v;
+  const struct Atom *obj2 = obj2_v;
+  return strcmp (obj1 -> name, obj2 -> name);
+}
+
+static void
+atomDestructorFunction (void *obj_v)
+{
+  struct Atom *obj = obj_v;
+  yfree (obj -> name);
+  yfree (obj);
+}
+
+uint32_t
+atomIntern (const char *name)
+{
+  uint32_t atom = atomFind (name);
+  if (atom != 0)
+    return atom;
+
+  /* atoms are used while classes are registered, before anything has
+   * been initialised */
+  if (atomIndex == NULL)
+    atomIndex = indexCreate (atomKeyFunction, atomComparisonFunction);
+
+  if (atomCount >= atomSpace)
+    {
+      uint32_t space = atomSpace ? atomSpace * 2 : 256;
+      struct Atom **list = ymalloc (sizeof (list[0]) * space);
+      list[0] = NULL;
+      if (atomList)
+        memcpy (list + 1, atomList + 1, sizeof (list[0]) * (atomCount - 1));
+      yfree (atomList);
+      atomList = list;
+      atomSpace = space;
+    }
+
+  struct Atom *a = ymalloc (sizeof (*a));
+  a -> name = ystrdup (name);
+  a -> atom = atomCount++;
+  atomList[a -> atom] = a;
+  indexAdd (atomIndex, a);
+  return a -> atom;
+}
+
+uint32_t
+atomFind (const char *name)
+{
+  if (atomIndex == NULL || name == NULL)
+    return 0;
+  const struct Atom *a = indexFind (atomIndex, name);
+  return a ? a -> atom : 0;
+}
+
+const char *
+atomName (uint32_t atom)
+{
+  if (atom == 0 || atom >= atomCount)
+    return NULL;
+  return atomList[atom] -> name;
+}
+
+uint32_t
+atomLimit (void)
+{
+  return atomCount;
+}
+
+void
+atomFinalise (void)
+{
+  if (atomIndex)
+    indexDestroy (atomIndex, atomDestructorFunction);
+  atomIndex = NULL;
+  yfree (atomList);
+  atomList = NULL;
+  atomCount = 1;
+  atomSpace = 0;
+}
+
+/* arch-tag: 4b7d1c90-3e58-4f2a-9c6b-d81e5a27f0b4
+ */
@@ -0,0 +1,45 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#ifndef Y_UTIL_ATOM_H
+#define Y_UTIL_ATOM_H
+
+#include <stdint.h>
+
+/* Atoms are small integers standing for strings, such as method,
+ * property and signal names, so that they can be compared and looked
+ * up without strcmp.  Each distinct string is given the next atom in
+ * turn, starting from 1, and keeps it for the life of the server.  0 is
+ * never a valid atom.
+ */
+
+/* Return the atom for NAME, creating it if necessary. */
+uint32_t    atomIntern (const char *name);
+/* Return the atom for NAME, or 0 if it has never been interned. */
+uint32_t    atomFind (const char *name);
+/* Return the name of an atom, or NULL if it isn't valid. */
+const char *atomName (uint32_t atom);
+/* Return one more than the largest atom so far. */
+uint32_t    atomLimit (void);
+
+void        atomFinalise (void);
+
+#endif
+
+/* arch-tag: 9e2f4b61-07d8-4c3a-a5e9-6b18d0c47f23
+ */
@@ -0,0 +1,82 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/util/atom.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+const char *checkName;
+const char *checkModule;
+
+#define ATOMS 1000
+
+static int
+atom_check_intern (void)
+{
+  static uint32_t atoms[ATOMS];
+  char name[32];
+
+  checkModule = "intern";
+
+  CHECK_THAT ( atomFind ("nothing") == 0 );
+  CHECK_THAT ( atomName (0) == NULL );
+
+  /* every name gets its own atom, enough to grow the table */
+  for (int i = 0; i < ATOMS; ++i)
+    {
+      sprintf (name, "name%d", i);
+      atoms[i] = atomIntern (name);
+      CHECK_THAT ( atoms[i] != 0 );
+      CHECK_THAT ( atoms[i] < atomLimit () );
+    }
+
+  /* and keeps it */
+  for (int i = 0; i < ATOMS; ++i)
+    {
+      sprintf (name, "name%d", i);
+      CHECK_THAT ( atomFind (name) == atoms[i] );
+      CHECK_THAT ( atomIntern (name) == atoms[i] );
+      CHECK_THAT ( strcmp (atomName (atoms[i]), name) == 0 );
+      for (int j = 0; j < i; ++j)
+        CHECK_THAT ( atoms[j] != atoms[i] );
+    }
+
+  CHECK_THAT ( atomFind ("nothing") == 0 );
+  CHECK_THAT ( atomName (atomLimit ()) == NULL );
+
+  atomFinalise ();
+  CHECK_THAT ( atomFind ("name0") == 0 );
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int failed = 0;
+  checkName = "Atom";
+  failed = atom_check_intern () ? 1 : failed;
+  return failed;
+}
+
+/* arch-tag: d6a91f3e-28c4-4b7d-8e05-1f9c3b6a72e8
+ */
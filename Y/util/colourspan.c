@@ -0,0 +1,579 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include <Y/util/colourspan.h>
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define COLOURSPAN_X86
+# include <immintrin.h>
+#endif
+
+/* How the vector code stays bit-exact with colourBlendSourceOver:
+ *
+ * Every intermediate value in the source-over blend is an integer below
+ * 2^24 (the largest is 0xFF * 0xFE01), so it is held exactly in a float.
+ * The only inexact step is the division, and since the divisor is at
+ * most 0xFE01 and the quotient at most 0xFF, a true quotient that is
+ * not an integer is always further than half an ulp from the next
+ * integer.  Truncating the correctly rounded float quotient therefore
+ * gives the same answer as the integer division.
+ */
+
+struct ColourSpanFunctions
+{
+  void (*sourceOver)     (uint32_t *, const uint32_t *, int);
+  void (*fillSourceOver) (uint32_t *, uint32_t, int);
+  void (*maskSourceOver) (uint32_t *, uint32_t, const uint8_t *, int);
+};
+
+/* Scalar
+ * ====== */
+
+static void
+colourspanSourceOverScalar (uint32_t *d, const uint32_t *s, int n)
+{
+  int i;
+  for (i = 0; i < n; ++i)
+    {
+      uint32_t alpha = s[i] & 0xFF000000;
+      if (alpha == 0xFF000000)
+        d[i] = s[i];
+      else if (alpha != 0)
+        colourBlendSourceOver (d + i, d[i], s[i], 0xFF);
+    }
+}
+
+static void
+colourspanFillSourceOverScalar (uint32_t *d, uint32_t colour, int n)
+{
+  uint32_t alpha = colour & 0xFF000000;
+  int i;
+  if (alpha == 0)
+    return;
+  if (alpha == 0xFF000000)
+    {
+      for (i = 0; i < n; ++i)
+        d[i] = colour;
+    }
+  else
+    {
+      for (i = 0; i < n; ++i)
+        colourBlendSourceOver (d + i, d[i], colour, 0xFF);
+    }
+}
+
+static void
+colourspanMaskSourceOverScalar (uint32_t *d, uint32_t colour,
+                                const uint8_t *alpha, int n)
+{
+  bool opaque = (colour & 0xFF000000) == 0xFF000000;
+  int i;
+  for (i = 0; i < n; ++i)
+    {
+      if (alpha[i] == 0)
+        continue;
+      if (alpha[i] == 0xFF && opaque)
+        d[i] = colour;
+      else
+        colourBlendSourceOver (d + i, d[i], colour, alpha[i]);
+    }
+}
+
+static const struct ColourSpanFunctions colourspanScalar =
+{
+  .sourceOver     = colourspanSourceOverScalar,
+  .fillSourceOver = colourspanFillSourceOverScalar,
+  .maskSourceOver = colourspanMaskSourceOverScalar
+};
+
+#ifdef COLOURSPAN_X86
+
+/* SSE2
+ * ==== */
+
+#define SSE2 __attribute__ ((target ("sse2")))
+
+static inline SSE2 __m128i
+colourspanChannelSSE2 (__m128i dst, __m128i src, int shift,
+                       __m128 f1, __m128 f2, __m128 divisor)
+{
+  const __m128i mask = _mm_set1_epi32 (0xFF);
+  __m128 c1 = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (dst, shift),
+                                              mask));
+  __m128 c2 = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (src, shift),
+                                              mask));
+  __m128 sum = _mm_add_ps (_mm_mul_ps (c1, f1), _mm_mul_ps (c2, f2));
+  return _mm_slli_epi32 (_mm_cvttps_epi32 (_mm_div_ps (sum, divisor)), shift);
+}
+
+static inline SSE2 __m128i
+colourspanBlendSSE2 (__m128i dst, __m128i src)
+{
+  const __m128 c255 = _mm_set1_ps (255.0f);
+  __m128 a1 = _mm_cvtepi32_ps (_mm_srli_epi32 (dst, 24));
+  __m128 a2 = _mm_cvtepi32_ps (_mm_srli_epi32 (src, 24));
+  __m128 f1 = _mm_mul_ps (a1, _mm_sub_ps (c255, a2));
+  __m128 f2 = _mm_mul_ps (a2, c255);
+  __m128 newalpha = _mm_add_ps (f1, f2);
+  __m128i empty = _mm_castps_si128 (_mm_cmpeq_ps (newalpha,
+                                                  _mm_setzero_ps ()));
+  /* avoid dividing by zero; those pixels are left alone below */
+  __m128 divisor = _mm_or_ps (newalpha,
+                              _mm_and_ps (_mm_castsi128_ps (empty),
+                                          _mm_set1_ps (1.0f)));
+  __m128i result;
+
+  result = _mm_slli_epi32 (_mm_cvttps_epi32 (_mm_div_ps (newalpha, c255)), 24);
+  result = _mm_or_si128 (result,
+             colourspanChannelSSE2 (dst, src, 16, f1, f2, divisor));
+  result = _mm_or_si128 (result,
+             colourspanChannelSSE2 (dst, src, 8, f1, f2, divisor));
+  result = _mm_or_si128 (result,
+             colourspanChannelSSE2 (dst, src, 0, f1, f2, divisor));
+  return _mm_or_si128 (_mm_and_si128 (empty, dst),
+                       _mm_andnot_si128 (empty, result));
+}
+
+static SSE2 void
+colourspanSourceOverSSE2 (uint32_t *d, const uint32_t *s, int n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i alphaMask = _mm_set1_epi32 (0xFF000000);
+  for (; n >= 4; n -= 4, d += 4, s += 4)
+    {
+      __m128i src = _mm_loadu_si128 ((const __m128i *)s);
+      __m128i alpha = _mm_and_si128 (src, alphaMask);
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (alpha, alphaMask)) == 0xFFFF)
+        _mm_storeu_si128 ((__m128i *)d, src);
+      else if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (alpha, zero)) != 0xFFFF)
+        _mm_storeu_si128 ((__m128i *)d,
+                          colourspanBlendSSE2 (_mm_loadu_si128 ((__m128i *)d),
+                                               src));
+    }
+  colourspanSourceOverScalar (d, s, n);
+}
+
+static SSE2 void
+colourspanFillSourceOverSSE2 (uint32_t *d, uint32_t colour, int n)
+{
+  __m128i src = _mm_set1_epi32 ((int)colour);
+  uint32_t alpha = colour & 0xFF000000;
+  if (alpha == 0)
+    return;
+  if (alpha == 0xFF000000)
+    {
+      for (; n >= 4; n -= 4, d += 4)
+        _mm_storeu_si128 ((__m128i *)d, src);
+    }
+  else
+    {
+      for (; n >= 4; n -= 4, d += 4)
+        _mm_storeu_si128 ((__m128i *)d,
+                          colourspanBlendSSE2 (_mm_loadu_si128 ((__m128i *)d),
+                                               src));
+    }
+  colourspanFillSourceOverScalar (d, colour, n);
+}
+
+static SSE2 void
+colourspanMaskSourceOverSSE2 (uint32_t *d, uint32_t colour,
+                              const uint8_t *alpha, int n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i ff = _mm_set1_epi32 (0xFF);
+  const __m128i rgb = _mm_set1_epi32 ((int)(colour & 0x00FFFFFF));
+  const __m128i colourAlpha = _mm_set1_epi32 ((int)(colour >> 24));
+  bool opaque = (colour & 0xFF000000) == 0xFF000000;
+  for (; n >= 4; n -= 4, d += 4, alpha += 4)
+    {
+      int32_t packed;
+      __m128i m;
+      memcpy (&packed, alpha, sizeof (packed));
+      if (packed == 0)
+        continue;
+      m = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (_mm_cvtsi32_si128 (packed),
+                                                 zero), zero);
+      if (opaque && _mm_movemask_epi8 (_mm_cmpeq_epi32 (m, ff)) == 0xFFFF)
+        _mm_storeu_si128 ((__m128i *)d, _mm_set1_epi32 ((int)colour));
+      else
+        {
+          /* (colour alpha * modulation) / 0xFF, as colourBlendSourceOver */
+          __m128 product = _mm_cvtepi32_ps (_mm_mullo_epi16 (m, colourAlpha));
+          __m128i a = _mm_cvttps_epi32 (_mm_div_ps (product,
+                                                    _mm_set1_ps (255.0f)));
+          __m128i src = _mm_or_si128 (rgb, _mm_slli_epi32 (a, 24));
+          _mm_storeu_si128 ((__m128i *)d,
+                            colourspanBlendSSE2 (_mm_loadu_si128 ((__m128i *)d),
+                                                 src));
+        }
+    }
+  colourspanMaskSourceOverScalar (d, colour, alpha, n);
+}
+
+static const struct ColourSpanFunctions colourspanSSE2 =
+{
+  .sourceOver     = colourspanSourceOverSSE2,
+  .fillSourceOver = colourspanFillSourceOverSSE2,
+  .maskSourceOver = colourspanMaskSourceOverSSE2
+};
+
+/* AVX2
+ * ==== */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+
+static inline AVX2 __m256i
+colourspanChannelAVX2 (__m256i dst, __m256i src, int shift,
+                       __m256 f1, __m256 f2, __m256 divisor)
+{
+  const __m256i mask = _mm256_set1_epi32 (0xFF);
+  __m256 c1 = _mm256_cvtepi32_ps (_mm256_and_si256 (
+                                    _mm256_srli_epi32 (dst, shift), mask));
+  __m256 c2 = _mm256_cvtepi32_ps (_mm256_and_si256 (
+                                    _mm256_srli_epi32 (src, shift), mask));
+  __m256 sum = _mm256_add_ps (_mm256_mul_ps (c1, f1), _mm256_mul_ps (c2, f2));
+  return _mm256_slli_epi32 (_mm256_cvttps_epi32 (_mm256_div_ps (sum, divisor)),
+                            shift);
+}
+
+static inline AVX2 __m256i
+colourspanBlendAVX2 (__m256i dst, __m256i src)
+{
+  const __m256 c255 = _mm256_set1_ps (255.0f);
+  __m256 a1 = _mm256_cvtepi32_ps (_mm256_srli_epi32 (dst, 24));
+  __m256 a2 = _mm256_cvtepi32_ps (_mm256_srli_epi32 (src, 24));
+  __m256 f1 = _mm256_mul_ps (a1, _mm256_sub_ps (c255, a2));
+  __m256 f2 = _mm256_mul_ps (a2, c255);
+  __m256 newalpha = _mm256_add_ps (f1, f2);
+  __m256i empty = _mm256_castps_si256 (_mm256_cmp_ps (newalpha,
+                                                      _mm256_setzero_ps (),
+                                                      _CMP_EQ_OQ));
+  __m256 divisor = _mm256_or_ps (newalpha,
+                                 _mm256_and_ps (_mm256_castsi256_ps (empty),
+                                                _mm256_set1_ps (1.0f)));
+  __m256i result;
+
+  result = _mm256_slli_epi32 (_mm256_cvttps_epi32 (_mm256_div_ps (newalpha,
+                                                                  c255)), 24);
+  result = _mm256_or_si256 (result,
+             colourspanChannelAVX2 (dst, src, 16, f1, f2, divisor));
+  result = _mm256_or_si256 (result,
+             colourspanChannelAVX2 (dst, src, 8, f1, f2, divisor));
+  result = _mm256_or_si256 (result,
+             colourspanChannelAVX2 (dst, src, 0, f1, f2, divisor));
+  return _mm256_blendv_epi8 (result, dst, empty);
+}
+
+static AVX2 void
+colourspanSourceOverAVX2 (uint32_t *d, const uint32_t *s, int n)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i alphaMask = _mm256_set1_epi32 (0xFF000000);
+  for (; n >= 8; n -= 8, d += 8, s += 8)
+    {
+      __m256i src = _mm256_loadu_si256 ((const __m256i *)s);
+      __m256i alpha = _mm256_and_si256 (src, alphaMask);
+      if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (alpha, alphaMask)) == -1)
+        _mm256_storeu_si256 ((__m256i *)d, src);
+      else if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (alpha, zero)) != -1)
+        _mm256_storeu_si256 ((__m256i *)d,
+                             colourspanBlendAVX2 (
+                               _mm256_loadu_si256 ((__m256i *)d), src));
+    }
+  colourspanSourceOverSSE2 (d, s, n);
+}
+
+static AVX2 void
+colourspanFillSourceOverAVX2 (uint32_t *d, uint32_t colour, int n)
+{
+  __m256i src = _mm256_set1_epi32 ((int)colour);
+  uint32_t alpha = colour & 0xFF000000;
+  if (alpha == 0)
+    return;
+  if (alpha == 0xFF000000)
+    {
+      for (; n >= 8; n -= 8, d += 8)
+        _mm256_storeu_si256 ((__m256i *)d, src);
+    }
+  else
+    {
+      for (; n >= 8; n -= 8, d += 8)
+        _mm256_storeu_si256 ((__m256i *)d,
+                             colourspanBlendAVX2 (
+                               _mm256_loadu_si256 ((__m256i *)d), src));
+    }
+  colourspanFillSourceOverSSE2 (d, colour, n);
+}
+
+static AVX2 void
+colourspanMaskSourceOverAVX2 (uint32_t *d, uint32_t colour,
+                              const uint8_t *alpha, int n)
+{
+  const __m256i ff = _mm256_set1_epi32 (0xFF);
+  const __m256i rgb = _mm256_set1_epi32 ((int)(colour & 0x00FFFFFF));
+  const __m256i colourAlpha = _mm256_set1_epi32 ((int)(colour >> 24));
+  bool opaque = (colour & 0xFF000000) == 0xFF000000;
+  for (; n >= 8; n -= 8, d += 8, alpha += 8)
+    {
+      int64_t packed;
+      __m256i m;
+      memcpy (&packed, alpha, sizeof (packed));
+      if (packed == 0)
+        continue;
+      m = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *)alpha));
+      if (opaque && _mm256_movemask_epi8 (_mm256_cmpeq_epi32 (m, ff)) == -1)
+        _mm256_storeu_si256 ((__m256i *)d, _mm256_set1_epi32 ((int)colour));
+      else
+        {
+          __m256 product = _mm256_cvtepi32_ps (_mm256_mullo_epi32 (m,
+                                                               colourAlpha));
+          __m256i a = _mm256_cvttps_epi32 (_mm256_div_ps (product,
+                                             _mm256_set1_ps (255.0f)));
+          __m256i src = _mm256_or_si256 (rgb, _mm256_slli_epi32 (a, 24));
+          _mm256_storeu_si256 ((__m256i *)d,
+                               colourspanBlendAVX2 (
+                                 _mm256_loadu_si256 ((__m256i *)d), src));
+        }
+    }
+  colourspanMaskSourceOverSSE2 (d, colour, alpha, n);
+}
+
+static const struct ColourSpanFunctions colourspanAVX2 =
+{
+  .sourceOver     = colourspanSourceOverAVX2,
+  .fillSourceOver = colourspanFillSourceOverAVX2,
+  .maskSourceOver = colourspanMaskSourceOverAVX2
+};
+
+#endif /* COLOURSPAN_X86 */
+
+/* Dispatch
+ * ======== */
+
+/* The selection is made once at start-up, before any thread can paint, so
+ * the span functions need no locking to read it.  Until then, and in
+ * programs that never choose, the scalar code is used.
+ */
+static const struct ColourSpanFunctions *colourspanFunctions =
+  &colourspanScalar;
+static enum ColourSpanImplementation colourspanImplementation =
+  COLOURSPAN_IMPLEMENTATION_SCALAR;
+
+static const struct ColourSpanFunctions *
+colourspanLookup (enum ColourSpanImplementation implementation)
+{
+  switch (implementation)
+    {
+    case COLOURSPAN_IMPLEMENTATION_SCALAR:
+      return &colourspanScalar;
+#ifdef COLOURSPAN_X86
+    case COLOURSPAN_IMPLEMENTATION_SSE2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("sse2") ? &colourspanSSE2 : NULL;
+    case COLOURSPAN_IMPLEMENTATION_AVX2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx2") ? &colourspanAVX2 : NULL;
+#endif
+    default:
+      return NULL;
+    }
+}
+
+bool
+colourspanSetImplementation (enum ColourSpanImplementation implementation)
+{
+  const struct ColourSpanFunctions *functions;
+
+  if (implementation == COLOURSPAN_IMPLEMENTATION_AUTO)
+    {
+      implementation = COLOURSPAN_IMPLEMENTATION_AVX2;
+      while ((functions = colourspanLookup (implementation)) == NULL)
+        --implementation;
+    }
+  else if ((functions = colourspanLookup (implementation)) == NULL)
+    return false;
+
+  colourspanFunctions = functions;
+  colourspanImplementation = implementation;
+  return true;
+}
+
+enum ColourSpanImplementation
+colourspanGetImplementation (void)
+{
+  return colourspanImplementation;
+}
+
+void
+colourspanSourceOver (uint32_t *d, const uint32_t *s, int n)
+{
+  colourspanFunctions -> sourceOver (d, s, n);
+}
+
+void
+colourspanFillSourceOver (uint32_t *d, uint32_t colour, int n)
+{
+  colourspanFunctions -> fillSourceOver (d, colour, n);
+}
+
+void
+colourspanMaskSourceOver (uint32_t *d, uint32_t colour,
+                          const uint8_t *alpha, int n)
+{
+  colourspanFunctions -> maskSourceOver (d, colour, alpha, n);
+}
+
+/* Blend Mode Operators
+ * ==================== */
+
+/* colourBlend with the mode's table entries as constants, so that each
+ * instance below is compiled for exactly one mode.  The coefficients
+ * passed in must agree with colourMode1base etc. in colour.c.
+ */
+static inline void __attribute__ ((always_inline))
+colourspanBlendPixel (uint32_t *d, uint32_t c2, uint32_t modulation,
+                      const int base1, const int mult1,
+                      const int base2, const int mult2)
+{
+  register uint8_t *d_c  = (uint8_t *)d;
+  register uint8_t *c2_c = (uint8_t *)&c2;
+  uint32_t c1 = *d;
+  register uint8_t *c1_c = (uint8_t *)&c1;
+  register uint32_t alpha1 =  ((uint32_t)c1_c[INDEX_A]);
+  register uint32_t alpha2 = (((uint32_t)c2_c[INDEX_A]) * modulation) / 0xFF;
+  register uint32_t f1 = alpha1 * (base1 + mult1 * alpha2);
+  register uint32_t f2 = alpha2 * (base2 + mult2 * alpha1);
+  register uint32_t newalpha;
+  newalpha     = (f1 + f2) > 0xFE01 ? 0xFE01 : (f1 + f2);
+  d_c[INDEX_A] = newalpha / 0xFF;
+  if (newalpha == 0)
+    return;
+  d_c[INDEX_R] = (((uint32_t)c1_c[INDEX_R])*f1 + ((uint32_t)c2_c[INDEX_R])*f2) / newalpha;
+  d_c[INDEX_G] = (((uint32_t)c1_c[INDEX_G])*f1 + ((uint32_t)c2_c[INDEX_G])*f2) / newalpha;
+  d_c[INDEX_B] = (((uint32_t)c1_c[INDEX_B])*f1 + ((uint32_t)c2_c[INDEX_B])*f2) / newalpha;
+}
+
+#define COLOURSPAN_OPERATOR(name, blendMode, base1, mult1, base2, mult2)        \
+static void                                                                \
+colourspanFill##name (uint32_t *d, uint32_t colour, int n)                 \
+{                                                                          \
+  int i;                                                                   \
+  for (i = 0; i < n; ++i)                                                  \
+    colourspanBlendPixel (d + i, colour, 0xFF,                             \
+                          base1, mult1, base2, mult2);                     \
+}                                                                          \
+static void                                                                \
+colourspanBlend##name (uint32_t *d, const uint32_t *s, int n)              \
+{                                                                          \
+  int i;                                                                   \
+  for (i = 0; i < n; ++i)                                                  \
+    colourspanBlendPixel (d + i, s[i], 0xFF,                               \
+                          base1, mult1, base2, mult2);                     \
+}                                                                          \
+static void                                                                \
+colourspanMask##name (uint32_t *d, uint32_t colour,                        \
+                      const uint8_t *alpha, int n)                         \
+{                                                                          \
+  int i;                                                                   \
+  for (i = 0; i < n; ++i)                                                  \
+    colourspanBlendPixel (d + i, colour, alpha[i],                         \
+                          base1, mult1, base2, mult2);                     \
+}                                                                          \
+static const struct ColourSpanOperator colourspanOperator##name =          \
+{                                                                          \
+  .mode  = blendMode,                                                      \
+  .fill  = colourspanFill##name,                                           \
+  .blend = colourspanBlend##name,                                          \
+  .mask  = colourspanMask##name                                            \
+};
+
+COLOURSPAN_OPERATOR (Clear,      COLOUR_BLEND_CLEAR,          0,  0,    0,  0)
+COLOURSPAN_OPERATOR (Source,     COLOUR_BLEND_SOURCE,         0,  0, 0xFF,  0)
+COLOURSPAN_OPERATOR (SourceIn,   COLOUR_BLEND_SOURCE_IN,      0,  0,    0,  1)
+COLOURSPAN_OPERATOR (SourceOut,  COLOUR_BLEND_SOURCE_OUT,     0,  0, 0xFF, -1)
+COLOURSPAN_OPERATOR (SourceAtop, COLOUR_BLEND_SOURCE_ATOP, 0xFF, -1,    0,  1)
+COLOURSPAN_OPERATOR (DestOver,   COLOUR_BLEND_DEST_OVER,   0xFF,  0, 0xFF, -1)
+COLOURSPAN_OPERATOR (DestIn,     COLOUR_BLEND_DEST_IN,        0,  1,    0,  0)
+COLOURSPAN_OPERATOR (DestOut,    COLOUR_BLEND_DEST_OUT,    0xFF, -1,    0,  0)
+COLOURSPAN_OPERATOR (DestAtop,   COLOUR_BLEND_DEST_ATOP,      0,  1, 0xFF, -1)
+COLOURSPAN_OPERATOR (Xor,        COLOUR_BLEND_XOR,         0xFF, -1, 0xFF, -1)
+
+/* Dest leaves the destination exactly as it was. */
+
+static void
+colourspanFillDest (uint32_t *d, uint32_t colour, int n)
+{
+}
+
+static void
+colourspanBlendDest (uint32_t *d, const uint32_t *s, int n)
+{
+}
+
+static void
+colourspanMaskDest (uint32_t *d, uint32_t colour, const uint8_t *alpha, int n)
+{
+}
+
+static const struct ColourSpanOperator colourspanOperatorDest =
+{
+  .mode  = COLOUR_BLEND_DEST,
+  .fill  = colourspanFillDest,
+  .blend = colourspanBlendDest,
+  .mask  = colourspanMaskDest
+};
+
+/* Source over uses the vector kernels chosen above. */
+
+static const struct ColourSpanOperator colourspanOperatorSourceOver =
+{
+  .mode  = COLOUR_BLEND_SOURCE_OVER,
+  .fill  = colourspanFillSourceOver,
+  .blend = colourspanSourceOver,
+  .mask  = colourspanMaskSourceOver
+};
+
+static const struct ColourSpanOperator *colourspanOperators[] =
+{
+  [COLOUR_BLEND_CLEAR]       = &colourspanOperatorClear,
+  [COLOUR_BLEND_SOURCE]      = &colourspanOperatorSource,
+  [COLOUR_BLEND_DEST]        = &colourspanOperatorDest,
+  [COLOUR_BLEND_SOURCE_OVER] = &colourspanOperatorSourceOver,
+  [COLOUR_BLEND_SOURCE_IN]   = &colourspanOperatorSourceIn,
+  [COLOUR_BLEND_SOURCE_OUT]  = &colourspanOperatorSourceOut,
+  [COLOUR_BLEND_SOURCE_ATOP] = &colourspanOperatorSourceAtop,
+  [COLOUR_BLEND_DEST_OVER]   = &colourspanOperatorDestOver,
+  [COLOUR_BLEND_DEST_IN]     = &colourspanOperatorDestIn,
+  [COLOUR_BLEND_DEST_OUT]    = &colourspanOperatorDestOut,
+  [COLOUR_BLEND_DEST_ATOP]   = &colourspanOperatorDestAtop,
+  [COLOUR_BLEND_XOR]         = &colourspanOperatorXor
+};
+
+const struct ColourSpanOperator *
+colourspanGetOperator (enum ColourBlendMode mode)
+{
+  if ((unsigned int)mode >= sizeof (colourspanOperators)
+                            / sizeof (colourspanOperators[0]))
+    return NULL;
+  return colourspanOperators[mode];
+}
+
+/* arch-tag: 9b7e4a12-5c3d-4f86-a0e1-2d8c6f3b4a97
+ */
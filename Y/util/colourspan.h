@@ -0,0 +1,85 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#ifndef Y_UTIL_COLOURSPAN_H
+#define Y_UTIL_COLOURSPAN_H
+
+#include <Y/y.h>
+#include <Y/util/colour.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Span compositing.
+ *
+ * These functions blend a whole run of N pixels at once, and give
+ * exactly the same results as calling colourBlendSourceOver on each
+ * pixel in turn.  Where the CPU supports it, the work is done with
+ * SSE2 or AVX2 instructions; the server picks the implementation when
+ * the screen is initialised, and the scalar code is used until then.
+ */
+
+enum ColourSpanImplementation
+{
+  COLOURSPAN_IMPLEMENTATION_AUTO,
+  COLOURSPAN_IMPLEMENTATION_SCALAR,
+  COLOURSPAN_IMPLEMENTATION_SSE2,
+  COLOURSPAN_IMPLEMENTATION_AVX2
+};
+
+/* Select the implementation used by the span functions.  Returns false
+ * (and leaves the current selection alone) if the CPU cannot run it.
+ * Must not be called while other threads may be painting.
+ */
+bool colourspanSetImplementation (enum ColourSpanImplementation);
+enum ColourSpanImplementation colourspanGetImplementation (void);
+
+/* D[i] = S[i] over D[i] */
+void colourspanSourceOver (uint32_t *d, const uint32_t *s, int n);
+
+/* D[i] = COLOUR over D[i] */
+void colourspanFillSourceOver (uint32_t *d, uint32_t colour, int n);
+
+/* D[i] = COLOUR, modulated by ALPHA[i], over D[i] */
+void colourspanMaskSourceOver (uint32_t *d, uint32_t colour,
+                               const uint8_t *alpha, int n);
+
+/* Span operators for every blend mode.
+ *
+ * Each operator has one kernel per kind of source, compiled separately
+ * for its blend mode, and matches colourBlend exactly.  Look the
+ * operator up once when the mode is chosen and call it for whole rows.
+ */
+struct ColourSpanOperator
+{
+  enum ColourBlendMode mode;
+  /* D[i] = COLOUR op D[i] */
+  void (*fill)  (uint32_t *d, uint32_t colour, int n);
+  /* D[i] = S[i] op D[i] */
+  void (*blend) (uint32_t *d, const uint32_t *s, int n);
+  /* D[i] = (COLOUR modulated by ALPHA[i]) op D[i] */
+  void (*mask)  (uint32_t *d, uint32_t colour, const uint8_t *alpha, int n);
+};
+
+/* Returns NULL if MODE is not a valid blend mode. */
+const struct ColourSpanOperator *
+     colourspanGetOperator (enum ColourBlendMode mode);
+
+#endif
+
+/* arch-tag: 3f0c2d6e-8a51-4c7b-9e2f-6d1a4b0e7c53
+ */
@@ -0,0 +1,244 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/util/colourspan.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+const char *checkName;
+const char *checkModule;
+
+/* long enough to exercise every vector width and the scalar tails */
+#define SPAN_LENGTH 256
+#define SPAN_GUARD  0x5A5A5A5A
+
+static uint32_t
+colourspan_check_random_colour (uint32_t alpha)
+{
+  return (alpha << 24) | ((random () & 0xFF) << 16)
+                       | ((random () & 0xFF) << 8)
+                       |  (random () & 0xFF);
+}
+
+static int
+colourspan_check_source_over (void)
+{
+  uint32_t src[SPAN_LENGTH], dest[SPAN_LENGTH + 1], ref[SPAN_LENGTH];
+  int a1, a2, i, n;
+
+  checkModule = "source over";
+
+  /* every pair of alphas */
+  for (a1 = 0; a1 < 256; ++a1)
+    {
+      for (a2 = 0; a2 < 256; ++a2)
+        {
+          src[a2] = colourspan_check_random_colour (a2);
+          dest[a2] = ref[a2] = colourspan_check_random_colour (a1);
+          colourBlend (ref + a2, ref[a2], src[a2], 0xFF,
+                       COLOUR_BLEND_SOURCE_OVER);
+        }
+      colourspanSourceOver (dest, src, SPAN_LENGTH);
+      CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+    }
+
+  /* every length, checking nothing past the end is touched */
+  for (n = 0; n < 40; ++n)
+    {
+      for (i = 0; i < n; ++i)
+        {
+          src[i] = colourspan_check_random_colour (random () & 0xFF);
+          dest[i] = ref[i] = colourspan_check_random_colour (random () & 0xFF);
+          colourBlend (ref + i, ref[i], src[i], 0xFF,
+                       COLOUR_BLEND_SOURCE_OVER);
+        }
+      dest[n] = SPAN_GUARD;
+      colourspanSourceOver (dest, src, n);
+      CHECK_THAT ( memcmp (dest, ref, n * sizeof (uint32_t)) == 0 );
+      CHECK_THAT ( dest[n] == SPAN_GUARD );
+    }
+
+  return 0;
+}
+
+static int
+colourspan_check_fill_source_over (void)
+{
+  uint32_t dest[SPAN_LENGTH + 1], ref[SPAN_LENGTH];
+  uint32_t colour;
+  int a1, a2, i;
+
+  checkModule = "fill source over";
+
+  for (a2 = 0; a2 < 256; ++a2)
+    {
+      colour = colourspan_check_random_colour (a2);
+      for (a1 = 0; a1 < 256; ++a1)
+        {
+          dest[a1] = ref[a1] = colourspan_check_random_colour (a1);
+          colourBlend (ref + a1, ref[a1], colour, 0xFF,
+                       COLOUR_BLEND_SOURCE_OVER);
+        }
+      /* an odd length, so the tail is used as well */
+      dest[SPAN_LENGTH - 1] = SPAN_GUARD;
+      ref[SPAN_LENGTH - 1] = SPAN_GUARD;
+      colourspanFillSourceOver (dest, colour, SPAN_LENGTH - 1);
+      CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+    }
+
+  for (i = 0; i < 40; ++i)
+    {
+      colour = colourspan_check_random_colour (random () & 0xFF);
+      dest[i] = SPAN_GUARD;
+      colourspanFillSourceOver (dest, colour, i);
+      CHECK_THAT ( dest[i] == SPAN_GUARD );
+    }
+
+  return 0;
+}
+
+static int
+colourspan_check_mask_source_over (void)
+{
+  uint32_t dest[SPAN_LENGTH + 1], ref[SPAN_LENGTH];
+  uint8_t alpha[SPAN_LENGTH];
+  uint32_t colour;
+  int a1, a2, m;
+
+  checkModule = "mask source over";
+
+  for (a2 = 0; a2 < 256; ++a2)
+    {
+      colour = colourspan_check_random_colour (a2);
+      for (a1 = 0; a1 < 256; a1 += 5)
+        {
+          for (m = 0; m < 256; ++m)
+            {
+              alpha[m] = m;
+              dest[m] = ref[m] = colourspan_check_random_colour (a1);
+              colourBlend (ref + m, ref[m], colour, alpha[m],
+                           COLOUR_BLEND_SOURCE_OVER);
+            }
+          colourspanMaskSourceOver (dest, colour, alpha, SPAN_LENGTH);
+          CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+        }
+    }
+
+  /* runs of fully opaque and fully transparent coverage */
+  colour = colourspan_check_random_colour (0xFF);
+  for (m = 0; m < SPAN_LENGTH; ++m)
+    {
+      alpha[m] = (m / 16) % 2 ? 0xFF : 0;
+      dest[m] = ref[m] = colourspan_check_random_colour (random () & 0xFF);
+      colourBlend (ref + m, ref[m], colour, alpha[m],
+                   COLOUR_BLEND_SOURCE_OVER);
+    }
+  dest[SPAN_LENGTH - 3] = ref[SPAN_LENGTH - 3] = SPAN_GUARD;
+  colourspanMaskSourceOver (dest, colour, alpha, SPAN_LENGTH - 3);
+  CHECK_THAT ( memcmp (dest, ref, sizeof (ref) - 2 * sizeof (uint32_t)) == 0 );
+
+  return 0;
+}
+
+static int
+colourspan_check_operators (void)
+{
+  uint32_t src[SPAN_LENGTH], dest[SPAN_LENGTH], ref[SPAN_LENGTH];
+  uint8_t alpha[SPAN_LENGTH];
+  const struct ColourSpanOperator *op;
+  uint32_t colour;
+  int mode, i;
+
+  checkModule = "operators";
+
+  for (mode = COLOUR_BLEND_CLEAR; mode <= COLOUR_BLEND_XOR; ++mode)
+    {
+      op = colourspanGetOperator (mode);
+      CHECK_THAT ( op != NULL );
+      CHECK_THAT ( op->mode == (enum ColourBlendMode)mode );
+
+      colour = colourspan_check_random_colour (random () & 0xFF);
+      for (i = 0; i < SPAN_LENGTH; ++i)
+        {
+          dest[i] = ref[i] = colourspan_check_random_colour (i);
+          colourBlend (ref + i, ref[i], colour, 0xFF, mode);
+        }
+      op->fill (dest, colour, SPAN_LENGTH);
+      CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+
+      for (i = 0; i < SPAN_LENGTH; ++i)
+        {
+          src[i] = colourspan_check_random_colour (random () & 0xFF);
+          dest[i] = ref[i] = colourspan_check_random_colour (i);
+          colourBlend (ref + i, ref[i], src[i], 0xFF, mode);
+        }
+      op->blend (dest, src, SPAN_LENGTH);
+      CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+
+      for (i = 0; i < SPAN_LENGTH; ++i)
+        {
+          alpha[i] = random () & 0xFF;
+          dest[i] = ref[i] = colourspan_check_random_colour (i);
+          colourBlend (ref + i, ref[i], colour, alpha[i], mode);
+        }
+      op->mask (dest, colour, alpha, SPAN_LENGTH);
+      CHECK_THAT ( memcmp (dest, ref, sizeof (ref)) == 0 );
+    }
+
+  CHECK_THAT ( colourspanGetOperator (COLOUR_BLEND_XOR + 1) == NULL );
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const enum ColourSpanImplementation implementations[] =
+    {
+      COLOURSPAN_IMPLEMENTATION_SCALAR,
+      COLOURSPAN_IMPLEMENTATION_SSE2,
+      COLOURSPAN_IMPLEMENTATION_AVX2
+    };
+  static const char *names[] = { "ColourSpan/Scalar", "ColourSpan/SSE2",
+                                 "ColourSpan/AVX2" };
+  int failed = 0;
+  unsigned int i;
+
+  srandom (0x59);
+
+  for (i = 0; i < sizeof (implementations) / sizeof (implementations[0]); ++i)
+    {
+      checkName = names[i];
+      if (!colourspanSetImplementation (implementations[i]))
+        continue;
+      CHECK_THAT ( colourspanGetImplementation () == implementations[i] );
+      failed = colourspan_check_source_over () ? 1 : failed;
+      failed = colourspan_check_fill_source_over () ? 1 : failed;
+      failed = colourspan_check_mask_source_over () ? 1 : failed;
+      failed = colourspan_check_operators () ? 1 : failed;
+    }
+  return failed;
+}
+
+/* arch-tag: 6e2a91d4-0b7c-4f35-8d1e-a4c3f59b2e08
+ */
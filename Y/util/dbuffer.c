@@ -352,5 +352,139 @@ dbuffer_find_char(const struct dbuffer *buf, int c)
   return -1;
 }
 
+/** \brief Describe the data in a dbuffer for scatter/gather output
+ * \param buf the source buffer
+ * \param iov the iovecs to fill in
+ * \param max the number of iovecs available
+ * \return the number of iovecs filled in
+ *
+ * \par
+ * The iovecs point directly at the data in the buffer, in order, so
+ * writev() can send it without copying.  If there are more pieces than
+ * \c max, only the first \c max are described.  The iovecs are valid
+ * until the buffer is next changed.
+ */
+int
+dbuffer_get_iovec(const struct dbuffer *buf, struct iovec *iov, int max)
+{
+  struct dbuffer_element *e;
+  char *p;
+  int n = 0;
+  if (!buf || !iov)
+    return 0;
+  e = buf->head;
+  p = buf->start;
+  while (n < max && e && e->len > 0)
+    {
+      iov[n].iov_base = p;
+      iov[n].iov_len = e->len;
+      ++n;
+      e = e->next;
+      if (e)
+        p = &e->data[0];
+    }
+  return n;
+}
+
+/* The element that buf->end points into: every element before it is
+ * full, and every element after it is unused.
+ */
+static struct dbuffer_element *
+dbuffer_end_element(const struct dbuffer *buf)
+{
+  struct dbuffer_element *e = buf->head;
+  while (e->space == 0)
+    e = e->next;
+  return e;
+}
+
+/** \brief Describe free space in a dbuffer for scatter/gather input
+ * \param buf the target buffer
+ * \param len the number of bytes to make room for
+ * \param iov the iovecs to fill in
+ * \param max the number of iovecs available
+ * \return the number of iovecs filled in
+ *
+ * \par
+ * Grows the buffer so that at least \c len bytes can be added, and
+ * fills in iovecs pointing at the free space after the last byte stored,
+ * so readv() can read straight into the buffer.  The bytes read become
+ * part of the buffer when dbuffer_commit() is called, which must happen
+ * before the buffer is used in any other way.
+ */
+int
+dbuffer_reserve_iovec(struct dbuffer *buf, size_t len, struct iovec *iov, int max)
+{
+  struct dbuffer_element *e;
+  char *p;
+  /* as in dbuffer_add, the last byte of space is never used */
+  size_t space;
+  int n = 0;
+  if (!buf || !iov)
+    return 0;
+  if (len >= buf->space)
+    dbuffer_grow(buf, len);
+  space = buf->space - 1;
+  e = dbuffer_end_element(buf);
+  p = buf->end;
+  while (n < max && e && space > 0)
+    {
+      size_t l = (space < e->space) ? space : e->space;
+      iov[n].iov_base = p;
+      iov[n].iov_len = l;
+      space -= l;
+      ++n;
+      e = e->next;
+      if (e)
+        p = &e->data[0];
+    }
+  return n;
+}
+
+/** \brief Append data written straight into a dbuffer
+ * \param buf the target buffer
+ * \param len number of bytes written
+ *
+ * \par
+ * Adds the first \c len bytes of the space described by the last call
+ * to dbuffer_reserve_iovec() to the end of the buffer, and gives back
+ * any whole elements that weren't needed.
+ */
+void
+dbuffer_commit(struct dbuffer *buf, size_t len)
+{
+  struct dbuffer_element *e;
+  if (!buf)
+    return;
+  assert(len < buf->space);
+  e = dbuffer_end_element(buf);
+  while (len > 0)
+    {
+      size_t l = (len < e->space) ? len : e->space;
+      e->space -= l;
+      e->len += l;
+      buf->end += l;
+      buf->len += l;
+      buf->space -= l;
+      len -= l;
+      if (e->space == 0)
+	{
+	  e = e->next;
+          assert(e != NULL);
+	  buf->end = &e->data[0];
+	}
+    }
+
+  /* so that buf->end points into buf->tail again */
+  while (e->next)
+    {
+      struct dbuffer_element *spare = e->next;
+      e->next = spare->next;
+      buf->space -= spare->space;
+      free_element(spare);
+    }
+  buf->tail = e;
+}
+
 /* arch-tag: 0446940c-7d48-47a1-904f-d7246ac8a93c
  */
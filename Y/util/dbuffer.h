@@ -22,6 +22,7 @@ struct dbuffer;
 #define Y_UTIL_DBUFFER_H
 
 #include <sys/types.h>
+#include <sys/uio.h>
 
 /** \file dbuffer.h
  * \brief Data buffers (struct dbuffer)
@@ -93,6 +94,18 @@ extern size_t dbuffer_extract(struct dbuffer *, char *, size_t);
 /* Find the offset of the first occurance of this character, return -1 if not found */
 extern ssize_t dbuffer_find_char(const struct dbuffer *, int);
 
+/* Describe the data at the start of the buffer in at most the given
+ * number of iovecs, for writev; returns the number used */
+extern int dbuffer_get_iovec(const struct dbuffer *, struct iovec *, int);
+/* Make room for at least the given number of bytes at the end of the
+ * buffer, and describe the free space in at most the given number of
+ * iovecs, for readv; returns the number used */
+extern int dbuffer_reserve_iovec(struct dbuffer *, size_t, struct iovec *, int);
+/* Append the given number of bytes, which have been written to the
+ * space given by dbuffer_reserve_iovec.  This must be called after
+ * every dbuffer_reserve_iovec, even if nothing was written */
+extern void dbuffer_commit(struct dbuffer *, size_t);
+
 extern void dbuffer_cleanup(void);
 
 #define dbuffer_len(A) ((A)->len)
@@ -0,0 +1,143 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/util/dbuffer.h>
+#include <Y/util/yutil.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+const char *checkName;
+const char *checkModule;
+
+#define DATA_SIZE 20000
+
+static char data[DATA_SIZE];
+
+/* Copy LEN bytes from SRC into the iovecs, as readv would */
+static size_t
+dbuffer_check_scatter (const struct iovec *iov, int iovcnt,
+                       const char *src, size_t len)
+{
+  size_t copied = 0;
+  for (int i = 0; i < iovcnt && copied < len; ++i)
+    {
+      size_t l = len - copied;
+      if (l > iov[i].iov_len)
+        l = iov[i].iov_len;
+      memcpy (iov[i].iov_base, src + copied, l);
+      copied += l;
+    }
+  return copied;
+}
+
+/* Check that the iovecs describe exactly the first LEN bytes of DATA */
+static int
+dbuffer_check_gather (const struct iovec *iov, int iovcnt,
+                      const char *expected, size_t len)
+{
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i)
+    {
+      CHECK_THAT ( total + iov[i].iov_len <= len );
+      CHECK_THAT ( memcmp (iov[i].iov_base, expected + total,
+                           iov[i].iov_len) == 0 );
+      total += iov[i].iov_len;
+    }
+  CHECK_THAT ( total == len );
+  return 0;
+}
+
+static int
+dbuffer_check_iovec (void)
+{
+  struct dbuffer *buf = new_dbuffer ();
+  struct iovec iov[16];
+  static char out[DATA_SIZE];
+  size_t in = 0, removed = 0;
+  int n;
+
+  checkModule = "iovec";
+
+  for (int i = 0; i < DATA_SIZE; ++i)
+    data[i] = (char)(i * 7 + i / 251);
+
+  /* an empty buffer has nothing to write */
+  CHECK_THAT ( dbuffer_get_iovec (buf, iov, 16) == 0 );
+
+  /* reading nothing leaves the buffer usable */
+  n = dbuffer_reserve_iovec (buf, 9000, iov, 16);
+  CHECK_THAT ( n >= 3 );
+  dbuffer_commit (buf, 0);
+  CHECK_THAT ( dbuffer_len (buf) == 0 );
+
+  /* partial reads of varying sizes, across element boundaries, mixed
+   * with ordinary appends and removals */
+  while (in < DATA_SIZE)
+    {
+      size_t want = 1 + (in * 13) % 6000;
+      n = dbuffer_reserve_iovec (buf, want, iov, 16);
+      size_t got = dbuffer_check_scatter (iov, n, data + in,
+                                          MIN (want / 2 + 1, DATA_SIZE - in));
+      dbuffer_commit (buf, got);
+      in += got;
+
+      if (in < DATA_SIZE)
+        {
+          dbuffer_add (buf, data + in, 1);
+          in += 1;
+        }
+      CHECK_THAT ( dbuffer_len (buf) == in - removed );
+
+      n = dbuffer_get_iovec (buf, iov, 16);
+      if (dbuffer_check_gather (iov, n, data + removed, in - removed))
+        return 1;
+
+      removed += dbuffer_remove (buf, (in - removed) / 3);
+    }
+
+  /* the remaining contents are intact */
+  CHECK_THAT ( dbuffer_extract (buf, out, DATA_SIZE) == DATA_SIZE - removed );
+  CHECK_THAT ( memcmp (out, data + removed, DATA_SIZE - removed) == 0 );
+  CHECK_THAT ( dbuffer_len (buf) == 0 );
+
+  /* and still usable */
+  dbuffer_add (buf, data, 10);
+  CHECK_THAT ( dbuffer_get (buf, out, 10) == 10 );
+  CHECK_THAT ( memcmp (out, data, 10) == 0 );
+
+  free_dbuffer (buf);
+  dbuffer_cleanup ();
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int failed = 0;
+  checkName = "dbuffer";
+  failed = dbuffer_check_iovec () ? 1 : failed;
+  return failed;
+}
+
+/* arch-tag: 5c0e8b27-d413-4a96-9f1e-73b2a6c84d10
+ */
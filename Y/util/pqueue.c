@@ -19,153 +19,185 @@
 #include <Y/util/pqueue.h>
 #include <Y/util/yutil.h>
 
-struct PQueueNode
-{
-  struct PQueueNode *next;
-  void *obj;
-};
+#include <string.h>
 
 struct PQueue
 {
-  struct PQueueNode *first, *last;
+  /* heap[0] is the first object, and the children of heap[i] are at
+   * heap[2i+1] and heap[2i+2] */
+  void **heap;
+  int length, size;
   int (*comparisonFunction)(const void *obj1, const void *obj2);
-  int length;
+  /* where the position of each object is kept, or -1 */
+  ptrdiff_t positionOffset;
 };
 
 struct PQueue *
 pqueueCreate (int (*comparisonFunction)(const void *obj1, const void *obj2))
 {
   struct PQueue *self = ymalloc (sizeof (struct PQueue));
-  self -> first = NULL;
-  self -> last = NULL;
+  self -> size = 16;
+  self -> heap = ymalloc (sizeof (void *) * self -> size);
   self -> length = 0;
   self -> comparisonFunction = comparisonFunction;
+  self -> positionOffset = -1;
+  return self;
+}
+
+struct PQueue *
+pqueueCreateTracked (int (*comparisonFunction)(const void *obj1, const void *obj2),
+                     size_t positionOffset)
+{
+  struct PQueue *self = pqueueCreate (comparisonFunction);
+  self -> positionOffset = positionOffset;
   return self;
 }
 
 void
 pqueueDestroy (struct PQueue *self, void (*destructorFunction)(void *obj))
 {
-  struct PQueueNode *current = self -> first;
-  while (current != NULL)
-    {
-      struct PQueueNode *next = current -> next;
-      if (destructorFunction)
-        destructorFunction (current -> obj);
-      yfree (current);
-      current = next;
-    }
+  if (destructorFunction)
+    for (int i = 0; i < self -> length; ++i)
+      destructorFunction (self -> heap[i]);
+  yfree (self -> heap);
   yfree (self);
 }
 
-void
-pqueueInsert (struct PQueue *self, void *obj)
+static inline void
+pqueueSetPosition (struct PQueue *self, void *obj, int position)
 {
-  int cmp;
-  struct PQueueNode *node, *current;
-
-  node = ymalloc (sizeof (struct PQueueNode));
-  node -> obj = obj;
+  if (self -> positionOffset >= 0)
+    *(int *)((char *)obj + self -> positionOffset) = position;
+}
 
-  self -> length++;
+static inline void
+pqueuePlace (struct PQueue *self, int i, void *obj)
+{
+  self -> heap[i] = obj;
+  pqueueSetPosition (self, obj, i);
+}
 
-  /* is it the only node */
-  if (self -> first == NULL)
+/* Move the object at I towards the top until its parent is before it */
+static void
+pqueueSiftUp (struct PQueue *self, int i)
+{
+  void *obj = self -> heap[i];
+  while (i > 0)
     {
-      self -> first = node;
-      self -> last = node;
-      node -> next = NULL;
-      return;
+      int parent = (i - 1) / 2;
+      if (self -> comparisonFunction (obj, self -> heap[parent]) >= 0)
+        break;
+      pqueuePlace (self, i, self -> heap[parent]);
+      i = parent;
     }
+  pqueuePlace (self, i, obj);
+}
 
-  /* does it belong at the end? */
-  cmp = self -> comparisonFunction (obj, self -> last -> obj);
-  if (cmp >= 0)
+/* Move the object at I towards the bottom until its children are after it */
+static void
+pqueueSiftDown (struct PQueue *self, int i)
+{
+  void *obj = self -> heap[i];
+  for (;;)
     {
-      self -> last -> next = node;
-      self -> last = node;
-      node -> next = NULL;
-      return;
+      int child = 2 * i + 1;
+      if (child >= self -> length)
+        break;
+      if (child + 1 < self -> length
+          && self -> comparisonFunction (self -> heap[child + 1],
+                                         self -> heap[child]) < 0)
+        ++child;
+      if (self -> comparisonFunction (self -> heap[child], obj) >= 0)
+        break;
+      pqueuePlace (self, i, self -> heap[child]);
+      i = child;
     }
- 
-  /* does it belong at the beginning? */ 
-  cmp = self -> comparisonFunction (obj, self -> first -> obj);
-  if (cmp < 0)
+  pqueuePlace (self, i, obj);
+}
+
+/* Take the object at I out of the heap */
+static void *
+pqueueTake (struct PQueue *self, int i)
+{
+  void *obj = self -> heap[i];
+  pqueueSetPosition (self, obj, -1);
+  self -> length--;
+  if (i < self -> length)
     {
-      node -> next = self -> first;
-      self -> first = node;
-      return;
+      self -> heap[i] = self -> heap[self -> length];
+      if (i > 0 && self -> comparisonFunction (self -> heap[i],
+                                               self -> heap[(i - 1) / 2]) < 0)
+        pqueueSiftUp (self, i);
+      else
+        pqueueSiftDown (self, i);
     }
+  return obj;
+}
 
-  /* find which node it belongs after */
-  current = self -> first;
-  while (current -> next != NULL)
+void
+pqueueInsert (struct PQueue *self, void *obj)
+{
+  if (self -> length == self -> size)
     {
-      cmp = self -> comparisonFunction (obj, current -> next -> obj);
-      if (cmp < 0)
-        break;
-      current = current -> next;
+      void **heap = ymalloc (sizeof (void *) * self -> size * 2);
+      memcpy (heap, self -> heap, sizeof (void *) * self -> length);
+      yfree (self -> heap);
+      self -> heap = heap;
+      self -> size *= 2;
     }
-
-  node -> next = current -> next;
-  current -> next = node;
-  return;
-
+  self -> heap[self -> length++] = obj;
+  pqueueSiftUp (self, self -> length - 1);
 }
 
 void *
 pqueueGetNext (struct PQueue *self)
 {
-  struct PQueueNode *first;
-  void *obj;
-
-  first = self -> first;
-  if (first == NULL)
+  if (self -> length == 0)
     return NULL;
-
-  self -> length --;
-  self -> first = first -> next;
-  if (self -> first == NULL)
-    self -> last = NULL;
-
-  obj = first -> obj;
-  yfree (first);
-  return obj; 
+  return pqueueTake (self, 0);
 }
 
 void *
 pqueuePeekNext (const struct PQueue *self)
 {
-  if (self -> first == NULL)
+  if (self -> length == 0)
     return NULL;
-  return self -> first -> obj;
+  return self -> heap[0];
 }
 
 void
 pqueueRemove (struct PQueue *self, void *userData, int (*testFunction)(void *obj, void *data))
 {
-  struct PQueueNode *previous = NULL;
-  struct PQueueNode *current = self -> first;
-  while (current != NULL)
+  int kept = 0;
+  for (int i = 0; i < self -> length; ++i)
     {
-      struct PQueueNode *next = current -> next;
-      if (testFunction (current->obj, userData) != 0)
-        {
-          if (previous == NULL)
-              self -> first = next;
-          else
-              previous -> next = next;
-          yfree (current);
-          current = next;
-          if (current == NULL)
-            self -> last = previous;
-        }
-      else
-        {
-          previous = current;
-          current = next;
-        }
+      void *obj = self -> heap[i];
+      if (testFunction (obj, userData) != 0)
+        continue;
+      self -> heap[kept++] = obj;
     }
+  if (kept == self -> length)
+    return;
+
+  /* rebuild the heap from what's left */
+  self -> length = kept;
+  for (int i = 0; i < self -> length; ++i)
+    pqueueSetPosition (self, self -> heap[i], i);
+  for (int i = self -> length / 2 - 1; i >= 0; --i)
+    pqueueSiftDown (self, i);
+}
+
+int
+pqueueRemoveObject (struct PQueue *self, void *obj)
+{
+  int i;
+  if (self -> positionOffset < 0)
+    return 0;
+  i = *(int *)((char *)obj + self -> positionOffset);
+  if (i < 0 || i >= self -> length || self -> heap[i] != obj)
+    return 0;
+  pqueueTake (self, i);
+  return 1;
 }
 
 int
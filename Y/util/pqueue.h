@@ -19,10 +19,25 @@
 #ifndef Y_UTIL_PQUEUE_H
 #define Y_UTIL_PQUEUE_H
 
+#include <stddef.h>
+
 struct PQueue;
 
+/* A PQueue is a binary heap: insertion and removal take O(log n) time,
+ * and the next object can be looked at in O(1).  Objects that compare
+ * equal come out in no particular order.
+ */
+
 struct PQueue *pqueueCreate (int (*comparisonFunction)(const void *obj1, const void *obj2));
 
+/* Create a queue that records where each object is in the heap, in an
+ * int at POSITIONOFFSET bytes into the object, so that any object can be
+ * taken out with pqueueRemoveObject.  The position is -1 while the
+ * object is not in the queue.
+ */
+struct PQueue *pqueueCreateTracked (int (*comparisonFunction)(const void *obj1, const void *obj2),
+                                    size_t positionOffset);
+
 void          pqueueDestroy (struct PQueue *,
                              void (*destructorFunction)(void *obj));
 
@@ -33,8 +48,14 @@ void *        pqueuePeekNext (const struct PQueue *);
 
 int           pqueueLength (const struct PQueue *);
 
+/* Remove every object for which TESTFUNCTION returns non-zero.
+ * This looks at every object in the queue.
+ */
 void          pqueueRemove (struct PQueue *, void *userData, int (*testFunction)(void *obj, void *data));
 
+/* Remove OBJ from a tracked queue.  Returns non-zero if it was there. */
+int           pqueueRemoveObject (struct PQueue *, void *obj);
+
 #endif
 
 /* arch-tag: ef9aff25-3610-4d7a-a59a-b6307ec11010
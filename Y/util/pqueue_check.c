@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <stddef.h>
 
 const char *checkName;
 const char *checkModule;
@@ -35,6 +36,7 @@ struct pqueue_check_Functionality
 {
   long int priority;
   int checkCode;
+  int position;
 };
 
 static int
@@ -109,6 +111,51 @@ pqueue_check_functionality (void)
     
 }
 
+static int
+pqueue_check_remove (void)
+{
+  struct PQueue *pqueue;
+  struct pqueue_check_Functionality objs[FUNCTIONALITY_NUM_CHECK];
+  struct pqueue_check_Functionality *obj;
+  long int last;
+  int i, count;
+
+  checkModule = "remove";
+
+  pqueue = pqueueCreateTracked (pqueue_check_functionality_comparisonFunction,
+                                offsetof (struct pqueue_check_Functionality,
+                                          position));
+
+  for (i=0; i<FUNCTIONALITY_NUM_CHECK; ++i)
+    {
+      objs[i].priority = random () % 50;
+      objs[i].checkCode = i;
+      pqueueInsert (pqueue, &objs[i]);
+    }
+  CHECK_THAT ( pqueueLength (pqueue) == FUNCTIONALITY_NUM_CHECK );
+
+  /* take out every third object, one of them twice */
+  for (i=0; i<FUNCTIONALITY_NUM_CHECK; i += 3)
+    CHECK_THAT ( pqueueRemoveObject (pqueue, &objs[i]) );
+  CHECK_THAT ( !pqueueRemoveObject (pqueue, &objs[0]) );
+  CHECK_THAT ( objs[0].position == -1 );
+
+  last = -1;
+  count = 0;
+  while ((obj = pqueueGetNext (pqueue)) != NULL)
+    {
+      CHECK_THAT ( last <= obj -> priority );
+      CHECK_THAT ( obj -> checkCode % 3 != 0 );
+      CHECK_THAT ( obj -> position == -1 );
+      last = obj -> priority;
+      ++count;
+    }
+  CHECK_THAT ( count == FUNCTIONALITY_NUM_CHECK - (FUNCTIONALITY_NUM_CHECK + 2) / 3 );
+
+  pqueueDestroy (pqueue, NULL);
+
+  return 0;
+}
 
 int
 main (int argc, char **argv)
@@ -116,6 +163,7 @@ main (int argc, char **argv)
   int failed = 0;
   checkName = "PQueue";
   failed = pqueue_check_functionality () ? 1 : failed;
+  failed = pqueue_check_remove () ? 1 : failed;
   return failed;
 }
 
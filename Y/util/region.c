@@ -0,0 +1,453 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include <Y/util/region.h>
+#include <Y/util/yutil.h>
+
+#include <string.h>
+
+struct Region
+{
+  struct Rectangle extents;
+  int count;
+  int size;
+  struct Rectangle *rects;
+};
+
+enum RegionOperation
+{
+  REGION_UNION,
+  REGION_INTERSECT,
+  REGION_SUBTRACT
+};
+
+/* the new set of rectangles while an operation is in progress */
+struct RegionBuilder
+{
+  struct Rectangle *rects;
+  int count;
+  int size;
+  int previousBand;
+};
+
+struct Region *
+regionCreate (void)
+{
+  struct Region *self = ymalloc (sizeof (struct Region));
+  self -> extents.x = 0;
+  self -> extents.y = 0;
+  self -> extents.w = 0;
+  self -> extents.h = 0;
+  self -> count = 0;
+  self -> size = 0;
+  self -> rects = NULL;
+  return self;
+}
+
+struct Region *
+regionCreateRectangle (const struct Rectangle *rect)
+{
+  struct Region *self = regionCreate ();
+  regionUnionRectangle (self, rect);
+  return self;
+}
+
+struct Region *
+regionDuplicate (const struct Region *region)
+{
+  struct Region *self = regionCreate ();
+  self -> extents = region -> extents;
+  self -> count = region -> count;
+  self -> size = region -> count;
+  if (region -> count > 0)
+    {
+      self -> rects = ymalloc (sizeof (struct Rectangle) * region -> count);
+      memcpy (self -> rects, region -> rects,
+              sizeof (struct Rectangle) * region -> count);
+    }
+  return self;
+}
+
+void
+regionDestroy (struct Region *self)
+{
+  if (self == NULL)
+    return;
+  yfree (self -> rects);
+  yfree (self);
+}
+
+void
+regionClear (struct Region *self)
+{
+  self -> count = 0;
+  self -> extents.x = 0;
+  self -> extents.y = 0;
+  self -> extents.w = 0;
+  self -> extents.h = 0;
+}
+
+bool
+regionIsEmpty (const struct Region *self)
+{
+  return self -> count == 0;
+}
+
+bool
+regionContainsPoint (const struct Region *self, int32_t x, int32_t y)
+{
+  if (x < self -> extents.x || x >= self -> extents.x + self -> extents.w
+      || y < self -> extents.y || y >= self -> extents.y + self -> extents.h)
+    return false;
+  for (int i = 0; i < self -> count; ++i)
+    {
+      const struct Rectangle *r = self -> rects + i;
+      if (r -> y > y)
+        break;
+      if (x >= r -> x && x < r -> x + r -> w && y < r -> y + r -> h)
+        return true;
+    }
+  return false;
+}
+
+void
+regionGetExtents (const struct Region *self, struct Rectangle *rect)
+{
+  *rect = self -> extents;
+}
+
+const struct Rectangle *
+regionGetRectangles (const struct Region *self, int *count_p)
+{
+  if (count_p != NULL)
+    *count_p = self -> count;
+  return self -> rects;
+}
+
+static void
+regionComputeExtents (struct Region *self)
+{
+  int32_t x0, x1;
+  if (self -> count == 0)
+    {
+      regionClear (self);
+      return;
+    }
+  x0 = self -> rects[0].x;
+  x1 = self -> rects[0].x + self -> rects[0].w;
+  for (int i = 1; i < self -> count; ++i)
+    {
+      x0 = MIN (x0, self -> rects[i].x);
+      x1 = MAX (x1, self -> rects[i].x + self -> rects[i].w);
+    }
+  self -> extents.x = x0;
+  self -> extents.y = self -> rects[0].y;
+  self -> extents.w = x1 - x0;
+  self -> extents.h = self -> rects[self -> count - 1].y
+                      + self -> rects[self -> count - 1].h
+                      - self -> rects[0].y;
+}
+
+/* Add a band of N spans, given as (x0, x1) pairs, covering the rows TOP
+ * to BOTTOM.  If the band directly above has exactly the same spans,
+ * it is stretched down instead.
+ */
+static void
+regionBuilderAddBand (struct RegionBuilder *builder, int32_t top,
+                      int32_t bottom, const int32_t *spans, int n)
+{
+  if (n == 0)
+    return;
+
+  if (builder -> previousBand >= 0
+      && builder -> count - builder -> previousBand == n
+      && builder -> rects[builder -> previousBand].y
+         + builder -> rects[builder -> previousBand].h == top)
+    {
+      struct Rectangle *previous = builder -> rects + builder -> previousBand;
+      int i;
+      for (i = 0; i < n; ++i)
+        if (previous[i].x != spans[2 * i]
+            || previous[i].w != spans[2 * i + 1] - spans[2 * i])
+          break;
+      if (i == n)
+        {
+          for (i = 0; i < n; ++i)
+            previous[i].h += bottom - top;
+          return;
+        }
+    }
+
+  if (builder -> count + n > builder -> size)
+    {
+      int size = MAX (builder -> size * 2, builder -> count + n);
+      struct Rectangle *rects = ymalloc (sizeof (struct Rectangle) * size);
+      if (builder -> count > 0)
+        memcpy (rects, builder -> rects,
+                sizeof (struct Rectangle) * builder -> count);
+      yfree (builder -> rects);
+      builder -> rects = rects;
+      builder -> size = size;
+    }
+
+  builder -> previousBand = builder -> count;
+  for (int i = 0; i < n; ++i)
+    {
+      struct Rectangle *r = builder -> rects + builder -> count++;
+      r -> x = spans[2 * i];
+      r -> y = top;
+      r -> w = spans[2 * i + 1] - spans[2 * i];
+      r -> h = bottom - top;
+    }
+}
+
+/* Combine the spans of one band from each region.  Either band may be
+ * empty.  The result is written to SPANS, and the number of spans in
+ * it is returned.
+ */
+static int
+regionCombineSpans (enum RegionOperation op, int32_t *spans,
+                    const struct Rectangle *a, int na,
+                    const struct Rectangle *b, int nb)
+{
+  int n = 0, ia = 0, ib = 0;
+
+  switch (op)
+    {
+      case REGION_UNION:
+        while (ia < na || ib < nb)
+          {
+            const struct Rectangle *r;
+            if (ib >= nb || (ia < na && a[ia].x <= b[ib].x))
+              r = a + ia++;
+            else
+              r = b + ib++;
+            /* spans that touch are joined */
+            if (n > 0 && r -> x <= spans[2 * n - 1])
+              spans[2 * n - 1] = MAX (spans[2 * n - 1], r -> x + r -> w);
+            else
+              {
+                spans[2 * n] = r -> x;
+                spans[2 * n + 1] = r -> x + r -> w;
+                ++n;
+              }
+          }
+        break;
+
+      case REGION_INTERSECT:
+        while (ia < na && ib < nb)
+          {
+            int32_t x0 = MAX (a[ia].x, b[ib].x);
+            int32_t aEnd = a[ia].x + a[ia].w;
+            int32_t bEnd = b[ib].x + b[ib].w;
+            int32_t x1 = MIN (aEnd, bEnd);
+            if (x0 < x1)
+              {
+                spans[2 * n] = x0;
+                spans[2 * n + 1] = x1;
+                ++n;
+              }
+            if (aEnd < bEnd)
+              ++ia;
+            else
+              ++ib;
+          }
+        break;
+
+      case REGION_SUBTRACT:
+        for (ia = 0; ia < na; ++ia)
+          {
+            int32_t x = a[ia].x;
+            int32_t aEnd = a[ia].x + a[ia].w;
+            while (ib < nb && b[ib].x + b[ib].w <= x)
+              ++ib;
+            for (int j = ib; j < nb && b[j].x < aEnd; ++j)
+              {
+                if (b[j].x > x)
+                  {
+                    spans[2 * n] = x;
+                    spans[2 * n + 1] = b[j].x;
+                    ++n;
+                  }
+                x = MAX (x, b[j].x + b[j].w);
+              }
+            if (x < aEnd)
+              {
+                spans[2 * n] = x;
+                spans[2 * n + 1] = aEnd;
+                ++n;
+              }
+          }
+        break;
+    }
+
+  return n;
+}
+
+/* the first rectangle after the band starting at R */
+static const struct Rectangle *
+regionBandEnd (const struct Rectangle *r, const struct Rectangle *end)
+{
+  const struct Rectangle *band = r;
+  while (r < end && r -> y == band -> y)
+    ++r;
+  return r;
+}
+
+/* Sweep down both regions at once, splitting them into horizontal
+ * strips wherever either region starts or ends a band, and combine
+ * each strip one band at a time.
+ */
+static void
+regionOperate (struct Region *dest, const struct Region *src1,
+               const struct Region *src2, enum RegionOperation op)
+{
+  const struct Rectangle *a = src1 -> rects, *aEnd = a + src1 -> count;
+  const struct Rectangle *b = src2 -> rects, *bEnd = b + src2 -> count;
+  struct RegionBuilder builder = { NULL, 0, 0, -1 };
+  int32_t *spans = ymalloc (sizeof (int32_t) * 2
+                            * (src1 -> count + src2 -> count + 1));
+  int32_t y = INT32_MIN;
+
+  while (a < aEnd || b < bEnd)
+    {
+      const struct Rectangle *aNext = regionBandEnd (a, aEnd);
+      const struct Rectangle *bNext = regionBandEnd (b, bEnd);
+      int32_t aTop = INT32_MAX, aBottom = INT32_MAX;
+      int32_t bTop = INT32_MAX, bBottom = INT32_MAX;
+      int32_t top, bottom;
+      bool aActive, bActive;
+
+      if (op == REGION_INTERSECT && (a == aEnd || b == bEnd))
+        break;
+      if (op == REGION_SUBTRACT && a == aEnd)
+        break;
+
+      if (a < aEnd)
+        {
+          aTop = MAX (a -> y, y);
+          aBottom = a -> y + a -> h;
+        }
+      if (b < bEnd)
+        {
+          bTop = MAX (b -> y, y);
+          bBottom = b -> y + b -> h;
+        }
+
+      top = MIN (aTop, bTop);
+      aActive = (a < aEnd && aTop == top);
+      bActive = (b < bEnd && bTop == top);
+      bottom = MIN (aActive ? aBottom : aTop, bActive ? bBottom : bTop);
+
+      regionBuilderAddBand (&builder, top, bottom, spans,
+                            regionCombineSpans (op, spans,
+                                                a, aActive ? aNext - a : 0,
+                                                b, bActive ? bNext - b : 0));
+
+      y = bottom;
+      if (a < aEnd && aBottom <= y)
+        a = aNext;
+      if (b < bEnd && bBottom <= y)
+        b = bNext;
+    }
+
+  yfree (spans);
+  yfree (dest -> rects);
+  dest -> rects = builder.rects;
+  dest -> count = builder.count;
+  dest -> size = builder.size;
+  regionComputeExtents (dest);
+}
+
+void
+regionUnion (struct Region *dest,
+             const struct Region *src1, const struct Region *src2)
+{
+  regionOperate (dest, src1, src2, REGION_UNION);
+}
+
+void
+regionIntersect (struct Region *dest,
+                 const struct Region *src1, const struct Region *src2)
+{
+  regionOperate (dest, src1, src2, REGION_INTERSECT);
+}
+
+void
+regionSubtract (struct Region *dest,
+                const struct Region *src1, const struct Region *src2)
+{
+  regionOperate (dest, src1, src2, REGION_SUBTRACT);
+}
+
+/* wrap a single rectangle as a region, without allocating */
+static void
+regionFromRectangle (struct Region *region, struct Rectangle *storage,
+                     const struct Rectangle *rect)
+{
+  *storage = *rect;
+  region -> extents = *rect;
+  region -> rects = storage;
+  region -> size = 1;
+  region -> count = (rect -> w > 0 && rect -> h > 0) ? 1 : 0;
+}
+
+void
+regionUnionRectangle (struct Region *self, const struct Rectangle *rect)
+{
+  struct Region region;
+  struct Rectangle storage;
+  regionFromRectangle (&region, &storage, rect);
+  regionOperate (self, self, &region, REGION_UNION);
+}
+
+void
+regionIntersectRectangle (struct Region *self, const struct Rectangle *rect)
+{
+  struct Region region;
+  struct Rectangle storage;
+  regionFromRectangle (&region, &storage, rect);
+  regionOperate (self, self, &region, REGION_INTERSECT);
+}
+
+void
+regionSubtractRectangle (struct Region *self, const struct Rectangle *rect)
+{
+  struct Region region;
+  struct Rectangle storage;
+  regionFromRectangle (&region, &storage, rect);
+  regionOperate (self, self, &region, REGION_SUBTRACT);
+}
+
+void
+regionTranslate (struct Region *self, int32_t dx, int32_t dy)
+{
+  for (int i = 0; i < self -> count; ++i)
+    {
+      self -> rects[i].x += dx;
+      self -> rects[i].y += dy;
+    }
+  if (self -> count > 0)
+    {
+      self -> extents.x += dx;
+      self -> extents.y += dy;
+    }
+}
+
+/* arch-tag: 5e8b0d17-3c6a-4f92-b1d4-7a0c9e2f6b38
+ */
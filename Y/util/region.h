@@ -0,0 +1,75 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+struct Region;
+
+#ifndef Y_UTIL_REGION_H
+#define Y_UTIL_REGION_H
+
+#include <Y/util/rectangle.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+/* A Region is an arbitrary set of pixels, stored as a list of
+ * non-overlapping rectangles in a single array.
+ *
+ * The rectangles are sorted into horizontal bands: every rectangle in
+ * a band has the same y and h, the bands are ordered top to bottom,
+ * and the rectangles within a band are ordered left to right and never
+ * touch.  Vertically adjacent bands with identical rectangles are
+ * merged, so a given set of pixels always has the same representation.
+ */
+
+struct Region *regionCreate (void);
+struct Region *regionCreateRectangle (const struct Rectangle *);
+struct Region *regionDuplicate (const struct Region *);
+void           regionDestroy (struct Region *);
+
+/* make the region empty */
+void regionClear (struct Region *);
+
+bool regionIsEmpty (const struct Region *);
+bool regionContainsPoint (const struct Region *, int32_t x, int32_t y);
+
+/* the bounding box of the region; an empty region has empty extents */
+void regionGetExtents (const struct Region *, struct Rectangle *);
+
+/* the rectangles making up the region, valid until it is next changed */
+const struct Rectangle *
+     regionGetRectangles (const struct Region *, int *count_p);
+
+/* dest may equal src1 or src2, e.g.
+ *         regionUnion (r1, r1, r2)  <->  r1 = r1 U r2 */
+void regionUnion     (struct Region *dest,
+                      const struct Region *src1, const struct Region *src2);
+void regionIntersect (struct Region *dest,
+                      const struct Region *src1, const struct Region *src2);
+/* dest = src1 - src2 */
+void regionSubtract  (struct Region *dest,
+                      const struct Region *src1, const struct Region *src2);
+
+void regionUnionRectangle     (struct Region *, const struct Rectangle *);
+void regionIntersectRectangle (struct Region *, const struct Rectangle *);
+void regionSubtractRectangle  (struct Region *, const struct Rectangle *);
+
+void regionTranslate (struct Region *, int32_t dx, int32_t dy);
+
+#endif
+
+/* arch-tag: 9c41e7b2-5d38-4f0a-a6e1-2b7d83c5f916
+ */
@@ -0,0 +1,264 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/util/region.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+const char *checkName;
+const char *checkModule;
+
+/* regions are compared pixel by pixel against a bitmap of this size,
+ * whose top left corner is at (-ORIGIN, -ORIGIN) */
+#define GRID 48
+#define ORIGIN 4
+
+static void
+region_check_random_rectangle (struct Rectangle *r)
+{
+  r->x = (random () % (GRID / 2)) - ORIGIN;
+  r->y = (random () % (GRID / 2)) - ORIGIN;
+  r->w = random () % (GRID / 2);
+  r->h = random () % (GRID / 2);
+}
+
+static void
+region_check_paint (bool bitmap[GRID][GRID], const struct Rectangle *r,
+                    bool value)
+{
+  for (int y = r->y; y < r->y + r->h; ++y)
+    for (int x = r->x; x < r->x + r->w; ++x)
+      bitmap[y + ORIGIN][x + ORIGIN] = value;
+}
+
+/* the rectangles must be banded, sorted, non-overlapping and coalesced,
+ * and cover exactly the pixels in the bitmap */
+static bool
+region_check_matches (const struct Region *region, bool bitmap[GRID][GRID])
+{
+  const struct Rectangle *rects;
+  struct Rectangle extents;
+  int count;
+
+  rects = regionGetRectangles (region, &count);
+  for (int i = 0, band = 0, previous = -1; i < count; ++i)
+    {
+      if (rects[i].w <= 0 || rects[i].h <= 0)
+        return false;
+      if (i > 0 && rects[i].y == rects[i - 1].y)
+        {
+          if (rects[i].h != rects[i - 1].h
+              || rects[i].x <= rects[i - 1].x + rects[i - 1].w)
+            return false;
+        }
+      else if (i > 0)
+        {
+          if (rects[i].y < rects[i - 1].y + rects[i - 1].h)
+            return false;
+          previous = band;
+          band = i;
+        }
+      /* a band identical to the one directly above should have been
+       * merged into it */
+      if (previous >= 0 && (i + 1 == count || rects[i + 1].y != rects[i].y)
+          && i - band == band - 1 - previous
+          && rects[previous].y + rects[previous].h == rects[band].y)
+        {
+          int j;
+          for (j = 0; j <= i - band; ++j)
+            if (rects[previous + j].x != rects[band + j].x
+                || rects[previous + j].w != rects[band + j].w)
+              break;
+          if (j > i - band)
+            return false;
+        }
+    }
+
+  for (int y = -1; y <= GRID; ++y)
+    for (int x = -1; x <= GRID; ++x)
+      {
+        bool expected = (x >= 0 && y >= 0 && x < GRID && y < GRID)
+                        ? bitmap[y][x] : false;
+        if (regionContainsPoint (region, x - ORIGIN, y - ORIGIN) != expected)
+          return false;
+      }
+
+  regionGetExtents (region, &extents);
+  if (count == 0)
+    return extents.w == 0 && extents.h == 0;
+  for (int i = 0; i < count; ++i)
+    if (rects[i].x < extents.x || rects[i].y < extents.y
+        || rects[i].x + rects[i].w > extents.x + extents.w
+        || rects[i].y + rects[i].h > extents.y + extents.h)
+      return false;
+
+  return true;
+}
+
+static int
+region_check_functionality (void)
+{
+  struct Rectangle a = { 0, 0, 10, 10 };
+  struct Rectangle b = { 20, 20, 10, 10 };
+  struct Rectangle c = { 10, 0, 10, 10 };
+  struct Rectangle hole = { 3, 3, 4, 4 };
+  struct Region *region;
+  const struct Rectangle *rects;
+  struct Rectangle extents;
+  int count;
+
+  checkModule = "functionality";
+
+  region = regionCreate ();
+  CHECK_THAT ( region != NULL );
+  CHECK_THAT ( regionIsEmpty (region) );
+
+  /* two far apart damages stay separate */
+  regionUnionRectangle (region, &a);
+  regionUnionRectangle (region, &b);
+  rects = regionGetRectangles (region, &count);
+  CHECK_THAT ( count == 2 );
+  CHECK_THAT ( rects[0].x == 0 && rects[0].w == 10 );
+  CHECK_THAT ( rects[1].x == 20 && rects[1].w == 10 );
+  regionGetExtents (region, &extents);
+  CHECK_THAT ( extents.x == 0 && extents.y == 0 );
+  CHECK_THAT ( extents.w == 30 && extents.h == 30 );
+
+  /* touching rectangles are joined */
+  regionSubtractRectangle (region, &b);
+  regionUnionRectangle (region, &c);
+  rects = regionGetRectangles (region, &count);
+  CHECK_THAT ( count == 1 );
+  CHECK_THAT ( rects[0].x == 0 && rects[0].y == 0 );
+  CHECK_THAT ( rects[0].w == 20 && rects[0].h == 10 );
+
+  /* a hole leaves four rectangles in three bands */
+  regionSubtractRectangle (region, &hole);
+  rects = regionGetRectangles (region, &count);
+  CHECK_THAT ( count == 4 );
+  CHECK_THAT ( !regionContainsPoint (region, 5, 5) );
+  CHECK_THAT ( regionContainsPoint (region, 15, 5) );
+
+  regionTranslate (region, -5, 100);
+  CHECK_THAT ( !regionContainsPoint (region, 0, 105) );
+  CHECK_THAT ( regionContainsPoint (region, -5, 100) );
+  regionGetExtents (region, &extents);
+  CHECK_THAT ( extents.x == -5 && extents.y == 100 );
+
+  regionIntersectRectangle (region, &a);
+  CHECK_THAT ( regionIsEmpty (region) );
+
+  /* empty rectangles add nothing */
+  a.w = 0;
+  regionUnionRectangle (region, &a);
+  CHECK_THAT ( regionIsEmpty (region) );
+
+  regionDestroy (region);
+
+  return 0;
+}
+
+static int
+region_check_operations (void)
+{
+  static bool bitmap[GRID][GRID], bitmap2[GRID][GRID];
+  struct Region *region, *other, *result;
+  struct Rectangle r;
+
+  checkModule = "operations";
+
+  for (int round = 0; round < 500; ++round)
+    {
+      memset (bitmap, 0, sizeof (bitmap));
+      memset (bitmap2, 0, sizeof (bitmap2));
+      region = regionCreate ();
+      other = regionCreate ();
+
+      /* build up two regions with random damage and holes */
+      for (int i = 0; i < 12; ++i)
+        {
+          region_check_random_rectangle (&r);
+          if (random () % 4)
+            {
+              regionUnionRectangle (region, &r);
+              region_check_paint (bitmap, &r, true);
+            }
+          else
+            {
+              regionSubtractRectangle (region, &r);
+              region_check_paint (bitmap, &r, false);
+            }
+          CHECK_THAT ( region_check_matches (region, bitmap) );
+
+          region_check_random_rectangle (&r);
+          regionUnionRectangle (other, &r);
+          region_check_paint (bitmap2, &r, true);
+        }
+
+      result = regionDuplicate (region);
+      regionUnion (result, result, other);
+      for (int y = 0; y < GRID; ++y)
+        for (int x = 0; x < GRID; ++x)
+          CHECK_THAT ( regionContainsPoint (result, x - ORIGIN, y - ORIGIN)
+                       == (bitmap[y][x] || bitmap2[y][x]) );
+
+      regionIntersect (result, region, other);
+      for (int y = 0; y < GRID; ++y)
+        for (int x = 0; x < GRID; ++x)
+          CHECK_THAT ( regionContainsPoint (result, x - ORIGIN, y - ORIGIN)
+                       == (bitmap[y][x] && bitmap2[y][x]) );
+
+      regionSubtract (result, region, other);
+      for (int y = 0; y < GRID; ++y)
+        for (int x = 0; x < GRID; ++x)
+          CHECK_THAT ( regionContainsPoint (result, x - ORIGIN, y - ORIGIN)
+                       == (bitmap[y][x] && !bitmap2[y][x]) );
+
+      /* region - other with the destination being the second operand */
+      regionSubtract (other, region, other);
+      for (int y = 0; y < GRID; ++y)
+        for (int x = 0; x < GRID; ++x)
+          bitmap[y][x] = bitmap[y][x] && !bitmap2[y][x];
+      CHECK_THAT ( region_check_matches (other, bitmap) );
+
+      regionDestroy (result);
+      regionDestroy (other);
+      regionDestroy (region);
+    }
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int failed = 0;
+  checkName = "Region";
+  srandom (0x59);
+  failed = region_check_functionality () ? 1 : failed;
+  failed = region_check_operations () ? 1 : failed;
+  return failed;
+}
+
+/* arch-tag: e27a4c58-91d3-4b6f-8c0e-3f5d6a1b9c74
+ */
@@ -0,0 +1,167 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include <Y/util/threadpool.h>
+#include <Y/util/yutil.h>
+#include <Y/util/log.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <string.h>
+
+struct ThreadPool
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  int threads;
+  pthread_t *workers;
+  bool quit;
+
+  /* the current job */
+  void (*task) (void *, int);
+  void *data;
+  int count;
+  int next;
+  int finished;
+};
+
+/* Take tasks from the current job until there are none left.
+ * Called with the lock held, and returns with it held.
+ */
+static void
+threadpoolWork (struct ThreadPool *self)
+{
+  while (self -> task != NULL && self -> next < self -> count)
+    {
+      void (*task) (void *, int) = self -> task;
+      void *data = self -> data;
+      int index = self -> next++;
+      pthread_mutex_unlock (&(self -> lock));
+      task (data, index);
+      pthread_mutex_lock (&(self -> lock));
+      if (++self -> finished == self -> count)
+        pthread_cond_signal (&(self -> done));
+    }
+}
+
+static void *
+threadpoolWorker (void *self_v)
+{
+  struct ThreadPool *self = self_v;
+  pthread_mutex_lock (&(self -> lock));
+  while (!self -> quit)
+    {
+      if (self -> task == NULL || self -> next >= self -> count)
+        pthread_cond_wait (&(self -> work), &(self -> lock));
+      else
+        threadpoolWork (self);
+    }
+  pthread_mutex_unlock (&(self -> lock));
+  return NULL;
+}
+
+struct ThreadPool *
+threadpoolCreate (int threads)
+{
+  struct ThreadPool *self = ymalloc (sizeof (struct ThreadPool));
+  sigset_t all, old;
+
+  pthread_mutex_init (&(self -> lock), NULL);
+  pthread_cond_init (&(self -> work), NULL);
+  pthread_cond_init (&(self -> done), NULL);
+  self -> quit = false;
+  self -> task = NULL;
+  self -> data = NULL;
+  self -> count = 0;
+  self -> next = 0;
+  self -> finished = 0;
+  self -> threads = 1;
+  self -> workers = ymalloc (sizeof (pthread_t) * MAX (threads - 1, 1));
+
+  /* workers inherit this mask */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  while (self -> threads < threads)
+    {
+      int rc = pthread_create (self -> workers + self -> threads - 1, NULL,
+                               threadpoolWorker, self);
+      if (rc != 0)
+        {
+          Y_WARN ("threadpool: could only start %d of %d threads: %s",
+                  self -> threads, threads, strerror (rc));
+          break;
+        }
+      ++self -> threads;
+    }
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  return self;
+}
+
+void
+threadpoolDestroy (struct ThreadPool *self)
+{
+  if (self == NULL)
+    return;
+  pthread_mutex_lock (&(self -> lock));
+  self -> quit = true;
+  pthread_cond_broadcast (&(self -> work));
+  pthread_mutex_unlock (&(self -> lock));
+  for (int i = 0; i < self -> threads - 1; ++i)
+    pthread_join (self -> workers[i], NULL);
+  pthread_cond_destroy (&(self -> done));
+  pthread_cond_destroy (&(self -> work));
+  pthread_mutex_destroy (&(self -> lock));
+  yfree (self -> workers);
+  yfree (self);
+}
+
+int
+threadpoolGetThreads (const struct ThreadPool *self)
+{
+  return self -> threads;
+}
+
+void
+threadpoolRun (struct ThreadPool *self, int count,
+               void (*task) (void *data, int index), void *data)
+{
+  if (count <= 0)
+    return;
+
+  pthread_mutex_lock (&(self -> lock));
+  self -> task = task;
+  self -> data = data;
+  self -> count = count;
+  self -> next = 0;
+  self -> finished = 0;
+  if (count > 1)
+    pthread_cond_broadcast (&(self -> work));
+
+  threadpoolWork (self);
+  while (self -> finished < self -> count)
+    pthread_cond_wait (&(self -> done), &(self -> lock));
+
+  self -> task = NULL;
+  pthread_mutex_unlock (&(self -> lock));
+}
+
+/* arch-tag: 1f8c6a35-92d7-4b0e-8e4a-5d3b7c09a2e6
+ */
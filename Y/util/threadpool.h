@@ -0,0 +1,50 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+struct ThreadPool;
+
+#ifndef Y_UTIL_THREADPOOL_H
+#define Y_UTIL_THREADPOOL_H
+
+#include <Y/y.h>
+
+/* A ThreadPool is a fixed set of worker threads for splitting one job
+ * into many independent tasks.  The thread that runs a job works on it
+ * too, and does not return until every task has finished.
+ *
+ * Worker threads have all signals blocked, so signal handlers always
+ * run on the main thread.
+ */
+
+/* Create a pool with THREADS threads in total, including the caller. */
+struct ThreadPool *threadpoolCreate (int threads);
+void               threadpoolDestroy (struct ThreadPool *);
+
+int                threadpoolGetThreads (const struct ThreadPool *);
+
+/* Call TASK (DATA, i) for every i from 0 to COUNT - 1, spread across the
+ * pool, and wait for them all to finish.  Tasks may run in any order.
+ */
+void               threadpoolRun (struct ThreadPool *, int count,
+                                  void (*task) (void *data, int index),
+                                  void *data);
+
+#endif
+
+/* arch-tag: 7b3e9d12-4a6c-4e85-b0f7-c2d15a8e6f49
+ */
@@ -0,0 +1,85 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#define CHECK_STOP abort()
+#include <Y/util/check.h>
+
+#include <Y/util/threadpool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+const char *checkName;
+const char *checkModule;
+
+#define TASKS 1000
+
+static void
+threadpool_check_task (void *data, int index)
+{
+  int *counts = data;
+  /* each task owns its own slot, so no locking is needed */
+  counts[index] += index + 1;
+}
+
+static int
+threadpool_check_run (int threads)
+{
+  static int counts[TASKS];
+  struct ThreadPool *pool;
+
+  checkModule = "run";
+
+  pool = threadpoolCreate (threads);
+  CHECK_THAT ( pool != NULL );
+  CHECK_THAT ( threadpoolGetThreads (pool) >= 1 );
+  CHECK_THAT ( threadpoolGetThreads (pool) <= (threads < 1 ? 1 : threads) );
+
+  /* every task runs exactly once, every time */
+  memset (counts, 0, sizeof (counts));
+  for (int round = 0; round < 50; ++round)
+    threadpoolRun (pool, TASKS, threadpool_check_task, counts);
+  for (int i = 0; i < TASKS; ++i)
+    CHECK_THAT ( counts[i] == 50 * (i + 1) );
+
+  /* small and empty jobs */
+  memset (counts, 0, sizeof (counts));
+  threadpoolRun (pool, 0, threadpool_check_task, counts);
+  threadpoolRun (pool, 1, threadpool_check_task, counts);
+  CHECK_THAT ( counts[0] == 1 );
+  CHECK_THAT ( counts[1] == 0 );
+
+  threadpoolDestroy (pool);
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int failed = 0;
+  checkName = "ThreadPool";
+  failed = threadpool_check_run (1) ? 1 : failed;
+  failed = threadpool_check_run (4) ? 1 : failed;
+  failed = threadpool_check_run (0) ? 1 : failed;
+  return failed;
+}
+
+/* arch-tag: 3ad5e0c7-6b21-4f98-9c8e-0e7f4b1d52a3
+ */
@@ -20,25 +20,45 @@
 #include <Y/widget/widget_p.h>
 
 #include <Y/util/yutil.h>
+#include <Y/util/region.h>
+#include <Y/util/index.h>
+#include <Y/util/log.h>
 #include <Y/buffer/painter.h>
 #include <Y/buffer/buffer.h>
 #include <Y/buffer/rgbabuffer.h>
 
 #include <Y/object/class_p.h>
 #include <Y/object/object_p.h>
+#include <Y/message/client.h>
 
 #include <Y/text/font.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
 
 struct Canvas
 {
   struct Widget widget;
-  struct Buffer *front, *back;
+  struct RGBABuffer *front, *back;
   struct Painter *painter;
   int resizing;
+  /* what has been drawn on the back buffer since the last swap, and what
+   * was drawn in the frame before that; when the buffers are flipped
+   * rather than copied, the screen changes in both */
+  struct Region *unsynced, *previous;
+  /* images in the client's shared memory, by id */
+  struct Index *sharedImages;
+  uint32_t nextSharedImageID;
+};
+
+struct CanvasSharedImage
+{
+  uint32_t id;
+  struct RGBABuffer *buffer;
 };
 
 static void canvasResize (struct Widget *);
@@ -53,6 +73,7 @@ DEFINE_CLASS(Canvas);
 
 /* PROPERTY
  * background :: uint32
+ * preserveContents :: uint32
  */
 
 static struct WidgetTable canvasTable =
@@ -68,6 +89,36 @@ castBack (struct Widget *widget)
   return (struct Canvas *)widget;
 }
 
+static int
+canvasSharedImageKeyFunction (const void *key_v, const void *obj_v)
+{
+  const uint32_t *key = key_v;
+  const struct CanvasSharedImage *obj = obj_v;
+  if (*key == obj -> id)
+    return 0;
+  else if (*key < obj -> id)
+    return -1;
+  else
+    return 1;
+}
+
+static int
+canvasSharedImageComparisonFunction (const void *obj1_v, const void *obj2_v)
+{
+  const struct CanvasSharedImage *obj1 = obj1_v;
+  return canvasSharedImageKeyFunction (&(obj1 -> id), obj2_v);
+}
+
+static void
+canvasSharedImageDestructorFunction (void *obj_v)
+{
+  struct CanvasSharedImage *obj = obj_v;
+  if (obj == NULL)
+    return;
+  rgbabufferDestroy (obj -> buffer);
+  yfree (obj);
+}
+
 static inline const struct Canvas *
 castBackConst (const struct Widget *widget)
 {
@@ -79,10 +130,7 @@ static void
 canvasRender (struct Widget *self_w, struct Renderer *renderer)
 {
   struct Canvas *self = castBack (self_w);
-  int fw, fh, bw, bh;
-  bufferGetSize (self -> front, &fw, &fh);
-  bufferGetSize (self -> back, &bw, &bh); 
-  bufferRender (self -> front, renderer, 0, 0);
+  bufferRender (rgbabufferToBuffer (self -> front), renderer, 0, 0);
 }
 
 static struct Canvas *
@@ -92,16 +140,21 @@ canvasCreate (void)
   struct Rectangle rect;
   objectInitialise (&(self -> widget.o), CLASS(Canvas));
   widgetInitialise (&(self -> widget), &canvasTable);
-  self -> front = rgbabufferToBuffer (rgbabufferCreate ());
-  self -> back  = rgbabufferToBuffer (rgbabufferCreate ());
+  self -> front = rgbabufferCreate ();
+  self -> back  = rgbabufferCreate ();
   self -> resizing = 0;
-  bufferSetSize (self -> front, 64, 64);
-  bufferSetSize (self -> back, 64, 64);
-  self -> painter = bufferGetPainter (self -> back);
+  bufferSetSize (rgbabufferToBuffer (self -> front), 64, 64);
+  bufferSetSize (rgbabufferToBuffer (self -> back), 64, 64);
+  self -> painter = bufferGetPainter (rgbabufferToBuffer (self -> back));
   rect.x = 0;
   rect.y = 0;
   rect.w = 64;
   rect.h = 64;
+  self -> unsynced = regionCreateRectangle (&rect);
+  self -> previous = regionCreate ();
+  self -> sharedImages = indexCreate (canvasSharedImageKeyFunction,
+                                      canvasSharedImageComparisonFunction);
+  self -> nextSharedImageID = 1;
   painterClipTo (self -> painter, &rect);
   painterSetFillColour (self -> painter, 0);
   painterClearRectangle (self -> painter, 0, 0, 64, 64);
@@ -115,8 +168,11 @@ static void
 canvasDestroy (struct Canvas *self)
 {
   painterDestroy (self -> painter);
-  bufferDestroy (self -> front);
-  bufferDestroy (self -> back);
+  rgbabufferDestroy (self -> front);
+  rgbabufferDestroy (self -> back);
+  regionDestroy (self -> unsynced);
+  regionDestroy (self -> previous);
+  indexDestroy (self -> sharedImages, canvasSharedImageDestructorFunction);
   widgetFinalise (canvasToWidget (self));
   objectFinalise (canvasToObject (self));
   yfree (self);
@@ -156,6 +212,15 @@ canvasResize (struct Widget *self_w)
   
 }
 
+/* Record that the given rectangle of the back buffer has been drawn on.
+ */
+static void
+canvasNoteDrawn (struct Canvas *self, int x, int y, int w, int h)
+{
+  struct Rectangle rect = { x, y, w, h };
+  regionUnionRectangle (self -> unsynced, &rect);
+}
+
 /* METHOD
  * savePainterState :: () -> ()
  */
@@ -175,11 +240,12 @@ canvasRestorePainterState (struct Canvas *self)
 }
 
 /* METHOD
- * setBlendMode :: () -> ()
+ * setBlendMode :: (uint32) -> ()
  */
 void
-canvasSetBlendMode (struct Canvas *self)
+canvasSetBlendMode (struct Canvas *self, uint32_t mode)
 {
+  painterSetBlendMode (self -> painter, mode);
 }
 
 /* METHOD
@@ -206,11 +272,13 @@ canvasReset (struct Canvas *self, int32_t *w, int32_t *h)
   int32_t fc = painterGetFillColour (self -> painter);
   self -> resizing = 0;
   painterSetFillColour (self -> painter, safeGetProperty(self, background, 0));
-  bufferSetSize (self -> back, self -> widget.w, self -> widget.h);
+  bufferSetSize (rgbabufferToBuffer (self -> back),
+                 self -> widget.w, self -> widget.h);
   painterDestroy (self -> painter);
-  self -> painter = bufferGetPainter (self -> back);
+  self -> painter = bufferGetPainter (rgbabufferToBuffer (self -> back));
   painterClearRectangle (self -> painter, 0, 0,
                          self -> widget.w, self -> widget.h);
+  canvasNoteDrawn (self, 0, 0, self -> widget.w, self -> widget.h);
   painterSetFillColour (self -> painter, fc);
   *w = self -> widget.w;
   *h = self -> widget.h;
@@ -249,6 +317,7 @@ void
 canvasDrawHLine (struct Canvas *self, int32_t x, int32_t y, int32_t dx)
 {
   painterDrawHLine (self -> painter, x, y, dx);
+  canvasNoteDrawn (self, x, y, dx, 1);
 }
 
 /* METHOD
@@ -276,6 +345,7 @@ void
 canvasDrawVLine (struct Canvas *self, int32_t x, int32_t y, int32_t dy)
 {
   painterDrawVLine (self -> painter, x, y, dy);
+  canvasNoteDrawn (self, x, y, 1, dy);
 }
 
 /* METHOD
@@ -303,6 +373,8 @@ void
 canvasDrawLine (struct Canvas *self, int32_t x, int32_t y, int32_t dx, int32_t dy)
 {
   painterDrawLine (self -> painter, x, y, dx, dy);
+  canvasNoteDrawn (self, MIN (x, x + dx), MIN (y, y + dy),
+                   abs (dx) + 1, abs (dy) + 1);
 }
 
 /* METHOD
@@ -328,18 +400,240 @@ canvasCDrawLines (struct Canvas *self, const struct Tuple *args)
     }
 }
 
+/* the number of argument words taken by each display list operation */
+static const int canvasListArguments[YCO_LAST] =
+{
+  [YCO_SAVE_STATE]      = 0,
+  [YCO_RESTORE_STATE]   = 0,
+  [YCO_SET_BLEND_MODE]  = 1,
+  [YCO_SET_PEN_COLOUR]  = 1,
+  [YCO_SET_FILL_COLOUR] = 1,
+  [YCO_CLEAR_RECTANGLE] = 4,
+  [YCO_DRAW_RECTANGLE]  = 4,
+  [YCO_DRAW_HLINE]      = 3,
+  [YCO_DRAW_VLINE]      = 3,
+  [YCO_DRAW_LINE]       = 4,
+  [YCO_DRAW_ALPHAMAP]   = 4,
+};
+
+static inline uint32_t
+canvasListWord (const char *data)
+{
+  uint32_t word;
+  memcpy (&word, data, sizeof (word));
+  return ntohl (word);
+}
+
+/* Run every operation in a display list (see enum YCanvasOperation),
+ * so that a client can send a whole frame's drawing in one message.
+ * The list stops at the first operation that is unknown or incomplete.
+ */
+/* METHOD
+ * drawList :: (string) -> ()
+ */
+void
+canvasDrawList (struct Canvas *self, uint32_t len, const char *data)
+{
+  const char *end = data + len;
+  int32_t a[4];
+
+  while (end - data >= 4)
+    {
+      uint32_t op = canvasListWord (data);
+      data += 4;
+      if (op >= YCO_LAST || end - data < 4 * canvasListArguments[op])
+        {
+          Y_WARN ("canvas: malformed display list");
+          return;
+        }
+      for (int i = 0; i < canvasListArguments[op]; ++i, data += 4)
+        a[i] = canvasListWord (data);
+
+      switch (op)
+        {
+        case YCO_SAVE_STATE:
+          painterSaveState (self -> painter);
+          break;
+        case YCO_RESTORE_STATE:
+          painterRestoreState (self -> painter);
+          break;
+        case YCO_SET_BLEND_MODE:
+          painterSetBlendMode (self -> painter, a[0]);
+          break;
+        case YCO_SET_PEN_COLOUR:
+          painterSetPenColour (self -> painter, a[0]);
+          break;
+        case YCO_SET_FILL_COLOUR:
+          painterSetFillColour (self -> painter, a[0]);
+          break;
+        case YCO_CLEAR_RECTANGLE:
+          painterClearRectangle (self -> painter, a[0], a[1], a[2], a[3]);
+          canvasNoteDrawn (self, a[0], a[1], a[2], a[3]);
+          break;
+        case YCO_DRAW_RECTANGLE:
+          painterDrawRectangle (self -> painter, a[0], a[1], a[2], a[3]);
+          canvasNoteDrawn (self, a[0], a[1], a[2], a[3]);
+          break;
+        case YCO_DRAW_HLINE:
+          canvasDrawHLine (self, a[0], a[1], a[2]);
+          break;
+        case YCO_DRAW_VLINE:
+          canvasDrawVLine (self, a[0], a[1], a[2]);
+          break;
+        case YCO_DRAW_LINE:
+          canvasDrawLine (self, a[0], a[1], a[2], a[3]);
+          break;
+        case YCO_DRAW_ALPHAMAP:
+          {
+            uint64_t size;
+            if (a[2] < 0 || a[3] < 0)
+              {
+                Y_WARN ("canvas: malformed display list");
+                return;
+              }
+            size = ((uint64_t)a[2] * a[3] + 3) & ~(uint64_t)3;
+            if ((uint64_t)(end - data) < size)
+              {
+                Y_WARN ("canvas: malformed display list");
+                return;
+              }
+            /* the painter only reads the alpha map */
+            painterDrawAlphamap (self -> painter, (uint8_t *)(uintptr_t)data,
+                                 a[0], a[1], a[2], a[3], a[2]);
+            canvasNoteDrawn (self, a[0], a[1], a[2], a[3]);
+            data += size;
+          }
+          break;
+        }
+    }
+}
+
+/* METHOD
+ * attachSharedImage :: (uint32, uint32, uint32) -> (uint32)
+ */
+static struct Tuple *
+canvasCAttachSharedImage (struct Canvas *self, struct Client *from,
+                          uint32_t w, uint32_t h, uint32_t stride)
+{
+  struct CanvasSharedImage *image;
+  struct RGBABuffer *buffer;
+  int fd = clientTakeFileDescriptor (from);
+
+  if (fd == -1)
+    return tupleBuildError (tb_string ("No shared memory was passed"));
+  if (w > INT32_MAX || h > INT32_MAX || stride > INT32_MAX)
+    buffer = NULL;
+  else
+    buffer = rgbabufferCreateFromSharedMemory (fd, w, h, stride);
+  close (fd);
+  if (buffer == NULL)
+    return tupleBuildError (tb_string ("Unusable shared memory"));
+
+  image = ymalloc (sizeof (struct CanvasSharedImage));
+  image -> id = self -> nextSharedImageID++;
+  image -> buffer = buffer;
+  indexAdd (self -> sharedImages, image);
+  return tupleBuild (tb_uint32 (image -> id));
+}
+
+/* METHOD
+ * detachSharedImage :: (uint32) -> ()
+ */
+void
+canvasDetachSharedImage (struct Canvas *self, uint32_t id)
+{
+  canvasSharedImageDestructorFunction (indexRemove (self -> sharedImages,
+                                                    &id));
+}
+
+/* Draw the area of a shared image at (SX, SY) of size W by H onto the
+ * back buffer at (X, Y), using the painter's blend mode.
+ */
+/* METHOD
+ * drawSharedImage :: (uint32, uint32, uint32, uint32, uint32, int32, int32) -> ()
+ */
+void
+canvasDrawSharedImage (struct Canvas *self, uint32_t id,
+                       uint32_t sx, uint32_t sy, uint32_t w, uint32_t h,
+                       int32_t x, int32_t y)
+{
+  struct CanvasSharedImage *image = indexFind (self -> sharedImages, &id);
+  int iw, ih;
+
+  if (image == NULL)
+    return;
+  bufferGetSize (rgbabufferToBuffer (image -> buffer), &iw, &ih);
+  if (sx >= (uint32_t)iw || sy >= (uint32_t)ih)
+    return;
+  w = MIN (w, iw - sx);
+  h = MIN (h, ih - sy);
+
+  bufferDrawOnto (rgbabufferToBuffer (image -> buffer), self -> painter,
+                  sx, sy, x, y, w, h);
+  canvasNoteDrawn (self, x, y, w, h);
+}
+
 /* METHOD
  * swapBuffers :: () -> ()
  */
 void
 canvasSwapBuffers (struct Canvas *self)
 {
-  register struct Buffer *t = self -> front;
-  painterDestroy (self -> painter);
-  self -> front = self -> back;
-  self -> back = t;
-  self -> painter = bufferGetPainter (self -> back);
-  widgetRerender (canvasToWidget (self), NULL);
+  struct Rectangle frontRect = { 0, 0, 0, 0 }, backRect = { 0, 0, 0, 0 };
+  struct Rectangle bounds = { 0, 0, 0, 0 };
+  struct Region *damage;
+  const struct Rectangle *rects;
+  int count;
+
+  bufferGetSize (rgbabufferToBuffer (self -> front),
+                 &frontRect.w, &frontRect.h);
+  bufferGetSize (rgbabufferToBuffer (self -> back),
+                 &backRect.w, &backRect.h);
+  damage = regionDuplicate (self -> unsynced);
+  regionUnion (damage, damage, self -> previous);
+  if (frontRect.w != backRect.w || frontRect.h != backRect.h)
+    {
+      regionUnionRectangle (damage, &frontRect);
+      regionUnionRectangle (damage, &backRect);
+    }
+  bounds.w = MAX (frontRect.w, backRect.w);
+  bounds.h = MAX (frontRect.h, backRect.h);
+  regionIntersectRectangle (damage, &bounds);
+
+  /* only what differs between the buffers needs to be shown again */
+  rects = regionGetRectangles (damage, &count);
+  for (int i = 0; i < count; ++i)
+    widgetRerender (canvasToWidget (self),
+                    rectangleCreate (rects[i].x, rects[i].y,
+                                     rects[i].w, rects[i].h));
+
+  if (safeGetProperty (self, preserveContents, 0))
+    {
+      /* keep drawing on the same back buffer, and bring the front up to
+       * date with it */
+      bufferSetSize (rgbabufferToBuffer (self -> front),
+                     backRect.w, backRect.h);
+      regionIntersectRectangle (damage, &backRect);
+      rgbabufferCopyRegion (self -> front, self -> back, damage);
+      regionClear (self -> unsynced);
+      regionClear (self -> previous);
+    }
+  else
+    {
+      /* the back buffer's old contents are undefined to the client; it
+       * holds the frame before this one, so next time the screen will
+       * change wherever this frame or the next is drawn */
+      struct RGBABuffer *t = self -> front;
+      struct Region *r = self -> previous;
+      painterDestroy (self -> painter);
+      self -> front = self -> back;
+      self -> back = t;
+      self -> painter = bufferGetPainter (rgbabufferToBuffer (self -> back));
+      self -> previous = self -> unsynced;
+      self -> unsynced = r;
+      regionClear (self -> unsynced);
+    }
+  regionDestroy (damage);
 }
 
 /* METHOD
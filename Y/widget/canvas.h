@@ -30,7 +30,7 @@ struct Object * canvasToObject  (struct Canvas *);
 
 void canvasSavePainterState (struct Canvas *);
 void canvasRestorePainterState (struct Canvas *);
-void canvasSetBlendMode (struct Canvas *);
+void canvasSetBlendMode (struct Canvas *, uint32_t);
 void canvasSetPenColour (struct Canvas *, uint32_t);
 void canvasSetFillColour (struct Canvas *, uint32_t);
 void canvasReset (struct Canvas *, int32_t *, int32_t *);
@@ -39,6 +39,11 @@ void canvasDrawRectangles (struct Canvas *);
 void canvasDrawHLine (struct Canvas *, int32_t, int32_t, int32_t);
 void canvasDrawVLine (struct Canvas *, int32_t, int32_t, int32_t);
 void canvasDrawLine (struct Canvas *, int32_t, int32_t, int32_t, int32_t);
+void canvasDrawList (struct Canvas *, uint32_t, const char *);
+void canvasDetachSharedImage (struct Canvas *, uint32_t);
+void canvasDrawSharedImage (struct Canvas *, uint32_t,
+                            uint32_t, uint32_t, uint32_t, uint32_t,
+                            int32_t, int32_t);
 void canvasSwapBuffers (struct Canvas *self);
 void canvasRequestSize (struct Canvas *, int32_t, int32_t);
 
@@ -20,6 +20,7 @@
 #include <Y/widget/widget_p.h>
 
 #include <Y/util/yutil.h>
+#include <Y/util/index.h>
 #include <Y/buffer/painter.h>
 
 #include <Y/object/class_p.h>
@@ -56,6 +57,16 @@ struct ConsoleChar
 
 static struct ConsoleChar consolecharEmpty = { L'\0', -1, -1, 0, 'A' };
 
+/* A character rendered once into a cell-sized alpha map, so that it can
+ * be drawn in any colour without going back to the font.
+ */
+struct ConsoleGlyph
+{
+  wchar_t character;
+  bool blank;
+  uint8_t alpha[];
+};
+
 struct Console
 {
   struct Widget widget;
@@ -67,6 +78,10 @@ struct Console
   int defaultForeground, defaultBackground;
   int charWidth, charHeight, charBase;
   char charset; 
+  struct Font *font;
+  struct Index *glyphs;
+  uint8_t *rowAlpha;
+  size_t rowAlphaSize;
 };
 
 static void consoleResize (struct Widget *);
@@ -103,6 +118,59 @@ castBackConst (const struct Widget *widget)
   return (const struct Console *)widget;
 }
 
+static int
+consoleglyphKeyFunction (const void *key_v, const void *obj_v)
+{
+  const wchar_t *key = key_v;
+  const struct ConsoleGlyph *obj = obj_v;
+  if (*key != obj -> character)
+    return *key < obj -> character ? -1 : 1;
+  return 0;
+}
+
+static int
+consoleglyphComparisonFunction (const void *obj1_v, const void *obj2_v)
+{
+  const struct ConsoleGlyph *obj1 = obj1_v;
+  const struct ConsoleGlyph *obj2 = obj2_v;
+  if (obj1 -> character != obj2 -> character)
+    return obj1 -> character < obj2 -> character ? -1 : 1;
+  return 0;
+}
+
+static void
+consoleglyphDestroy (void *glyph)
+{
+  yfree (glyph);
+}
+
+/* Return the cell-sized alpha map for a character, rendering it the first
+ * time it is needed.  Anything of the glyph outside its cell is lost.
+ */
+static const struct ConsoleGlyph *
+consoleGetGlyph (struct Console *self, wchar_t character)
+{
+  struct ConsoleGlyph *glyph = indexFind (self -> glyphs, &character);
+  if (glyph != NULL)
+    return glyph;
+
+  size_t size = self -> charWidth * self -> charHeight;
+  wchar_t str[2] = { character, L'\0' };
+  glyph = ymalloc (sizeof (struct ConsoleGlyph) + size);
+  glyph -> character = character;
+  memset (glyph -> alpha, 0, size);
+  fontRenderWCStringAlphamap (self -> font, str, glyph -> alpha,
+                              self -> charWidth, self -> charHeight,
+                              self -> charWidth, 0, self -> charBase);
+  glyph -> blank = true;
+  for (size_t i = 0; i < size; ++i)
+    if (glyph -> alpha[i] != 0)
+      glyph -> blank = false;
+
+  indexAdd (self -> glyphs, glyph);
+  return glyph;
+}
+
 static void
 consoleResizeContents (struct Console *self, uint32_t newCols, uint32_t newRows)
 {
@@ -219,7 +287,6 @@ consolePaint (struct Widget *self_w, struct Painter *painter)
 {
   struct Console *self = castBack (self_w);
   struct ConsoleChar *cur;
-  struct Font *font = fontCreate ("Bitstream Vera Sans Mono", "Roman", 11);
   struct Rectangle *painterClip = painterGetClipRectangle (painter);
 
   uint32_t left = painterClip -> x / self -> charWidth;
@@ -237,10 +304,30 @@ consolePaint (struct Widget *self_w, struct Painter *painter)
   if (bottom > self -> rows)
     bottom = self -> rows;
 
+  /* only the margins need painting; keep span from wrapping around */
+  if (right <= left)
+    {
+      right = left;
+      bottom = top;
+    }
+
+  uint32_t span = right - left;
+  size_t rowAlphaSize = span * self -> charWidth * self -> charHeight;
+  if (rowAlphaSize > self -> rowAlphaSize)
+    {
+      yfree (self -> rowAlpha);
+      self -> rowAlpha = ymalloc (rowAlphaSize);
+      self -> rowAlphaSize = rowAlphaSize;
+    }
+
   for (uint32_t j = top; j < bottom; ++j)
     {
+      uint32_t backgrounds[span], foregrounds[span];
+      const struct ConsoleGlyph *glyphs[span];
+      int y = self -> charHeight * j;
+
       cur = self -> contents + self -> cols * j + left;
-      for (uint32_t i = left; i < right; ++i)
+      for (uint32_t i = 0; i < span; ++i)
         {
           int8_t background = cur -> background;
           int8_t foreground = cur -> foreground;
@@ -258,21 +345,74 @@ consolePaint (struct Widget *self_w, struct Painter *painter)
             foreground += 8;
           if (cur -> flags & CCF_BLINK)
             background += 8;
-          painterSetPenColour  (painter, self -> colours[background % 16]);
-          painterSetFillColour (painter, self -> colours[background % 16]);
-          painterDrawRectangle (painter, self -> charWidth * i,
-                                self -> charHeight * j,
-                                self -> charWidth, self -> charHeight);
+          backgrounds[i] = self -> colours[background % 16];
+          foregrounds[i] = self -> colours[foreground % 16];
+          glyphs[i] = NULL;
           if (cur -> character != L'\0')
             {
-              wchar_t str[2] = { cur -> character, L'\0' };
-              painterSetPenColour (painter, self -> colours[foreground % 16]);
-              fontRenderWCString (font, painter, str,
-                                  self -> charWidth * i,
-                                  self -> charHeight * j + self -> charBase);
+              glyphs[i] = consoleGetGlyph (self, cur -> character);
+              if (glyphs[i] -> blank)
+                glyphs[i] = NULL;
             }
           ++cur;
         }
+
+      /* fill each run of cells with the same background at once */
+      for (uint32_t i = 0; i < span; )
+        {
+          uint32_t end = i + 1;
+          while (end < span && backgrounds[end] == backgrounds[i])
+            ++end;
+          painterSetPenColour  (painter, backgrounds[i]);
+          painterSetFillColour (painter, backgrounds[i]);
+          painterDrawRectangle (painter, self -> charWidth * (left + i), y,
+                                self -> charWidth * (end - i),
+                                self -> charHeight);
+          i = end;
+        }
+
+      /* then draw each run of characters in the same colour as one
+       * alpha map; blank cells go along with whichever run they are in */
+      for (uint32_t i = 0; i < span; )
+        {
+          if (glyphs[i] == NULL)
+            {
+              ++i;
+              continue;
+            }
+
+          uint32_t end = i + 1;
+          for (uint32_t k = i + 1; k < span; ++k)
+            {
+              if (glyphs[k] == NULL)
+                continue;
+              if (foregrounds[k] != foregrounds[i])
+                break;
+              end = k + 1;
+            }
+
+          int stride = self -> charWidth * (end - i);
+          for (uint32_t k = i; k < end; ++k)
+            {
+              uint8_t *dst = self -> rowAlpha + self -> charWidth * (k - i);
+              for (int row = 0; row < self -> charHeight; ++row)
+                {
+                  if (glyphs[k] == NULL)
+                    memset (dst, 0, self -> charWidth);
+                  else
+                    memcpy (dst,
+                            glyphs[k] -> alpha + row * self -> charWidth,
+                            self -> charWidth);
+                  dst += stride;
+                }
+            }
+
+          painterSetPenColour (painter, foregrounds[i]);
+          painterDrawAlphamap (painter, self -> rowAlpha,
+                               self -> charWidth * (left + i), y,
+                               stride, self -> charHeight, stride);
+          i = end;
+        }
     } 
 
   if (self -> cols * self -> charWidth < (uint32_t)self -> widget.w)
@@ -293,7 +433,6 @@ consolePaint (struct Widget *self_w, struct Painter *painter)
                             self -> widget.h - self -> rows * self -> charHeight);
     }
 
-  fontDestroy (font);
 }
 
 int
@@ -339,6 +478,11 @@ consoleCreate (void)
   self -> charWidth = 7;
   self -> charHeight = 12;
   self -> charBase = 9;
+  self -> font = fontCreate ("Bitstream Vera Sans Mono", "Roman", 11);
+  self -> glyphs = indexCreate (consoleglyphKeyFunction,
+                                consoleglyphComparisonFunction);
+  self -> rowAlpha = NULL;
+  self -> rowAlphaSize = 0;
   consoleResizeContents (self, 80, 24);
   return self;
 }
@@ -351,6 +495,10 @@ consoleDestroy (struct Console *self)
 {
   widgetFinalise (consoleToWidget (self));
   objectFinalise (consoleToObject (self));
+  indexDestroy (self -> glyphs, consoleglyphDestroy);
+  fontDestroy (self -> font);
+  yfree (self -> rowAlpha);
+  yfree (self -> contents);
   yfree (self);
 }
 
@@ -36,6 +36,8 @@
 #include <Y/text/font.h>
 
 #include <Y/util/zorder.h>
+#include <Y/util/llist.h>
+#include <Y/util/region.h>
 
 #include <stdio.h>
 
@@ -53,6 +55,7 @@ static int desktopPointerMotion (struct Widget *, int32_t, int32_t, int32_t, int
 static int desktopPointerButton (struct Widget *, int32_t, int32_t, uint32_t, bool);
                                 
 static int desktopKeyboardRaw   (struct Widget *, enum YKeyCode, bool, uint32_t);
+static void desktopPrepareRender (struct Widget *);
 static void desktopRender (struct Widget *, struct Renderer *);
 static void desktopResize (struct Widget *);
 
@@ -64,6 +67,7 @@ static struct WidgetTable desktopTable =
   pointerMotion: desktopPointerMotion,
   pointerButton: desktopPointerButton,
   keyboardRaw:   desktopKeyboardRaw,
+  prepareRender: desktopPrepareRender,
   render:        desktopRender,
   resize:        desktopResize
 };
@@ -259,42 +263,126 @@ desktopKeyboardRaw (struct Widget *self_w, enum YKeyCode code,
 }
 
 void
-desktopRender (struct Widget *self_w, struct Renderer *renderer)
+desktopPrepareRender (struct Widget *self_w)
 {
   struct Desktop *self = castBack (self_w);
   struct ZOrderIterator *iter;
 
-  /* This should be in paint?
-   */
-  rendererDrawFilledRectangle (renderer, 0xFF404080,
-                               self -> widget.x, self -> widget.y,
-                               self -> widget.w, self -> widget.h);
+  iter = zorderGetBottomIterator (self -> windows);
+  while (zorderiteratorHasValue (iter))
+    {
+      widgetPrepareRender (zorderiteratorGet (iter));
+      zorderiteratorMoveUp (iter);
+    }
+  zorderiteratorDestroy (iter);
+}
 
-#if ARCH_TREE_DEVELOPMENT
-  int32_t versionWidth, versionHeight;
-  bufferGetSize (self->versionText, &versionWidth, &versionHeight);
-  bufferRender (self->versionText, renderer, self->widget.w - versionWidth,
-                self->widget.h - versionHeight);
-#endif
+/* the parts of a window left exposed by the windows above it */
+struct DesktopExposure
+{
+  struct Widget *widget;
+  struct Region *exposed;
+};
 
-  /* render the windows */
-  iter = zorderGetBottomIterator (self -> windows);
+void
+desktopRender (struct Widget *self_w, struct Renderer *renderer)
+{
+  struct Desktop *self = castBack (self_w);
+  struct ZOrderIterator *iter;
+  struct Region *uncovered;
+  struct llist *visible = new_llist ();
+  struct llist_node *node;
+  const struct Rectangle *rects;
+  struct Rectangle clip;
+  int count;
+
+  if (!rendererGetClip (renderer, &clip))
+    {
+      clip.x = self -> widget.x;
+      clip.y = self -> widget.y;
+      clip.w = self -> widget.w;
+      clip.h = self -> widget.h;
+    }
+  uncovered = regionCreateRectangle (&clip);
 
-  while (zorderiteratorHasValue (iter))
+  /* Work out what can be seen of each window, from the top down.
+   * Opaque windows hide whatever is underneath them, so any window
+   * with nothing left exposed is not rendered at all.
+   */
+  iter = zorderGetTopIterator (self -> windows);
+  while (zorderiteratorHasValue (iter) && !regionIsEmpty (uncovered))
     {
       struct Widget *widget = zorderiteratorGet (iter);
       struct Rectangle *widgetRectangle = widgetGetRectangle (widget);
-      if (rendererEnter (renderer, widgetRectangle,
-                         widgetRectangle->x, widgetRectangle->y))
+      struct Region *exposed = regionDuplicate (uncovered);
+      regionIntersectRectangle (exposed, widgetRectangle);
+      if (!regionIsEmpty (exposed))
         {
-          widgetRender (widget, renderer);
-          rendererLeave (renderer);
+          struct DesktopExposure *exposure = ymalloc (sizeof (struct DesktopExposure));
+          exposure -> widget = widget;
+          exposure -> exposed = exposed;
+          /* added at the head, so the list runs from the bottom up */
+          llist_add_head (visible, exposure);
+          struct Region *opaque = widgetGetOpaqueRegion (widget);
+          if (opaque != NULL)
+            {
+              regionTranslate (opaque, widgetRectangle -> x, widgetRectangle -> y);
+              regionSubtract (uncovered, uncovered, opaque);
+              regionDestroy (opaque);
+            }
         }
+      else
+        regionDestroy (exposed);
       rectangleDestroy (widgetRectangle);
-      zorderiteratorMoveUp (iter);
+      zorderiteratorMoveDown (iter);
     }
   zorderiteratorDestroy (iter);
 
+  /* This should be in paint?
+   */
+  rects = regionGetRectangles (uncovered, &count);
+  for (int i = 0; i < count; ++i)
+    {
+      if (rendererEnter (renderer, rects + i, 0, 0))
+        {
+          rendererDrawFilledRectangle (renderer, 0xFF404080,
+                                       self -> widget.x, self -> widget.y,
+                                       self -> widget.w, self -> widget.h);
+#if ARCH_TREE_DEVELOPMENT
+          int32_t versionWidth, versionHeight;
+          bufferGetSize (self->versionText, &versionWidth, &versionHeight);
+          bufferRender (self->versionText, renderer,
+                        self->widget.w - versionWidth,
+                        self->widget.h - versionHeight);
+#endif
+          rendererLeave (renderer);
+        }
+    }
+  regionDestroy (uncovered);
+
+  /* render the windows, each clipped to its exposed parts */
+  for (node = llist_head (visible); node != NULL; node = llist_node_next (node))
+    {
+      struct DesktopExposure *exposure = llist_node_data (node);
+      struct Rectangle *widgetRectangle = widgetGetRectangle (exposure -> widget);
+      rects = regionGetRectangles (exposure -> exposed, &count);
+      for (int i = 0; i < count; ++i)
+        {
+          if (rendererEnter (renderer, rects + i, 0, 0))
+            {
+              if (rendererEnter (renderer, widgetRectangle,
+                                 widgetRectangle->x, widgetRectangle->y))
+                {
+                  widgetRender (exposure -> widget, renderer);
+                  rendererLeave (renderer);
+                }
+              rendererLeave (renderer);
+            }
+        }
+      rectangleDestroy (widgetRectangle);
+      regionDestroy (exposure -> exposed);
+    }
+  llist_destroy (visible, yfree);
 }
 
 void
@@ -157,6 +157,15 @@ widgetContainsPoint (const struct Widget *self, int32_t x, int32_t y)
     return false;
 }
 
+struct Region *
+widgetGetOpaqueRegion (struct Widget *self)
+{
+  if (self != NULL && self -> tab -> getOpaqueRegion != NULL)
+    return self -> tab -> getOpaqueRegion (self);
+  else
+    return NULL;
+}
+
 struct Window *
 widgetGetWindow (struct Widget *self)
 {
@@ -231,6 +240,13 @@ widgetUnpack (struct Widget *self, struct Widget *w)
 }
 
 
+void
+widgetPrepareRender (struct Widget *self)
+{
+  if (self != NULL && self -> tab -> prepareRender != NULL)
+    self -> tab -> prepareRender (self);
+}
+
 void
 widgetRender (struct Widget *self, struct Renderer *renderer)
 {
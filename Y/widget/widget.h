@@ -38,6 +38,7 @@ enum WidgetState
 #include <Y/y.h>
 #include <Y/const.h>
 #include <Y/util/rectangle.h>
+#include <Y/util/region.h>
 #include <Y/screen/renderer.h>
 #include <Y/buffer/painter.h>
 #include <Y/input/pointer.h>
@@ -60,6 +61,11 @@ void   widgetGetConstraints(const struct Widget *, int32_t *, int32_t *,
 enum WidgetState
        widgetGetState      (const struct Widget *);
 bool   widgetContainsPoint (const struct Widget *, int32_t x, int32_t y); 
+/* a new region, in the widget's own coordinates, of the pixels that
+ * rendering the widget covers completely, hiding anything underneath;
+ * NULL if there are none */
+struct Region *
+       widgetGetOpaqueRegion (struct Widget *);
 
 struct Window *
        widgetGetWindow     (struct Widget *);
@@ -71,6 +77,7 @@ void   widgetReconfigure   (struct Widget *);
 void   widgetSetContainer  (struct Widget *, struct Widget *);
 void   widgetUnpack        (struct Widget *, struct Widget *);
 
+void   widgetPrepareRender (struct Widget *);
 void   widgetRender        (struct Widget *, struct Renderer *);
 void   widgetPaint         (struct Widget *, struct Painter *);
 void   widgetRepaint       (struct Widget *, struct Rectangle *);
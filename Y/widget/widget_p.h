@@ -27,11 +27,15 @@
 struct WidgetTable
 {
   bool            (*containsPoint)(const struct Widget *, int32_t, int32_t);
+  struct Region * (*getOpaqueRegion)(struct Widget *);
 
   struct Window * (*getWindow)    (struct Widget *);
 
   void            (*unpack)       (struct Widget *, struct Widget *);
 
+  /* prepareRender may change the widget, e.g. to repaint its buffers;
+   * render must only read it, as it may run on several threads */
+  void            (*prepareRender)(struct Widget *);
   void            (*render)       (struct Widget *, struct Renderer *);
   void            (*paint)        (struct Widget *, struct Painter *);
   void            (*repaint)      (struct Widget *, struct Rectangle *);
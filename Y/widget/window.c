@@ -20,7 +20,7 @@
 #include <Y/widget/widget_p.h>
 
 #include <Y/util/yutil.h>
-#include <Y/util/llist.h>
+#include <Y/util/region.h>
 #include <Y/buffer/buffer.h>
 #include <Y/buffer/rgbabuffer.h>
 #include <Y/buffer/painter.h>
@@ -47,7 +47,7 @@ struct Window
   int pointerInChild : 1;
   int storeX, storeY, storeW, storeH;
   int dragging, dragX, dragY;
-  struct llist *invalidRectangles;
+  struct Region *invalidRegion;
 };
 
 enum WindowAnchor
@@ -65,6 +65,8 @@ static void windowPointerEnter (struct Widget *, int32_t x, int32_t y);
 static void windowPointerLeave (struct Widget *);
 static int windowKeyboardRaw   (struct Widget *, enum YKeyCode, bool, uint32_t);
 static struct Window *windowGetWindow (struct Widget *);
+static struct Region *windowGetOpaqueRegion (struct Widget *);
+static void windowPrepareRender (struct Widget *);
 static void windowRender (struct Widget *, struct Renderer *);
 static void windowUnpack (struct Widget *, struct Widget *);
 static void windowPaint (struct Widget *, struct Painter *);
@@ -86,6 +88,7 @@ DEFINE_CLASS(Window);
 
 static struct WidgetTable windowTable =
 {
+  getOpaqueRegion: windowGetOpaqueRegion,
   getWindow:     windowGetWindow,
   unpack:        windowUnpack,
   pointerMotion: windowPointerMotion,
@@ -93,6 +96,7 @@ static struct WidgetTable windowTable =
   pointerEnter:  windowPointerEnter,
   pointerLeave:  windowPointerLeave,
   keyboardRaw:   windowKeyboardRaw,
+  prepareRender: windowPrepareRender,
   render:        windowRender,
   paint:         windowPaint,
   repaint:       windowRepaint,
@@ -133,6 +137,34 @@ windowGetWindow (struct Widget *self_w)
   return self;
 }
 
+/* whatever the theme promises to paint opaquely, plus anything the
+ * buffer is known to hold opaque pixels for, plus whatever the child
+ * covers on top of it */
+static struct Region *
+windowGetOpaqueRegion (struct Widget *self_w)
+{
+  struct Window *self = castBack (self_w);
+  struct Region *opaque = themeWindowGetOpaqueRegion (self);
+  struct Region *painted = rgbabufferGetOpaqueRegion ((struct RGBABuffer *)self->buffer);
+  struct Region *child = widgetGetOpaqueRegion (self -> child);
+
+  if (opaque == NULL)
+    opaque = regionCreate ();
+  regionUnion (opaque, opaque, painted);
+  regionDestroy (painted);
+
+  if (child != NULL)
+    {
+      struct Rectangle childRect = { 0, 0, self -> child -> w, self -> child -> h };
+      regionIntersectRectangle (child, &childRect);
+      regionTranslate (child, self -> child -> x, self -> child -> y);
+      regionUnion (opaque, opaque, child);
+      regionDestroy (child);
+    }
+
+  return opaque;
+}
+
 static void
 windowPaint (struct Widget *self_w, struct Painter *painter)
 {
@@ -144,8 +176,8 @@ static void
 windowRepaint (struct Widget *self_w, struct Rectangle *rect)
 {
   struct Window *self = castBack (self_w);
-  llist_add_tail (self -> invalidRectangles, rect);
-  widgetRerender (windowToWidget (self), rectangleDuplicate (rect));
+  regionUnionRectangle (self -> invalidRegion, rect);
+  widgetRerender (windowToWidget (self), rect);
 }
 
 /* PROPERTY HOOK
@@ -173,7 +205,7 @@ windowCreate (void)
   self -> sizeState = WINDOW_SIZE_NORMAL;
   self -> pointerInChild = 0;
   self -> dragging = 0;
-  self -> invalidRectangles = new_llist ();
+  self -> invalidRegion = regionCreate ();
   self -> buffer = rgbabufferToBuffer (rgbabufferCreate ());
   bufferSetSize (self->buffer, self->widget.w, self->widget.h);
 
@@ -195,7 +227,7 @@ windowDestroy (struct Window *self)
   wmUnregisterWindow (self);
   if (self -> child != NULL)
     widgetSetContainer (self -> child, NULL);
-  llist_destroy (self -> invalidRectangles, rectangleDestroy);
+  regionDestroy (self -> invalidRegion);
   bufferDestroy (self->buffer);
   widgetFinalise (windowToWidget (self));
   objectFinalise (windowToObject (self));
@@ -506,24 +538,29 @@ windowShow (struct Window *self)
 }
 
 void
-windowRender (struct Widget *self_w, struct Renderer *renderer)
+windowPrepareRender (struct Widget *self_w)
 {
   struct Window *self = castBack (self_w);
-  struct llist_node *node;
-  rectanglelistUnionOverlaps (self -> invalidRectangles);
-  node = llist_head (self->invalidRectangles);
-  while (node != NULL)
+  const struct Rectangle *rects;
+  int count;
+
+  rects = regionGetRectangles (self -> invalidRegion, &count);
+  for (int i = 0; i < count; ++i)
     {
-      struct llist_node *next_node = llist_node_next (node);
-      struct Rectangle *rect = llist_node_data (node);
       struct Painter *painter = bufferGetPainter (self->buffer);
-      painterClipTo (painter, rect);
+      painterClipTo (painter, rects + i);
       windowPaint (self_w, painter);
       painterDestroy (painter);
-      llist_delete_node (node);
-      rectangleDestroy (rect);
-      node = next_node;
     }
+  regionClear (self -> invalidRegion);
+
+  widgetPrepareRender (self -> child);
+}
+
+void
+windowRender (struct Widget *self_w, struct Renderer *renderer)
+{
+  struct Window *self = castBack (self_w);
 
   bufferRender (self->buffer, renderer, 0, 0);
 
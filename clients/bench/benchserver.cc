@@ -0,0 +1,146 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include "benchserver.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+double
+benchNow ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+BenchServer::BenchServer (const string &binary, const string &videoArgs,
+                          const string &fontpath)
+{
+  char dirTemplate[] = "/tmp/ybench.XXXXXX";
+  if (mkdtemp (dirTemplate) == NULL)
+    {
+      perror ("ybench: mkdtemp");
+      exit (EXIT_FAILURE);
+    }
+  dir = dirTemplate;
+  config = dir + "/server.conf";
+  socket = dir + "/socket";
+
+  std::ofstream conf (config.c_str ());
+  conf << "modules:" << endl
+       << "        theme/basic" << endl
+       << "        wm/default" << endl
+       << "        driver/video/null " << videoArgs << endl
+       << "        driver/ipc/unix socket=" << socket << endl
+       << endl
+       << "keymap:" << endl
+       << "        layout gb" << endl
+       << endl
+       << "fontpath:" << endl
+       << "        " << fontpath << " recursive" << endl;
+  conf.close ();
+
+  pid = fork ();
+  if (pid < 0)
+    {
+      perror ("ybench: fork");
+      exit (EXIT_FAILURE);
+    }
+  if (pid == 0)
+    {
+      execl (binary.c_str (), binary.c_str (),
+             "--no-detach", "--config", config.c_str (), (char *)NULL);
+      perror ("ybench: exec server");
+      _exit (EXIT_FAILURE);
+    }
+
+  /* wait for the server to start listening */
+  double deadline = benchNow () + 10;
+  struct stat st;
+  while (stat (socket.c_str (), &st) != 0)
+    {
+      int status;
+      if (waitpid (pid, &status, WNOHANG) == pid)
+        {
+          cerr << "ybench: the server exited during startup" << endl;
+          exit (EXIT_FAILURE);
+        }
+      if (benchNow () > deadline)
+        {
+          cerr << "ybench: timed out waiting for " << socket << endl;
+          kill (pid, SIGTERM);
+          exit (EXIT_FAILURE);
+        }
+      usleep (10000);
+    }
+
+  setenv ("YDISPLAY", ("unix:" + socket).c_str (), 1);
+}
+
+BenchServer::~BenchServer ()
+{
+  kill (pid, SIGTERM);
+  waitpid (pid, NULL, 0);
+  unlink (socket.c_str ());
+  unlink (config.c_str ());
+  rmdir (dir.c_str ());
+}
+
+double
+BenchServer::cpuTime () const
+{
+  char path[64];
+  snprintf (path, sizeof (path), "/proc/%d/stat", (int)pid);
+  std::ifstream in (path);
+  string stat;
+  std::getline (in, stat);
+
+  /* the command name may contain spaces, so start after it */
+  string::size_type end = stat.rfind (')');
+  if (end == string::npos)
+    return 0;
+  std::istringstream fields (stat.substr (end + 2));
+  string field;
+  unsigned long utime = 0, stime = 0;
+  /* utime and stime are the 14th and 15th fields; the 3rd is first here */
+  for (int i = 3; i <= 15 && fields >> field; ++i)
+    {
+      if (i == 14)
+        utime = strtoul (field.c_str (), NULL, 10);
+      else if (i == 15)
+        stime = strtoul (field.c_str (), NULL, 10);
+    }
+  return (double)(utime + stime) / sysconf (_SC_CLK_TCK);
+}
+
+/* arch-tag: 9e4a71c3-28d5-4f60-b1a7-5c3d06e8f2b4
+ */
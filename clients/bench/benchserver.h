@@ -0,0 +1,55 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#ifndef Y_BENCH_BENCHSERVER_H
+#define Y_BENCH_BENCHSERVER_H
+
+#include <string>
+#include <sys/types.h>
+
+/** Monotonic time in seconds */
+double benchNow ();
+
+/** \brief A private server for benchmarking
+ *
+ * Runs the server on its own UNIX socket in a temporary directory,
+ * with the null video driver, and points YDISPLAY at it.  The server
+ * is stopped and the directory removed when this is destroyed.
+ */
+class BenchServer
+{
+public:
+  /* videoArgs are passed to the null video driver, e.g. "res=800x600" */
+  BenchServer (const std::string &binary, const std::string &videoArgs,
+               const std::string &fontpath);
+  ~BenchServer ();
+
+  /** CPU time the server has used so far, in seconds */
+  double cpuTime () const;
+
+private:
+  pid_t pid;
+  std::string dir;
+  std::string config;
+  std::string socket;
+};
+
+#endif
+
+/* arch-tag: 0b6e2d47-3f18-4c9a-a5d2-e81c7f40b963
+ */
@@ -0,0 +1,408 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* Server message throughput benchmark.
+ *
+ * Starts a private server on its own UNIX socket with the null video
+ * driver, then forks a fleet of synthetic clients that each run a
+ * closed loop of requests.  Every request is followed by a round trip
+ * to the server, so its latency covers the whole request being
+ * decoded, despatched and answered.  At the end the throughput, the
+ * latency percentiles and the CPU time the server used are reported.
+ */
+
+#include <Y/c++.h>
+#include "benchserver.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+enum Operation
+{
+  OP_CANVAS,
+  OP_PROPERTY,
+  OP_SIGNAL,
+  OP_REPLY,
+  OP_COUNT
+};
+
+static const char *operationNames[OP_COUNT] =
+  { "canvas", "property", "signal", "reply" };
+
+/* What each client sends back to the parent for every request */
+struct Sample
+{
+  uint32_t op;
+  uint32_t usec;
+};
+
+struct Options
+{
+  int clients;
+  int seconds;
+  int weights[OP_COUNT];
+  string server;
+  string fontpath;
+  string resolution;
+};
+
+/* A button that can also drop its subscription to a signal */
+class BenchButton : public Y::Button
+{
+public:
+  BenchButton (Y::Connection *y, const string &label)
+    : Y::Button (y, label) {}
+
+  void unsubscribeSignal (const string &name)
+  {
+    invokeMethod ("unsubscribeSignal", name, false);
+  }
+};
+
+/* A label used to wait for the server to catch up */
+class BenchLabel : public Y::Label
+{
+public:
+  BenchLabel (Y::Connection *y, const string &text)
+    : Y::Label (y, text) {}
+
+  /* the reply comes back after everything sent before it; get ()
+   * would answer from the cache without asking the server */
+  void sync ()
+  {
+    Y::Reply *r = text.getReply ();
+    r -> tuple ();
+    delete r;
+  }
+};
+
+static void
+usage (const char *argv0)
+{
+  cerr << "Usage: " << argv0 << " [options]" << endl
+       << "  --clients N       number of concurrent clients (default 8)" << endl
+       << "  --seconds S       length of the measurement (default 10)" << endl
+       << "  --mix SPEC        relative weights of the requests, e.g." << endl
+       << "                    canvas=1,property=1,signal=1,reply=1" << endl
+       << "  --server PATH     server binary (default " BINDIR "/Y)" << endl
+       << "  --fontpath DIR    font directory for the server" << endl
+       << "  --res WxH         size of the null display (default 800x600)" << endl
+       << "The server loads its modules from where they are installed." << endl;
+  exit (EXIT_FAILURE);
+}
+
+static bool
+parseMix (const string &spec, int *weights)
+{
+  for (int i = 0; i < OP_COUNT; ++i)
+    weights[i] = 0;
+
+  std::istringstream in (spec);
+  string item;
+  while (std::getline (in, item, ','))
+    {
+      string::size_type eq = item.find ('=');
+      string name = item.substr (0, eq);
+      int weight = eq == string::npos ? 1 : atoi (item.c_str () + eq + 1);
+      int i;
+      for (i = 0; i < OP_COUNT; ++i)
+        if (name == operationNames[i])
+          break;
+      if (i == OP_COUNT || weight < 0)
+        {
+          cerr << "ybench: bad mix entry '" << item << "'" << endl;
+          return false;
+        }
+      weights[i] = weight;
+    }
+
+  for (int i = 0; i < OP_COUNT; ++i)
+    if (weights[i] > 0)
+      return true;
+  cerr << "ybench: the mix is empty" << endl;
+  return false;
+}
+
+/* The body of each synthetic client: build a window, report ready, wait
+ * for the start signal, then issue requests until the time is up and
+ * send the samples to the parent.
+ */
+static void
+runClient (const Options &options, int index, int ready, int start, int out)
+{
+  Y::Connection y;
+
+  Y::Window *window = new Y::Window (&y, "ybench");
+  Y::GridLayout *grid = new Y::GridLayout (&y);
+  window -> setChild (grid);
+  Y::Canvas *canvas = new Y::Canvas (&y);
+  canvas -> requestSize (64, 64);
+  grid -> addWidget (canvas, 0, 0, 2, 1);
+  BenchLabel *label = new BenchLabel (&y, "ybench");
+  grid -> addWidget (label, 0, 1);
+  BenchButton *button = new BenchButton (&y, "ybench");
+  grid -> addWidget (button, 1, 1);
+  window -> show ();
+
+  /* make sure everything above has been handled before starting */
+  label -> sync ();
+
+  char c = 0;
+  if (write (ready, &c, 1) != 1 || read (start, &c, 1) < 0)
+    _exit (EXIT_FAILURE);
+
+  int total = 0;
+  for (int i = 0; i < OP_COUNT; ++i)
+    total += options.weights[i];
+
+  unsigned int seed = index * 7919 + 1;
+  vector<Sample> samples;
+  double deadline = benchNow () + options.seconds;
+  double t;
+
+  while ((t = benchNow ()) < deadline)
+    {
+      int r = rand_r (&seed) % total;
+      int op = 0;
+      while (r >= options.weights[op])
+        r -= options.weights[op++];
+
+      switch (op)
+        {
+        case OP_CANVAS:
+          canvas -> setFillColour (0xFF000000 | rand_r (&seed));
+          canvas -> drawRectangle (rand_r (&seed) % 48, rand_r (&seed) % 48,
+                                   16, 16);
+          canvas -> flush ();
+          break;
+        case OP_PROPERTY:
+          {
+            char text[32];
+            snprintf (text, sizeof (text), "%u", rand_r (&seed));
+            label -> text.set (text);
+          }
+          break;
+        case OP_SIGNAL:
+          button -> subscribeSignal ("clicked");
+          button -> unsubscribeSignal ("clicked");
+          break;
+        case OP_REPLY:
+          break;
+        }
+
+      label -> sync ();
+
+      Sample s;
+      s.op = op;
+      s.usec = (uint32_t)((benchNow () - t) * 1e6);
+      samples.push_back (s);
+    }
+
+  size_t len = samples.size () * sizeof (Sample);
+  const char *p = reinterpret_cast<const char *>(&samples[0]);
+  while (len > 0)
+    {
+      ssize_t w = write (out, p, len);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        _exit (EXIT_FAILURE);
+      p += w;
+      len -= w;
+    }
+
+  _exit (EXIT_SUCCESS);
+}
+
+static uint32_t
+percentile (const vector<uint32_t> &sorted, double p)
+{
+  if (sorted.empty ())
+    return 0;
+  size_t i = (size_t)(p * (sorted.size () - 1) + 0.5);
+  return sorted[i];
+}
+
+static void
+report (const char *name, vector<uint32_t> &latencies, double seconds)
+{
+  std::sort (latencies.begin (), latencies.end ());
+  char line[128];
+  snprintf (line, sizeof (line), "%-10s %10zu %12.0f %10u %10u",
+            name, latencies.size (), latencies.size () / seconds,
+            percentile (latencies, 0.50), percentile (latencies, 0.99));
+  cout << line << endl;
+}
+
+int
+main (int argc, char **argv)
+{
+  Options options;
+  options.clients = 8;
+  options.seconds = 10;
+  for (int i = 0; i < OP_COUNT; ++i)
+    options.weights[i] = 1;
+  options.server = BINDIR "/Y";
+  options.fontpath = "/usr/share/fonts";
+  options.resolution = "800x600";
+
+  for (int i = 1; i < argc; ++i)
+    {
+      string arg = argv[i];
+      if (i + 1 >= argc)
+        usage (argv[0]);
+      if (arg == "--clients")
+        options.clients = atoi (argv[++i]);
+      else if (arg == "--seconds")
+        options.seconds = atoi (argv[++i]);
+      else if (arg == "--mix")
+        {
+          if (!parseMix (argv[++i], options.weights))
+            usage (argv[0]);
+        }
+      else if (arg == "--server")
+        options.server = argv[++i];
+      else if (arg == "--fontpath")
+        options.fontpath = argv[++i];
+      else if (arg == "--res")
+        options.resolution = argv[++i];
+      else
+        usage (argv[0]);
+    }
+  if (options.clients <= 0 || options.seconds <= 0)
+    usage (argv[0]);
+
+  std::ostringstream videoArgs;
+  videoArgs << "res=" << options.resolution;
+  BenchServer server (options.server, videoArgs.str (), options.fontpath);
+
+  int readyPipe[2], startPipe[2];
+  if (pipe (readyPipe) != 0 || pipe (startPipe) != 0)
+    {
+      perror ("ybench: pipe");
+      return EXIT_FAILURE;
+    }
+
+  vector<pid_t> children;
+  vector<int> results;
+  for (int i = 0; i < options.clients; ++i)
+    {
+      int out[2];
+      if (pipe (out) != 0)
+        {
+          perror ("ybench: pipe");
+          break;
+        }
+      pid_t pid = fork ();
+      if (pid == 0)
+        {
+          close (readyPipe[0]);
+          close (startPipe[1]);
+          close (out[0]);
+          for (size_t j = 0; j < results.size (); ++j)
+            close (results[j]);
+          runClient (options, i, readyPipe[1], startPipe[0], out[1]);
+        }
+      close (out[1]);
+      if (pid < 0)
+        {
+          perror ("ybench: fork");
+          close (out[0]);
+          break;
+        }
+      children.push_back (pid);
+      results.push_back (out[0]);
+    }
+  close (readyPipe[1]);
+  close (startPipe[0]);
+
+  /* wait until every client is connected and set up */
+  size_t ready = 0;
+  char c;
+  while (ready < children.size () && read (readyPipe[0], &c, 1) == 1)
+    ++ready;
+  if (ready < children.size ())
+    cerr << "ybench: only " << ready << " of " << children.size ()
+         << " clients started" << endl;
+
+  double cpuStart = server.cpuTime ();
+  double wallStart = benchNow ();
+  close (startPipe[1]);
+
+  /* the clients stop on their own once their time is up */
+  struct timespec ts = { options.seconds, 0 };
+  while (nanosleep (&ts, &ts) != 0 && errno == EINTR)
+    ;
+  double cpu = server.cpuTime () - cpuStart;
+  double wall = benchNow () - wallStart;
+
+  vector<uint32_t> all, byOp[OP_COUNT];
+  for (size_t i = 0; i < results.size (); ++i)
+    {
+      Sample s;
+      while (read (results[i], &s, sizeof (s)) == sizeof (s))
+        {
+          if (s.op >= OP_COUNT)
+            continue;
+          all.push_back (s.usec);
+          byOp[s.op].push_back (s.usec);
+        }
+      close (results[i]);
+    }
+
+  for (size_t i = 0; i < children.size (); ++i)
+    waitpid (children[i], NULL, 0);
+
+  cout << options.clients << " clients, " << wall << " s" << endl;
+  cout << "request      requests     per sec    p50 us    p99 us" << endl;
+  for (int i = 0; i < OP_COUNT; ++i)
+    if (!byOp[i].empty ())
+      report (operationNames[i], byOp[i], wall);
+  report ("total", all, wall);
+
+  char line[128];
+  snprintf (line, sizeof (line),
+            "server cpu %.2f s (%.0f%% of one core), %.1f us per request",
+            cpu, 100 * cpu / wall,
+            all.empty () ? 0.0 : cpu * 1e6 / all.size ());
+  cout << line << endl;
+
+  return all.empty () ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* arch-tag: 7d13b9e2-54a0-4f8c-b6e1-c28a9f04d357
+ */
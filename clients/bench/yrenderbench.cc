@@ -0,0 +1,423 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* Render benchmark.
+ *
+ * Starts a private server with the null video driver and plays a set
+ * of scripted window layouts on it.  Each step of a script changes
+ * something and then asks the driver to render the damage at once, so
+ * the frame times reported by the viewport measure only viewportUpdate
+ * and screenRender.  The checksum of every frame is folded into one per
+ * layout, which can be recorded and later checked to catch changes in
+ * what is drawn.
+ */
+
+#include <Y/c++.h>
+#include "benchserver.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+/* The null driver's viewport, reached through the Screen class */
+class NullViewport
+{
+public:
+  NullViewport (Y::Connection *y_);
+
+  /* render the damage now; returns the checksum of the frame */
+  uint32_t update ();
+  void resetStatistics ();
+  /* mean and worst frame times in microseconds */
+  void statistics (uint32_t &frames, uint32_t &mean, uint32_t &max);
+  void dump (const string &filename);
+
+private:
+  Y::Reply *call (const Y::Message::Members &v);
+
+  Y::Connection *y;
+  Y::Class *screen;
+  uint32_t id;
+};
+
+NullViewport::NullViewport (Y::Connection *y_) : y(y_), id(0)
+{
+  screen = y -> findClass ("Screen");
+
+  Y::Reply *r = screen -> invokeMethod ("list", true);
+  const Y::Message::Members &list = r -> tuple ();
+  bool found = false;
+  for (size_t i = 0; i < list.size (); ++i)
+    {
+      const string &entry = list[i].string ();
+      if (entry.find ("\tNull Video Driver") != string::npos)
+        {
+          id = strtoul (entry.c_str (), NULL, 10);
+          found = true;
+        }
+    }
+  delete r;
+
+  if (!found)
+    {
+      cerr << "yrenderbench: the server has no null viewport" << endl;
+      exit (EXIT_FAILURE);
+    }
+}
+
+Y::Reply *
+NullViewport::call (const Y::Message::Members &v)
+{
+  Y::Reply *r = screen -> invokeMethod (v, true);
+  if (r -> op () == YMO_ERROR)
+    {
+      const Y::Message::Members &t = r -> tuple ();
+      cerr << "yrenderbench: " << (t.empty () ? string ("error") : t[0].string ())
+           << endl;
+      exit (EXIT_FAILURE);
+    }
+  return r;
+}
+
+uint32_t
+NullViewport::update ()
+{
+  Y::Message::Members v;
+  v.push_back ("call");
+  v.push_back (id);
+  v.push_back ("update");
+  Y::Reply *r = call (v);
+  uint32_t checksum = r -> tuple ().at (1).uint32 ();
+  delete r;
+  return checksum;
+}
+
+void
+NullViewport::resetStatistics ()
+{
+  Y::Message::Members v;
+  v.push_back ("resetFrameStatistics");
+  v.push_back (id);
+  delete call (v);
+}
+
+void
+NullViewport::statistics (uint32_t &frames, uint32_t &mean, uint32_t &max)
+{
+  Y::Message::Members v;
+  v.push_back ("frameStatistics");
+  v.push_back (id);
+  Y::Reply *r = call (v);
+  const Y::Message::Members &t = r -> tuple ();
+  frames = t.at (0).uint32 ();
+  mean = t.at (3).uint32 ();
+  max = t.at (4).uint32 ();
+  delete r;
+}
+
+void
+NullViewport::dump (const string &filename)
+{
+  Y::Message::Members v;
+  v.push_back ("call");
+  v.push_back (id);
+  v.push_back ("dump");
+  v.push_back (filename);
+  delete call (v);
+}
+
+/* A scripted layout: setup builds the windows, step makes the
+ * change for frame N and teardown destroys everything again */
+class Layout
+{
+public:
+  virtual ~Layout () {}
+  virtual const char *name () const = 0;
+  virtual void setup (Y::Connection *y) = 0;
+  virtual void step (int n) = 0;
+  virtual void teardown () = 0;
+};
+
+/* One window holding a grid of labels whose text changes in turn */
+class LabelsLayout : public Layout
+{
+public:
+  const char *name () const {return "labels";}
+
+  void setup (Y::Connection *y)
+  {
+    window = new Y::Window (y, "labels");
+    grid = new Y::GridLayout (y);
+    window -> setChild (grid);
+    for (int i = 0; i < 64; ++i)
+      {
+        labels.push_back (new Y::Label (y, "label"));
+        grid -> addWidget (labels.back (), i % 8, i / 8);
+      }
+    window -> show ();
+  }
+
+  void step (int n)
+  {
+    char text[32];
+    snprintf (text, sizeof (text), "step %d", n);
+    labels[(n * 13) % labels.size ()] -> text.set (text);
+  }
+
+  void teardown ()
+  {
+    for (size_t i = 0; i < labels.size (); ++i)
+      delete labels[i];
+    labels.clear ();
+    delete grid;
+    delete window;
+  }
+
+private:
+  Y::Window *window;
+  Y::GridLayout *grid;
+  vector<Y::Label *> labels;
+};
+
+/* One large canvas with a small rectangle drawn on it each frame */
+class CanvasLayout : public Layout
+{
+public:
+  const char *name () const {return "canvas";}
+
+  void setup (Y::Connection *y)
+  {
+    window = new Y::Window (y, "canvas");
+    canvas = new Y::Canvas (y);
+    canvas -> requestSize (320, 240);
+    window -> setChild (canvas);
+    window -> show ();
+  }
+
+  void step (int n)
+  {
+    canvas -> setFillColour (0xFF000000 | (n * 0x10305));
+    canvas -> drawRectangle ((n * 37) % 300, (n * 53) % 220, 20, 20);
+    canvas -> flush ();
+  }
+
+  void teardown ()
+  {
+    delete canvas;
+    delete window;
+  }
+
+private:
+  Y::Window *window;
+  Y::Canvas *canvas;
+};
+
+/* Many overlapping windows, each with a label that changes in turn */
+class WindowsLayout : public Layout
+{
+public:
+  const char *name () const {return "windows";}
+
+  void setup (Y::Connection *y)
+  {
+    for (int i = 0; i < 16; ++i)
+      {
+        Y::Window *window = new Y::Window (y, "window");
+        Y::Label *label = new Y::Label (y, "overlapping window");
+        window -> setChild (label);
+        window -> show ();
+        windows.push_back (window);
+        labels.push_back (label);
+      }
+  }
+
+  void step (int n)
+  {
+    char text[32];
+    snprintf (text, sizeof (text), "window step %d", n);
+    labels[n % labels.size ()] -> text.set (text);
+  }
+
+  void teardown ()
+  {
+    for (size_t i = 0; i < windows.size (); ++i)
+      {
+        delete labels[i];
+        delete windows[i];
+      }
+    labels.clear ();
+    windows.clear ();
+  }
+
+private:
+  vector<Y::Window *> windows;
+  vector<Y::Label *> labels;
+};
+
+static void
+usage (const char *argv0)
+{
+  cerr << "Usage: " << argv0 << " [options]" << endl
+       << "  --frames N        frames rendered per layout (default 200)" << endl
+       << "  --layout NAME     only run this layout (labels, canvas, windows)" << endl
+       << "  --record FILE     save the checksum of each layout to FILE" << endl
+       << "  --check FILE      compare the checksums with those in FILE" << endl
+       << "  --dump DIR        save the last frame of each layout in DIR" << endl
+       << "  --server PATH     server binary (default " BINDIR "/Y)" << endl
+       << "  --fontpath DIR    font directory for the server" << endl
+       << "  --res WxH         size of the null display (default 800x600)" << endl
+       << "The server loads its modules from where they are installed." << endl;
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+  int frames = 200;
+  string only, recordFile, checkFile, dumpDir;
+  string serverBinary = BINDIR "/Y";
+  string fontpath = "/usr/share/fonts";
+  string resolution = "800x600";
+
+  for (int i = 1; i < argc; ++i)
+    {
+      string arg = argv[i];
+      if (i + 1 >= argc)
+        usage (argv[0]);
+      if (arg == "--frames")
+        frames = atoi (argv[++i]);
+      else if (arg == "--layout")
+        only = argv[++i];
+      else if (arg == "--record")
+        recordFile = argv[++i];
+      else if (arg == "--check")
+        checkFile = argv[++i];
+      else if (arg == "--dump")
+        dumpDir = argv[++i];
+      else if (arg == "--server")
+        serverBinary = argv[++i];
+      else if (arg == "--fontpath")
+        fontpath = argv[++i];
+      else if (arg == "--res")
+        resolution = argv[++i];
+      else
+        usage (argv[0]);
+    }
+  if (frames <= 0)
+    usage (argv[0]);
+
+  std::map<string, uint32_t> expected;
+  if (!checkFile.empty ())
+    {
+      std::ifstream in (checkFile.c_str ());
+      if (!in)
+        {
+          cerr << "yrenderbench: can't read " << checkFile << endl;
+          return EXIT_FAILURE;
+        }
+      string name, checksum;
+      while (in >> name >> checksum)
+        expected[name] = strtoul (checksum.c_str (), NULL, 16);
+    }
+
+  vector<Layout *> layouts;
+  layouts.push_back (new LabelsLayout);
+  layouts.push_back (new CanvasLayout);
+  layouts.push_back (new WindowsLayout);
+
+  BenchServer server (serverBinary, "res=" + resolution, fontpath);
+  Y::Connection y;
+  NullViewport viewport (&y);
+
+  std::ostringstream record;
+  bool mismatch = false;
+
+  cout << "layout        frames   mean us    max us  checksum" << endl;
+  for (size_t l = 0; l < layouts.size (); ++l)
+    {
+      Layout *layout = layouts[l];
+      if (!only.empty () && only != layout -> name ())
+        continue;
+
+      layout -> setup (&y);
+      viewport.update ();
+      viewport.resetStatistics ();
+
+      /* fold every frame in, so a difference in any of them shows */
+      uint32_t checksum = 0;
+      for (int n = 0; n < frames; ++n)
+        {
+          layout -> step (n);
+          checksum = ((checksum << 5) | (checksum >> 27)) ^ viewport.update ();
+        }
+
+      uint32_t shown, mean, max;
+      viewport.statistics (shown, mean, max);
+      if (!dumpDir.empty ())
+        viewport.dump (dumpDir + "/" + layout -> name () + ".png");
+
+      layout -> teardown ();
+      viewport.update ();
+
+      char line[128];
+      snprintf (line, sizeof (line), "%-10s %9u %9u %9u  %08x", layout -> name (),
+                shown, mean, max, checksum);
+      cout << line;
+      snprintf (line, sizeof (line), "%s %08x\n", layout -> name (), checksum);
+      record << line;
+
+      if (expected.count (layout -> name ()))
+        {
+          if (expected[layout -> name ()] != checksum)
+            {
+              cout << "  MISMATCH";
+              mismatch = true;
+            }
+          else
+            cout << "  ok";
+        }
+      cout << endl;
+    }
+
+  if (!recordFile.empty ())
+    {
+      std::ofstream out (recordFile.c_str ());
+      out << record.str ();
+    }
+
+  for (size_t l = 0; l < layouts.size (); ++l)
+    delete layouts[l];
+
+  return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* arch-tag: 4f2c8e60-a1d7-4b35-9c86-d7e05b19a3f2
+ */
@@ -43,6 +43,10 @@ Sample::Sample (Y::Connection *y_) : y(y_)
   samplecheckbox = new Y::CheckBox (y, "Sample Check Box");
   grid -> addWidget (samplecheckbox, 4, 1, 3);
 
+#ifdef __cpp_impl_coroutine
+  samplebutton -> clicked.connect (slot (*this, &Sample::buttonClicked));
+#endif
+
   window -> show ();
 }
 
@@ -50,6 +54,35 @@ Sample::~Sample ()
 {
 }
 
+#ifdef __cpp_impl_coroutine
+void
+Sample::buttonClicked ()
+{
+  report ();
+}
+
+/* Shows the check box's state for a couple of seconds, without
+ * holding up the rest of the client while it waits */
+Y::Task
+Sample::report ()
+{
+  uint32_t checked = 0;
+  try
+    {
+      checked = co_await Y::get (samplecheckbox -> checked);
+    }
+  catch (Y::error &)
+    {
+      /* it has never been set, so isn't checked */
+    }
+
+  std::string text = co_await Y::get (samplelabel -> text);
+  samplelabel -> text.set (checked ? "Checked" : "Not checked");
+  co_await Y::sleep (y, 2000);
+  samplelabel -> text.set (text);
+}
+#endif
+
 
 int
 main (int argc, char **argv)
@@ -20,6 +20,9 @@
 #define YSAMPLE_SAMPLE_H
 
 #include <Y/c++.h>
+#ifdef __cpp_impl_coroutine
+#include <Y/c++/coroutine.h>
+#endif
 #include <sigc++/sigc++.h>
 
 using namespace SigC;
@@ -36,6 +39,11 @@ class Sample : public SigC::Object
 
   Y::Connection *y;
 
+#ifdef __cpp_impl_coroutine
+  void buttonClicked ();
+  Y::Task report ();
+#endif
+
  public:
   Sample (Y::Connection *y);
   virtual ~Sample ();
@@ -18,10 +18,20 @@
 
 #include <Y/c++/canvas.h>
 #include <Y/c++/connection.h>
+#include <Y/c++/reply.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <string>
 
-Y::Canvas::Canvas (Y::Connection *y) : Widget(y, "Canvas"), background(this, "background")
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Y::Canvas::Canvas (Y::Connection *y) : Widget(y, "Canvas"), background(this, "background"),
+                                    preserveContents(this, "preserveContents")
 {
   subscribeSignal ("resize");
 }
@@ -41,36 +51,81 @@ Y::Canvas::onEvent (const std::string &name, const Y::Message::Members& params)
   return false;
 }
 
+/* The server allocates each message whole before handling it, so the
+ * display list is sent once it reaches a reasonable size rather than
+ * being left to grow without limit.
+ */
+static const std::string::size_type maxDisplayList = 64 * 1024;
+
+void
+Y::Canvas::queue (uint32_t word)
+{
+  word = htonl (word);
+  displayList.append (reinterpret_cast<const char *>(&word), sizeof (word));
+}
+
+/* Called after each operation is queued */
+void
+Y::Canvas::queued ()
+{
+  if (displayList.size () >= maxDisplayList)
+    flush ();
+}
+
+/** \brief Send any drawing that has not yet been sent to the server
+ */
+void
+Y::Canvas::flush ()
+{
+  if (displayList.empty ())
+    return;
+  std::string list;
+  list.swap (displayList);
+  invokeMethod ("drawList", list, false);
+}
+
 void
 Y::Canvas::savePainterState ()
 {
+  queue (YCO_SAVE_STATE);
+  queued ();
 }
 
 void
 Y::Canvas::restorePainterState ()
 {
+  queue (YCO_RESTORE_STATE);
+  queued ();
 }
 
 void
-Y::Canvas::setBlendMode ()
+Y::Canvas::setBlendMode (Y::Canvas::BlendMode mode)
 {
+  queue (YCO_SET_BLEND_MODE);
+  queue (mode);
+  queued ();
 }
 
 void
 Y::Canvas::setPenColour (uint32_t colour)
 {
-  invokeMethod ("setPenColour", colour, false);
+  queue (YCO_SET_PEN_COLOUR);
+  queue (colour);
+  queued ();
 }
 
 void
 Y::Canvas::setFillColour (uint32_t colour)
 {
-  invokeMethod ("setFillColour", colour, false);
+  queue (YCO_SET_FILL_COLOUR);
+  queue (colour);
+  queued ();
 }
 
 void
 Y::Canvas::reset (uint32_t &newWidth, uint32_t &newHeight)
 {
+  flush ();
   Reply *rep = invokeMethod ("reset", true);
   Y::Message::Members res = rep->tuple();
   delete rep;
@@ -84,23 +139,43 @@ Y::Canvas::reset (uint32_t &newWidth, uint32_t &newHeight)
 void
 Y::Canvas::clearRectangle (uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
+  queue (YCO_CLEAR_RECTANGLE);
+  queue (x);
+  queue (y);
+  queue (w);
+  queue (h);
+  queued ();
 }
 
 void
 Y::Canvas::drawRectangle (uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
+  queue (YCO_DRAW_RECTANGLE);
+  queue (x);
+  queue (y);
+  queue (w);
+  queue (h);
+  queued ();
 }
 
 void
 Y::Canvas::drawHLine (uint32_t x, uint32_t y, uint32_t dx)
 {
-  invokeMethod ("drawHLines", x, y, dx, false);
+  queue (YCO_DRAW_HLINE);
+  queue (x);
+  queue (y);
+  queue (dx);
+  queued ();
 }
 
 void
 Y::Canvas::drawVLine (uint32_t x, uint32_t y, uint32_t dy)
 {
-  invokeMethod ("drawVLines", x, y, dy, false);
+  queue (YCO_DRAW_VLINE);
+  queue (x);
+  queue (y);
+  queue (dy);
+  queued ();
 }
 
 void
@@ -129,7 +204,12 @@ Y::Canvas::drawLine (uint32_t x, uint32_t y, int32_t dx, int32_t dy)
     }
   else
     {
-      invokeMethod ("drawLines", x, y, dx, dy, false);
+      queue (YCO_DRAW_LINE);
+      queue (x);
+      queue (y);
+      queue (dx);
+      queue (dy);
+      queued ();
       return;
     }
 }
@@ -137,37 +217,161 @@ Y::Canvas::drawLine (uint32_t x, uint32_t y, int32_t dx, int32_t dy)
 void
 Y::Canvas::drawLines (Y::Canvas::Lines lines)
 {
-  uint32_t x, y;
-  int32_t dx, dy;
-  Y::Message::Members v;
+  for (Y::Canvas::Lines::iterator i = lines.begin(); i != lines.end(); i++)
+    drawLine (*i);
+}
 
-  v.push_back("drawLines");
+/** \brief Fill a w by h rectangle at (x, y) with the pen colour,
+ * modulated by an alpha map
+ *
+ * Each row of the alpha map is stride bytes long.
+ */
+void
+Y::Canvas::drawAlphamap (uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                         const uint8_t *alpha, uint32_t stride)
+{
+  if (w == 0 || h == 0)
+    return;
 
-  for (Y::Canvas::Lines::iterator i = lines.begin(); i != lines.end(); i++)
+  /* large maps are sent in bands, to keep each message a sensible size */
+  uint32_t band = std::max<uint32_t> (1, maxDisplayList / w);
+  for (uint32_t row = 0; row < h; row += band)
     {
-       v.push_back(i->x);
-       v.push_back(i->y);
-       v.push_back(i->dx);
-       v.push_back(i->dy);
+      uint32_t rows = std::min (band, h - row);
+      queue (YCO_DRAW_ALPHAMAP);
+      queue (x);
+      queue (y + row);
+      queue (w);
+      queue (rows);
+      for (uint32_t j = 0; j < rows; ++j)
+        displayList.append (reinterpret_cast<const char *>(alpha + (row + j) * stride), w);
+      displayList.append ((4 - (w * rows) % 4) % 4, '\0');
+      queued ();
     }
-  invokeMethod (v, false);
 }
 
 void
 Y::Canvas::setBufferSize (uint32_t w, uint32_t h)
 {
+  flush ();
   invokeMethod ("setBufferSize", w, h, false);
 }
 
+Y::Canvas::SharedImage::SharedImage (Y::Canvas *canvas_, uint32_t w, uint32_t h)
+  : canvas(canvas_), id(0), data_v(NULL), width_v(w), height_v(h), stride_v(w)
+{
+  size_t length = size_t(stride_v) * height_v * sizeof(uint32_t);
+
+  /* the server insists the memory can't shrink while it's mapped */
+  int fd = memfd_create("Y shared image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd == -1)
+    throw Y::exception(std::string("Could not create shared image: ") + std::strerror(errno));
+  if (ftruncate(fd, length) == -1
+      || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+    {
+      int e = errno;
+      close(fd);
+      throw Y::exception(std::string("Could not create shared image: ") + std::strerror(e));
+    }
+
+  void *data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    {
+      int e = errno;
+      close(fd);
+      throw Y::exception(std::string("Could not map shared image: ") + std::strerror(e));
+    }
+  data_v = static_cast<uint32_t *>(data);
+
+  Y::Message::Members v;
+  v.push_back("attachSharedImage");
+  v.push_back(width_v);
+  v.push_back(height_v);
+  v.push_back(stride_v);
+  Reply *rep;
+  try
+    {
+      rep = canvas->invokeMethodWithFD(v, fd, true);
+    }
+  catch (...)
+    {
+      munmap(data_v, length);
+      close(fd);
+      throw;
+    }
+  close(fd);
+
+  if (rep->op() == YMO_ERROR)
+    {
+      Y::Message::Members res = rep->tuple();
+      delete rep;
+      munmap(data_v, length);
+      throw Y::error(res);
+    }
+  id = rep->tuple()[0].uint32();
+  delete rep;
+}
+
+Y::Canvas::SharedImage::~SharedImage ()
+{
+  canvas->invokeMethod("detachSharedImage", id, false);
+  munmap(data_v, size_t(stride_v) * height_v * sizeof(uint32_t));
+}
+
+/** \brief Create an image whose pixels are shared with the server
+ *
+ * \throws Y::exception if shared memory is not available, and
+ *         Y::error if the server refuses it
+ */
+Y::Canvas::SharedImage *
+Y::Canvas::createSharedImage (uint32_t w, uint32_t h)
+{
+  return new SharedImage(this, w, h);
+}
+
+/** \brief Draw a shared image at (x, y) on the back buffer
+ */
+void
+Y::Canvas::drawSharedImage (const Y::Canvas::SharedImage *image, int32_t x, int32_t y)
+{
+  drawSharedImage (image, 0, 0, image->width(), image->height(), x, y);
+}
+
+/** \brief Draw part of a shared image at (x, y) on the back buffer
+ *
+ * Only the pixels in the w by h area at (sx, sy) of the image are read,
+ * so a client that changes a small part of a large image need only draw
+ * that part again.
+ */
+void
+Y::Canvas::drawSharedImage (const Y::Canvas::SharedImage *image,
+                            uint32_t sx, uint32_t sy, uint32_t w, uint32_t h,
+                            int32_t x, int32_t y)
+{
+  flush ();
+  Y::Message::Members v;
+  v.push_back("drawSharedImage");
+  v.push_back(image->id);
+  v.push_back(sx);
+  v.push_back(sy);
+  v.push_back(w);
+  v.push_back(h);
+  v.push_back(x);
+  v.push_back(y);
+  invokeMethod (v, false);
+}
+
 void
 Y::Canvas::swapBuffers ()
 {
+  flush ();
   invokeMethod ("swapBuffers", false);
 }
 
 void
 Y::Canvas::requestSize (uint32_t w, uint32_t h)
 {
+  flush ();
   invokeMethod ("requestSize", w, h, false);
 }
 
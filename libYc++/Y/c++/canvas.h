@@ -21,8 +21,10 @@
 
 #include <Y/c++/connection.h>
 #include <Y/c++/widget.h>
+#include <Y/c++/exception.h>
 #include <stdint.h>
 #include <sigc++/sigc++.h>
+#include <string>
 #include <vector>
 
 namespace Y
@@ -31,6 +33,10 @@ namespace Y
    * \ingroup remote
    *
    * A canvas is a 2D bitmap object that supports server-side drawing primitives
+   *
+   * Drawing is collected into a display list and sent to the server in
+   * one message when it grows large, when flush or swapBuffers is
+   * called, or before any other request that depends on it.
    */
   class Canvas : public Widget
   {
@@ -52,12 +58,57 @@ namespace Y
     };
     typedef std::vector<Line> Lines;
 
+    /** \brief Image in memory shared with the server
+     *
+     * Pixels written to data() are read by the server directly when the
+     * image is drawn with Y::Canvas::drawSharedImage, so whole frames
+     * can be drawn without sending the pixels through the connection.
+     * Each row is stride() pixels long, in the server's ARGB format.
+     *
+     * Only available when connected over a UNIX domain socket.
+     */
+    class SharedImage
+    {
+      friend class Canvas;
+    public:
+      ~SharedImage ();
+
+      uint32_t *data () {return data_v;}
+      uint32_t width () const {return width_v;}
+      uint32_t height () const {return height_v;}
+      uint32_t stride () const {return stride_v;}
+
+    private:
+      SharedImage (Canvas *canvas_, uint32_t w, uint32_t h);
+
+      Canvas *canvas;
+      uint32_t id;
+      uint32_t *data_v;
+      uint32_t width_v, height_v, stride_v;
+    };
+
+    /** \brief Porter-Duff compositing operators
+     *
+     * These must be kept in the same order as ColourBlendMode in the
+     * server.
+     */
+    enum BlendMode
+    {
+      BLEND_CLEAR,
+      BLEND_SOURCE,      BLEND_DEST,
+      BLEND_SOURCE_OVER, BLEND_SOURCE_IN,
+      BLEND_SOURCE_OUT,  BLEND_SOURCE_ATOP,
+      BLEND_DEST_OVER,   BLEND_DEST_IN,
+      BLEND_DEST_OUT,    BLEND_DEST_ATOP,
+      BLEND_XOR
+    };
+
     Canvas (Y::Connection *y);
     virtual ~Canvas ();
 
     void savePainterState ();
     void restorePainterState ();
-    void setBlendMode ();
+    void setBlendMode (BlendMode);
     void setPenColour (uint32_t);
     void setFillColour (uint32_t);
     void reset (uint32_t &newWidth, uint32_t &newHeight);
@@ -68,19 +119,40 @@ namespace Y
     void drawLine (uint32_t x, uint32_t y, int32_t dx, int32_t dy);
     void drawLine (Line l) {drawLine(l.x, l.y, l.dx, l.dy);}
     void drawLines (Lines lines);
+    void drawAlphamap (uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                       const uint8_t *alpha, uint32_t stride);
     void setBufferSize (uint32_t w, uint32_t h);
+    SharedImage *createSharedImage (uint32_t w, uint32_t h);
+    void drawSharedImage (const SharedImage *, int32_t x, int32_t y);
+    void drawSharedImage (const SharedImage *,
+                          uint32_t sx, uint32_t sy, uint32_t w, uint32_t h,
+                          int32_t x, int32_t y);
+    void flush ();
     void swapBuffers ();
     void requestSize (uint32_t w, uint32_t h);
 
     /** Background colour
      */
     Object::Property<uint32_t> background;
+    /** Non-zero to keep the back buffer's contents across swapBuffers,
+     * so that only the parts that change need to be drawn each frame
+     */
+    Object::Property<uint32_t> preserveContents;
     /** Signalled when the size of the canvas changes
      */
     SigC::Signal0<void> resize;
 
   protected:
     virtual bool onEvent (const std::string &, const Y::Message::Members&);
+
+  private:
+    friend class SharedImage;
+
+    void queue (uint32_t word);
+    void queued ();
+
+    /** Drawing not yet sent, in the format of YCanvasOperation */
+    std::string displayList;
   };
 }
 
@@ -19,30 +19,50 @@
 #include <Y/c++/class.h>
 #include <Y/c++/connection.h>
 #include <Y/c++/message.h>
+#include <Y/c++/reply.h>
+
+#include "thread_support.h"
 
 Y::Class::Class(Y::Connection *y_, std::string name_)
-  : y(y_), findReply(NULL), name_v(name_), id_v(0)
+  : y(y_), name_v(name_), id_v(0), found(false)
 {
+  pthread_mutex_init(&found_mutex, NULL);
+  pthread_cond_init(&found_cond, NULL);
+
   Y::Message::Members v;
   v.push_back(name());
   Message req(0, 0, 0, YMO_FIND_CLASS, 0, v);
-  findReply = y->sendMessage(&req);
+  Reply *findReply = y->sendMessage(&req);
+  if (findReply)
+    findReply->onReply(&foundCallback, this);
+  else
+    found = true;
 }
 
 Y::Class::~Class()
 {
-  delete findReply;
+}
+
+void
+Y::Class::foundCallback (Reply *reply, void *data)
+{
+  Class *c = static_cast<Class *>(data);
+  Connection *y = c->y;
+  int oldtype;
+  lock_mutex(c->found_mutex, oldtype);
+  c->id_v = reply->id();
+  __atomic_store_n(&c->found, true, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&c->found_cond);
+  unlock_mutex(oldtype);
+
+  /* instantiations may have been waiting for this */
+  y->releaseHeld();
 }
 
 uint32_t
 Y::Class::id() const
 {
-  if (findReply)
-    {
-      id_v = findReply->id();
-      delete findReply;
-      findReply = NULL;
-    }
+  y->waitFor(found, found_mutex, found_cond);
   return id_v;
 }
 
@@ -55,15 +75,24 @@ Y::Class::instantiate (const Y::Message::Members& params)
   /* And then come all the parameters */
   v.insert(v.end(), params.begin(), params.end());
 
-  return invokeMethod (v, true);
+  if (!v.empty() && v[0].isstring())
+    v[0] = y->methodName(v[0].string());
+  Message req(0, 0, 0, YMO_INVOKE_CLASS_METHOD, 0x01, v);
+
+  /* a new object can't depend on anything sent before it */
+  return y->sendMessage (&req, -1, false, this, NULL, ObjectReferences());
 }
 
 Y::Reply*
 Y::Class::invokeMethod (const Y::Message::Members& params, bool expectReturn)
 {
-  Message req(0, 0, id(), YMO_INVOKE_CLASS_METHOD, expectReturn ? 0x01 : 0x00, params);
+  Y::Message::Members v(params);
+  if (!v.empty() && v[0].isstring())
+    v[0] = y->methodName(v[0].string());
+  /* the class id is filled in once it is known */
+  Message req(0, 0, 0, YMO_INVOKE_CLASS_METHOD, expectReturn ? 0x01 : 0x00, v);
 
-  return y->sendMessage (&req);
+  return y->sendMessage (&req, -1, true, this, NULL, ObjectReferences());
 }
 
 Y::Reply*
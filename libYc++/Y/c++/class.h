@@ -24,6 +24,8 @@
 
 #include <string>
 
+#include <pthread.h>
+
 namespace Y
 {
   class Object;
@@ -58,10 +60,16 @@ namespace Y
 
     Reply* instantiate (const Y::Message::Members& params = Y::Message::Members());
 
+    static void foundCallback (Reply *reply, void *data);
+
     Connection *y;
-    mutable Reply *findReply;
     std::string name_v;
-    mutable uint32_t id_v;
+    uint32_t id_v;
+
+    /* set once the server has told us id_v */
+    bool found;
+    mutable pthread_mutex_t found_mutex;
+    mutable pthread_cond_t found_cond;
   };
 }
 
@@ -21,19 +21,25 @@
 #include <Y/c++/message.h>
 #include <Y/c++/reply.h>
 #include <Y/c++/timer.h>
+#include <Y/c++/exception.h>
 
 #include <Y/const.h>
 
 #include <iostream>
+#include <cerrno>
+#include <cstring>
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <pthread.h>
 
 #include "thread_support.h"
+#include "spsc_ring.h"
 
 /** \defgroup comm Network communication
  *
@@ -50,6 +56,9 @@ Y::Connection::Connection ()
 {
   /* Initialise the privates */
   server_fd = -1;
+  inbound_offset = 0;
+  held_ordered = 0;
+  pass_fds = false;
   debug_io = false;
   debug_messages = false;
   pollfd_list = NULL;
@@ -66,12 +75,22 @@ Y::Connection::Connection ()
   pthread_mutex_init(&replies_mutex, NULL);
   pthread_mutex_init(&objects_mutex, NULL);
   pthread_mutex_init(&classes_mutex, NULL);
+  pthread_mutex_init(&atoms_mutex, NULL);
   pthread_mutex_init(&messages_mutex, NULL);
-  pthread_mutex_init(&dispatch_mutex, NULL);
-  pthread_cond_init(&dispatch_cond, NULL);
+  pthread_mutex_init(&held_mutex, NULL);
   pthread_cond_init(&state_cond, NULL);
   state = none;
 
+  inbound_ring = new SpscRing<Message *, 1024>;
+  inbound_stalled = false;
+  poll_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  dispatch_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (poll_wakeup == -1 || dispatch_wakeup == -1)
+    {
+      std::cerr << "eventfd() failed: " << std::strerror(errno) << std::endl;
+      abort();
+    }
+
   const char *debug = getenv("YDEBUG");
   if (debug && strstr(debug, "messages"))
     {
@@ -114,18 +133,59 @@ Y::Connection::~Connection ()
     close(server_fd);
   server_fd = -1;
   outbound_buffer = "";
+  for (std::list<OutboundFD>::iterator i = outbound_fds.begin(); i != outbound_fds.end(); i++)
+    close(i->fd);
+  outbound_fds.clear();
   updateFDList();
 
-  for (std::map<uint32_t, Object *>::iterator i = objects.begin(); i != objects.end(); i++)
-    delete i->second;
+  for (std::list<HeldMessage>::iterator i = held.begin(); i != held.end(); i++)
+    {
+      delete i->message;
+      if (i->fd != -1)
+        close(i->fd);
+    }
+  held.clear();
+  held_ordered = 0;
+
+  /* each takes itself out of the map */
+  while (!objects.empty())
+    delete objects.begin()->second;
 
   for (std::set<TimeEvent>::iterator i = timers.begin(); i != timers.end(); i++)
     delete i->timer;
 
+  for (std::map<std::string, Reply *>::iterator i = atomReplies.begin(); i != atomReplies.end(); i++)
+    delete i->second;
+
   if (pollfd_list)
     delete[] pollfd_list;
   if (working_pollfd_list)
     delete[] working_pollfd_list;
+
+  delete inbound_ring;
+  close(poll_wakeup);
+  close(dispatch_wakeup);
+}
+
+void
+Y::Connection::wake (int fd)
+{
+  uint64_t one = 1;
+  /* this can only fail if the counter is about to overflow, in which
+   * case it is plenty awake already */
+  if (write(fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+    {
+      std::cerr << "Could not wake thread: " << std::strerror(errno) << std::endl;
+      abort();
+    }
+}
+
+void
+Y::Connection::drainWakeup (int fd)
+{
+  uint64_t count;
+  while (read(fd, &count, sizeof(count)) == -1 && errno == EINTR)
+    ;
 }
 
 Y::Connection::TimeEvent*
@@ -145,6 +205,10 @@ Y::Connection::setTimer (int msec, Y::Timer* timer)
   timers.insert(*event);
   unlock_mutex(oldtype);
 
+  /* whoever is waiting may need to wake up sooner */
+  wake(poll_wakeup);
+  wake(dispatch_wakeup);
+
   return event;
 }
 
@@ -162,6 +226,56 @@ Y::Connection::unsetTimer (Y::Connection::TimeEvent* event)
   delete event;
 }
 
+int
+Y::Connection::timerTimeout (int timeout)
+{
+  struct timeval now;
+  gettimeofday (&now, NULL);
+
+  int oldtype;
+  lock_mutex(timers_mutex, oldtype);
+  if (!timers.empty())
+    {
+      const struct timeval &then = timers.begin()->tv;
+      long msec = (then.tv_sec - now.tv_sec) * 1000
+                + (then.tv_usec - now.tv_usec + 999) / 1000;
+      if (msec < 0)
+        msec = 0;
+      if (timeout < 0 || msec < timeout)
+        timeout = msec;
+    }
+  unlock_mutex(oldtype);
+
+  return timeout;
+}
+
+void
+Y::Connection::runTimers ()
+{
+  struct timeval now;
+  gettimeofday (&now, NULL);
+
+  /* Note that the timers mutex may not be held while ticking */
+  for (;;)
+    {
+      Timer *timer = NULL;
+      int oldtype;
+      lock_mutex(timers_mutex, oldtype);
+      std::set<TimeEvent>::iterator i = timers.begin();
+      if (i != timers.end() && i->ready(now))
+        {
+          timer = i->timer;
+          timers.erase(i);
+        }
+      unlock_mutex(oldtype);
+
+      if (timer)
+        timer->doTick();
+      else
+        break;
+    }
+}
+
 void
 Y::Connection::processMessage (Message *m)
 {
@@ -177,6 +291,14 @@ Y::Connection::processMessage (Message *m)
             {
               std::string name = params[0].string();
               params.erase (params.begin ());
+
+              /* the property cache's own event, for this object alone */
+              if (name == "propertyChanged")
+                {
+                  if (object != NULL)
+                    object -> propertyChanged (params);
+                  break;
+                }
               
               while (object != NULL)
                 {
@@ -192,20 +314,39 @@ Y::Connection::processMessage (Message *m)
         if (m->seq() == 0)
           return;
 
+        Reply *r = NULL;
         int oldtype;
         lock_mutex(replies_mutex, oldtype);
         std::map<uint32_t, Reply *>::iterator i = replies.find(m->seq());
         if (i != replies.end())
           {
-            Reply *r = i->second;
-            r->dispatch(m);
-            /* We leave the reply in the map for now - it'll get
-             * removed when it's deleted. A map shouldn't have
-             * saturation issues, and it allows us to free them all
-             * automatically when the connection is destroyed
-             */
+            r = i->second;
+            if (r->callback)
+              {
+                /* The reply is ours, and the callback may well send
+                 * messages of its own, so it is called once
+                 * replies_mutex has been let go of */
+                replies.erase(i);
+              }
+            else
+              {
+                r->dispatch(m);
+                r = NULL;
+                /* We leave the reply in the map for now - it'll get
+                 * removed when it's deleted. A map shouldn't have
+                 * saturation issues, and it allows us to free them
+                 * all automatically when the connection is destroyed
+                 */
+              }
           }
         unlock_mutex(oldtype);
+
+        if (r)
+          {
+            r->dispatch(m);
+            r->callback(r, r->callback_data);
+            delete r;
+          }
       }
     }
 }
@@ -226,6 +367,7 @@ Y::Connection::detachReply (uint32_t seq)
 void
 Y::Connection::stop ()
 {
+  bool threads = false;
   int oldtype;
   lock_mutex(state_mutex, oldtype);
   switch (state)
@@ -235,12 +377,17 @@ Y::Connection::stop ()
       break;
     case running:
       stopping = true;
+      wake(poll_wakeup);
       break;
     case threaded:
-      stopThreaded();
+      threads = true;
       break;
     }
   unlock_mutex(oldtype);
+
+  /* this takes state_mutex itself, to wait for the threads */
+  if (threads)
+    stopThreaded();
 }
 
 void
@@ -262,7 +409,7 @@ Y::Connection::poll (int poll_timeout)
   if (skip)
     return;
 
-  doPoll(poll_timeout);
+  doPoll(timerTimeout(poll_timeout));
   doDispatch();
 
   if (was_none)
@@ -275,30 +422,149 @@ Y::Connection::poll (int poll_timeout)
     }
 }
 
+void
+Y::Connection::waitFor (const bool &flag, pthread_mutex_t &mutex, pthread_cond_t &cond)
+{
+  if (flag)
+    return;
+
+  bool use_threads;
+  int oldtype;
+  lock_mutex(state_mutex, oldtype);
+  use_threads = state == threaded;
+  unlock_mutex(oldtype);
+
+  if (use_threads)
+    {
+      int oldtype;
+      lock_mutex(mutex, oldtype);
+      while (!flag)
+        pthread_cond_wait(&cond, &mutex);
+      unlock_mutex(oldtype);
+    }
+  else
+    {
+      while (!flag)
+        poll(10);
+    }
+}
+
 Y::Reply *
 Y::Connection::sendMessage (const Message *m)
+{
+  return sendMessage (m, -1);
+}
+
+Y::Reply *
+Y::Connection::sendMessage (const Message *m, int fd)
+{
+  bool lookup = m->op() == YMO_FIND_CLASS || m->op() == YMO_FIND_ATOM;
+  return sendMessage (m, fd, !lookup, NULL, NULL, ObjectReferences());
+}
+
+Y::Reply *
+Y::Connection::sendMessage (const Message *m, int fd, bool ordered, const Class *target_class,
+                            Object *target_object, const ObjectReferences &references)
 {
   if (server_fd == -1)
     return NULL;
 
+  /* calls on an object the server refused to create fail here, as
+   * they would have had they waited for its id */
+  const Object *failed = failedObject(HeldMessage(NULL, -1, ordered, target_class,
+                                                  target_object, references));
+  if (failed)
+    throw Y::error(failed->error_v);
+
+  if (fd != -1)
+    {
+      if (!pass_fds)
+        throw Y::exception(this, "File descriptors can only be passed over a UNIX domain socket");
+      fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+      if (fd == -1)
+        throw Y::exception(this, std::string("Could not duplicate file descriptor: ") + std::strerror(errno));
+    }
+
+  /* The reply may be dispatched as soon as the message is written, so
+   * it has to be waiting for it before then */
+  Reply *r = NULL;
+  int oldtype;
+  if (m->expectReply() && m->seq() > 0)
+    {
+      r = new Reply(this, m->seq());
+      lock_mutex(replies_mutex, oldtype);
+      replies[m->seq()] = r;
+      unlock_mutex(oldtype);
+    }
+
+  HeldMessage h(NULL, fd, ordered, target_class, target_object, references);
+
+  lock_mutex(held_mutex, oldtype);
+  if ((held_ordered == 0 || !ordered) && canSend(h))
+    {
+      if (target_class == NULL && target_object == NULL && references.empty())
+        bufferMessage(m, fd);
+      else
+        {
+          Message filled(*m);
+          fillIds(&filled, h);
+          bufferMessage(&filled, fd);
+        }
+    }
+  else
+    {
+      if (debug_messages)
+        {
+          std::cerr << "Holding message " << *m << std::endl;
+        }
+      h.message = new Message(*m);
+      held.push_back(h);
+      if (ordered)
+        held_ordered++;
+    }
+  unlock_mutex(oldtype);
+
+  return r;
+}
+
+void
+Y::Connection::bufferMessage (const Message *m, int fd)
+{
   if (debug_messages)
     {
       std::cerr << "Buffering message " << *m << std::endl;
     }
 
   size_t old_length = 0;
-
   int oldtype;
+
   lock_mutex(outbound_mutex, oldtype);
+  size_t start = outbound_buffer.length();
   if (debug_io)
-    old_length = outbound_buffer.length();
+    old_length = start;
   m->serialise(outbound_buffer);
+  if (fd != -1)
+    {
+      OutboundFD o;
+      o.fd = fd;
+      o.start = start;
+      o.end = outbound_buffer.length();
+      outbound_fds.push_back(o);
+    }
   unlock_mutex(oldtype);
 
+  /* If somebody is in poll() without waiting for the server to be
+   * writable, get them to start again with POLLOUT set */
+  bool wake_poller;
   lock_mutex(pollfd_list_mutex, oldtype);
+  wake_poller = working_pollfd_list == NULL
+             && (pollfd_list[pollfds - 1].events & POLLOUT) == 0;
   pollfd_list[pollfds - 1].events |= POLLOUT;
   unlock_mutex(oldtype);
 
+  if (wake_poller)
+    wake(poll_wakeup);
+
   if (debug_io)
     {
       lock_mutex(outbound_mutex, oldtype);
@@ -306,19 +572,6 @@ Y::Connection::sendMessage (const Message *m)
                 << (outbound_buffer.length() - old_length) << ")" << std::endl;
       unlock_mutex(oldtype);
     }
-
-  if (m->expectReply() && m->seq() > 0)
-    {
-      Reply *r = new Reply(this, m->seq());
-      lock_mutex(replies_mutex, oldtype);
-      replies[m->seq()] = r;
-      unlock_mutex(oldtype);
-      return r;
-    }
-  else
-    {
-      return NULL;
-    }
 }
 
 /* arch-tag: 39a41201-2e34-48ef-aa33-9c6cc5b2c74b
@@ -24,6 +24,7 @@
 
 #include <sys/poll.h>
 #include <sys/time.h>
+#include <sys/types.h>
 #include <inttypes.h>
 
 #include <vector>
@@ -48,6 +49,11 @@ namespace Y
   class Object;
   class Reply;
   class Timer;
+  template <class T, size_t Size> class SpscRing;
+
+  /* Arguments of a message that name objects, by their position in
+   * the message's tuple */
+  typedef std::map<size_t, Object *> ObjectReferences;
 
   /** \brief Connection to a Y server
    * \ingroup comm
@@ -56,6 +62,8 @@ namespace Y
   {
     friend class Reply;
     friend class Timer;
+    friend class Class;
+    friend class Object;
 
   public:
     Connection ();
@@ -67,8 +75,20 @@ namespace Y
     void stop ();
 
     Class *findClass (std::string className);
+    /* The name of a method, as it should be sent in an invocation:
+     * the server's atom for it if that is known, or the name itself
+     * while it is being looked up.
+     */
+    Message::Member methodName (const std::string &name);
 
     Reply *sendMessage (const Message *);
+    /* Send a message along with a file descriptor, which the server
+     * receives before it handles the message.  The descriptor is
+     * duplicated, so the caller keeps its own.  Only possible over a
+     * UNIX domain socket.
+     */
+    Reply *sendMessage (const Message *, int fd);
+    bool canPassFileDescriptors () const {return pass_fds;}
 
     void registerFD (int fd, int mask, void *data, void (*call)(int, int, void *));
     void unregisterFD (int fd);
@@ -117,9 +137,64 @@ namespace Y
 
     TimeEvent* setTimer (int msec, Y::Timer* timer);
     void unsetTimer (TimeEvent* event);
+    /* timeout, shortened to when the next timer is due */
+    int timerTimeout (int timeout);
+    void runTimers ();
 
     bool debug_messages, debug_io;
 
+    /* Block until flag is set under mutex, which is signalled through
+     * cond.  If no other thread is reading from the server, poll it
+     * while waiting. */
+    void waitFor(const bool &flag, pthread_mutex_t &mutex, pthread_cond_t &cond);
+
+    /* A message that can't be sent yet, because the server hasn't told
+     * us the id of a class or an object it involves.  target_class is
+     * the class a class method is invoked on, target_object the object
+     * an instance method is invoked on, and references the arguments
+     * that name objects; the ids are filled in when it is sent.
+     */
+    class HeldMessage
+    {
+    public:
+      HeldMessage (Message *message_, int fd_, bool ordered_, const Class *target_class_,
+                   Object *target_object_, const ObjectReferences &references_)
+        : message(message_), fd(fd_), ordered(ordered_), target_class(target_class_),
+          target_object(target_object_), references(references_)
+        {}
+
+      Message *message;
+      int fd;
+      bool ordered;
+      const Class *target_class;
+      Object *target_object;
+      ObjectReferences references;
+    };
+
+    /* Messages are ordered unless nothing sent before them can make a
+     * difference to them: lookups, and instantiations, which don't
+     * touch any object that exists already.  Ordered messages are held
+     * behind any held before them, so that the server sees them in the
+     * order they were sent; the others go as soon as they can, which
+     * lets every object of a new window be constructed at once.
+     */
+    std::list<HeldMessage> held;
+    size_t held_ordered;
+    pthread_mutex_t held_mutex;
+
+    Reply *sendMessage (const Message *m, int fd, bool ordered, const Class *target_class,
+                        Object *target_object, const ObjectReferences &references);
+    bool canSend (const HeldMessage &h) const;
+    /* The object the message is for or about that the server refused
+     * to create, if any; the message cannot be sent at all */
+    const Object *failedObject (const HeldMessage &h) const;
+    void fillIds (Message *m, const HeldMessage &h) const;
+    void bufferMessage (const Message *m, int fd);
+    /* Send whatever held messages can be sent now */
+    void releaseHeld ();
+    /* Fill the id of obj into held messages, as it is being deleted */
+    void forgetHeld (Object *obj);
+
     std::list<Message *> messages;
     pthread_mutex_t messages_mutex;
 
@@ -132,6 +207,10 @@ namespace Y
     std::map<std::string, Class*> classes;
     pthread_mutex_t classes_mutex;
 
+    std::map<std::string, uint32_t> atoms;
+    std::map<std::string, Reply*> atomReplies;
+    pthread_mutex_t atoms_mutex;
+
     void processMessage (Message *);
 
     class FDHandler
@@ -152,8 +231,22 @@ namespace Y
     fdmap fds;
     pthread_mutex_t fds_mutex;
 
+    /* bytes from the server; those before inbound_offset have been
+     * parsed already, and are dropped by nextInboundMessage */
     std::string inbound_buffer;
+    size_t inbound_offset;
     std::string outbound_buffer;
+    /* a descriptor to pass along with the message held in bytes
+     * [start, end) of outbound_buffer */
+    struct OutboundFD
+    {
+      int fd;
+      size_t start;
+      size_t end;
+    };
+    /* in the order of their messages, protected by outbound_mutex */
+    std::list<OutboundFD> outbound_fds;
+    bool pass_fds;
     pthread_mutex_t inbound_mutex;
     pthread_mutex_t outbound_mutex;
 
@@ -162,6 +255,7 @@ namespace Y
     void setNonBlocking(int fd);
 
     void unbufferMessages ();
+    Message *nextInboundMessage ();
     void doPollIO(struct pollfd *ufds, int timeout);
     void doPoll(int poll_timeout);
     void doDispatch();
@@ -171,13 +265,30 @@ namespace Y
     void stopThreaded();
     void pollThreadMain();
     void dispatchThreadMain();
+    bool parseInbound();
+
+    pthread_t dispatch_thread, poll_thread;
 
-    pthread_t dispatch_thread;
-    pthread_mutex_t dispatch_mutex;
-    pthread_cond_t dispatch_cond;
+    /* When threaded, the poll thread parses messages and hands them
+     * to the dispatch thread through this ring.  If it fills up, the
+     * poll thread leaves the rest in inbound_buffer and sets
+     * inbound_stalled, and the dispatch thread wakes it once there is
+     * room again.
+     */
+    SpscRing<Message *, 1024> *inbound_ring;
+    bool inbound_stalled;
+
+    /* eventfds: poll_wakeup interrupts whoever is polling, so that new
+     * outbound data, timers and stop requests are noticed at once;
+     * dispatch_wakeup tells the dispatch thread there is work.
+     */
+    int poll_wakeup, dispatch_wakeup;
+    static void wake(int fd);
+    static void drainWakeup(int fd);
 
     void readServer();
     void writeServer();
+    ssize_t writeServerWithFDs();
 
     /* We have two because poll() needs something to update as it
      * works, and this avoids having to allocate for every poll()
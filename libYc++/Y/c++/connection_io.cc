@@ -18,6 +18,7 @@
 
 #include <Y/c++/connection.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <iostream>
@@ -25,6 +26,7 @@
 #include <stdlib.h>
 #include <sys/poll.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -79,10 +81,6 @@ Y::Connection::doPoll (int poll_timeout)
   if (ufds == NULL)
     return;
 
-  /* FIXME: If the next timer to expire will occur before
-   * poll_timeout, reduce the timeout
-   */
-
   /* We now own working_pollfd_list and are responsible for disposing of it */
   doPollIO(ufds, poll_timeout);
 
@@ -110,6 +108,13 @@ Y::Connection::doPollIO (struct pollfd *ufds, int timeout)
 
   for (int i = 0; i < pollfds; i++)
     {
+      if (ufds[i].fd == poll_wakeup)
+        {
+          if (ufds[i].revents & POLLIN)
+            drainWakeup(poll_wakeup);
+          continue;
+        }
+
       int mask = 0;
       if (ufds[i].revents & POLLIN)
         {
@@ -179,6 +184,64 @@ Y::Connection::readServer ()
   unlock_mutex(oldtype);
 }
 
+/* Parse the next complete message in inbound_buffer, or return NULL
+ * if there isn't one.  Called with inbound_mutex held.
+ *
+ * Parsed bytes are only dropped once the buffer has no complete
+ * message left, when all that has to move is the start of the next
+ * one, so a backlog of many messages is parsed in linear time.
+ */
+Y::Message *
+Y::Connection::nextInboundMessage ()
+{
+  Message *m = Message::parseStream(inbound_buffer, inbound_offset);
+  if (m == NULL && inbound_offset > 0)
+    {
+      inbound_buffer.erase(0, inbound_offset);
+      inbound_offset = 0;
+    }
+  return m;
+}
+
+/* Write the message at the front of the buffer, passing its file
+ * descriptor along with it.  The server gives a descriptor to the
+ * message holding the last byte of the read it arrived with, so the
+ * write carries no bytes beyond that message.  Called with
+ * outbound_mutex held.
+ */
+ssize_t
+Y::Connection::writeServerWithFDs ()
+{
+  const OutboundFD &front = outbound_fds.front();
+  char control[CMSG_SPACE(sizeof(int))];
+  struct iovec iov;
+  struct msghdr msg;
+
+  iov.iov_base = const_cast<char *>(outbound_buffer.data());
+  iov.iov_len = front.end;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &front.fd, sizeof(int));
+
+  ssize_t ret = sendmsg(server_fd, &msg, MSG_NOSIGNAL);
+
+  /* once sent, the server has its own copy */
+  if (ret > 0)
+    {
+      close(front.fd);
+      outbound_fds.pop_front();
+    }
+  return ret;
+}
+
 void
 Y::Connection::writeServer ()
 {
@@ -187,10 +250,23 @@ Y::Connection::writeServer ()
 
   int oldtype;
   lock_mutex(outbound_mutex, oldtype);
-  ret = write(server_fd, outbound_buffer.data(), outbound_buffer.length());
+  if (outbound_fds.empty())
+    ret = write(server_fd, outbound_buffer.data(), outbound_buffer.length());
+  else if (outbound_fds.front().start > 0)
+    /* messages before the next one with a descriptor go on their own */
+    ret = write(server_fd, outbound_buffer.data(), outbound_fds.front().start);
+  else
+    ret = writeServerWithFDs();
   /* Remove any bytes that we wrote */
   if (ret > 0)
-    outbound_buffer.erase(0, ret);
+    {
+      outbound_buffer.erase(0, ret);
+      for (std::list<OutboundFD>::iterator i = outbound_fds.begin(); i != outbound_fds.end(); i++)
+        {
+          i->start -= std::min(i->start, size_t(ret));
+          i->end -= std::min(i->end, size_t(ret));
+        }
+    }
   remaining = outbound_buffer.length();
   unlock_mutex(oldtype);
 
@@ -204,11 +280,19 @@ Y::Connection::writeServer ()
       abort();
     }
 
-  /* If we've got nothing left to write, don't poll for write any more */
-  if (outbound_buffer.length() == 0)
+  /* If we've got nothing left to write, don't poll for write any
+   * more.  Look again with both locks held: sendMessage sets POLLOUT
+   * after adding to the buffer, and only wakes the poller if it was
+   * clear, so clearing it after a message was added would strand it.
+   */
+  if (remaining == 0)
     {
       lock_mutex(pollfd_list_mutex, oldtype);
-      pollfd_list[pollfds - 1].events &= ~POLLOUT;
+      int oldtype2;
+      lock_mutex(outbound_mutex, oldtype2);
+      if (outbound_buffer.length() == 0)
+        pollfd_list[pollfds - 1].events &= ~POLLOUT;
+      unlock_mutex(oldtype2);
       unlock_mutex(oldtype);
     }
 
@@ -236,7 +320,8 @@ Y::Connection::updateFDList ()
 
   int oldtype2;
   lock_mutex(fds_mutex, oldtype2);
-  pollfds = fds.size() + 1;
+  /* the registered descriptors, then the wakeup, then the server */
+  pollfds = fds.size() + 2;
   pollfd_list = new struct pollfd[pollfds];
   working_pollfd_list = new struct pollfd[pollfds];
 
@@ -255,6 +340,10 @@ Y::Connection::updateFDList ()
       if (fi->second.mask & Y_LISTEN_EXCEPT)
         pollfd_list[i].events |= POLLERR;
     }
+
+  pollfd_list[i].fd = poll_wakeup;
+  pollfd_list[i].events = POLLIN;
+  pollfd_list[i].revents = 0;
   unlock_mutex(oldtype2);
 
   if (server_fd == -1)
@@ -45,7 +45,7 @@ Y::Connection::run ()
 
   while (!stopping)
     {
-      doPoll(100);
+      doPoll(timerTimeout(-1));
       doDispatch();
     }
 
@@ -93,36 +93,7 @@ Y::Connection::doDispatch ()
       delete m;
     }
 
-  struct timeval now;
-  gettimeofday (&now, NULL);
-
-  /* Here we go again... */
-  for (;;)
-    {
-      int oldtype;
-      bool empty;
-      lock_mutex(timers_mutex, oldtype);
-      empty = timers.empty();
-      unlock_mutex(oldtype);
-
-      if (empty)
-        break;
-
-      Timer *timer = NULL;
-      lock_mutex(timers_mutex, oldtype);
-      std::set<TimeEvent>::iterator i = timers.begin();
-      if (i->ready(now))
-        {
-          timer = i->timer;
-          timers.erase(i);
-        }
-      unlock_mutex(oldtype);
-
-      if (timer)
-        timer->doTick();
-      else
-        break;
-    }
+  runTimers();
 }
 
 void
@@ -135,7 +106,7 @@ Y::Connection::unbufferMessages ()
   int oldtype;
   lock_mutex(inbound_mutex, oldtype);
   uint32_t packet_len;
-  while (Message *m = Message::parseStream(inbound_buffer))
+  while (Message *m = nextInboundMessage())
     {
       if (debug_messages)
         {
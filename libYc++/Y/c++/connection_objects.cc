@@ -19,9 +19,12 @@
 #include <Y/c++/connection.h>
 #include <Y/c++/class.h>
 #include <Y/c++/object.h>
+#include <Y/c++/reply.h>
 
 #include "thread_support.h"
 
+#include <unistd.h>
+
 Y::Class *
 Y::Connection::findClass (std::string className)
 {
@@ -44,12 +47,74 @@ Y::Connection::findClass (std::string className)
   return c;
 }
 
+Y::Message::Member
+Y::Connection::methodName (const std::string &name)
+{
+  bool known = false, pending = false;
+  uint32_t atom = 0;
+  Reply *reply = NULL;
+  int oldtype;
+  lock_mutex(atoms_mutex, oldtype);
+  std::map<std::string, uint32_t>::iterator i = atoms.find(name);
+  if (i != atoms.end())
+    {
+      known = true;
+      atom = i->second;
+    }
+  else
+    {
+      std::map<std::string, Reply *>::iterator r = atomReplies.find(name);
+      if (r != atomReplies.end())
+        {
+          pending = true;
+          if (r->second->hasTuple())
+            {
+              reply = r->second;
+              atomReplies.erase(r);
+            }
+        }
+    }
+  unlock_mutex(oldtype);
+
+  if (reply)
+    {
+      /* the server has answered; 0 means it has no atom for this name,
+       * so keep sending the name */
+      atom = reply->op() == YMO_ERROR ? 0 : reply->id();
+      delete reply;
+      lock_mutex(atoms_mutex, oldtype);
+      atoms[name] = atom;
+      unlock_mutex(oldtype);
+      known = true;
+    }
+  else if (!pending)
+    {
+      /* ask, but don't wait for the answer */
+      Y::Message::Members v;
+      v.push_back(name);
+      Message req(0, 0, 0, YMO_FIND_ATOM, 0, v);
+      reply = sendMessage(&req);
+      lock_mutex(atoms_mutex, oldtype);
+      if (atomReplies.find(name) == atomReplies.end())
+        {
+          atomReplies[name] = reply;
+          reply = NULL;
+        }
+      unlock_mutex(oldtype);
+      delete reply;
+    }
+
+  if (known && atom != 0)
+    return Message::Member(atom);
+  return Message::Member(name);
+}
+
 void
 Y::Connection::createdObject (Object *obj)
 {
   int oldtype;
   lock_mutex(objects_mutex, oldtype);
-  objects[obj->id()] = obj;
+  objects[obj->id_v] = obj;
   unlock_mutex(oldtype);
 }
 
@@ -74,10 +139,127 @@ Y::Connection::destroyObject (uint32_t oid)
   int oldtype;
   lock_mutex(objects_mutex, oldtype);
   std::map<uint32_t, Object *>::iterator i = objects.find(oid);
-  if (i == objects.end())
+  if (i != objects.end())
     objects.erase(i);
   unlock_mutex(oldtype);
 }
 
+bool
+Y::Connection::canSend (const HeldMessage &h) const
+{
+  if (h.target_class && !__atomic_load_n(&h.target_class->found, __ATOMIC_ACQUIRE))
+    return false;
+  if (h.target_object && !__atomic_load_n(&h.target_object->created, __ATOMIC_ACQUIRE))
+    return false;
+  for (ObjectReferences::const_iterator i = h.references.begin(); i != h.references.end(); i++)
+    if (!__atomic_load_n(&i->second->created, __ATOMIC_ACQUIRE))
+      return false;
+  return true;
+}
+
+const Y::Object *
+Y::Connection::failedObject (const HeldMessage &h) const
+{
+  if (h.target_object && __atomic_load_n(&h.target_object->created, __ATOMIC_ACQUIRE)
+      && h.target_object->failed)
+    return h.target_object;
+  for (ObjectReferences::const_iterator i = h.references.begin(); i != h.references.end(); i++)
+    if (__atomic_load_n(&i->second->created, __ATOMIC_ACQUIRE) && i->second->failed)
+      return i->second;
+  return NULL;
+}
+
+void
+Y::Connection::fillIds (Message *m, const HeldMessage &h) const
+{
+  if (h.target_class)
+    m->v.id = h.target_class->id_v;
+  if (h.target_object)
+    m->v.id = h.target_object->id_v;
+  for (ObjectReferences::const_iterator i = h.references.begin(); i != h.references.end(); i++)
+    m->v.tuple.at(i->first) = Message::Member(i->second->id_v);
+}
+
+void
+Y::Connection::releaseHeld ()
+{
+  /* once an ordered message has to stay, so do all those after it */
+  bool blocked = false;
+  /* replies to give errors to, once held_mutex has been let go of */
+  std::list<Message *> refused;
+  int oldtype;
+  lock_mutex(held_mutex, oldtype);
+  std::list<HeldMessage>::iterator h = held.begin();
+  while (h != held.end())
+    {
+      if ((!blocked || !h->ordered) && canSend(*h))
+        {
+          /* it would go to, or name, object 0; fail it instead, as
+           * it would have failed had it not been held */
+          const Object *failed = failedObject(*h);
+          if (failed)
+            {
+              if (h->message->expectReply())
+                {
+                  Message *error = new Message(0, 0, 0, YMO_ERROR, 0, failed->error_v);
+                  error->v.seq = h->message->seq();
+                  refused.push_back(error);
+                }
+              if (h->fd != -1)
+                close(h->fd);
+            }
+          else
+            {
+              fillIds(h->message, *h);
+              bufferMessage(h->message, h->fd);
+            }
+          delete h->message;
+          if (h->ordered)
+            held_ordered--;
+          held.erase(h++);
+        }
+      else
+        {
+          if (h->ordered)
+            blocked = true;
+          h++;
+        }
+    }
+  unlock_mutex(oldtype);
+
+  for (std::list<Message *>::iterator i = refused.begin(); i != refused.end(); i++)
+    {
+      processMessage(*i);
+      delete *i;
+    }
+}
+
+void
+Y::Connection::forgetHeld (Object *obj)
+{
+  int oldtype;
+  lock_mutex(held_mutex, oldtype);
+  for (std::list<HeldMessage>::iterator h = held.begin(); h != held.end(); h++)
+    {
+      if (h->target_object == obj)
+        {
+          h->message->v.id = obj->id_v;
+          h->target_object = NULL;
+        }
+      ObjectReferences::iterator i = h->references.begin();
+      while (i != h->references.end())
+        {
+          if (i->second == obj)
+            {
+              h->message->v.tuple.at(i->first) = Message::Member(obj->id_v);
+              h->references.erase(i++);
+            }
+          else
+            i++;
+        }
+    }
+  unlock_mutex(oldtype);
+}
+
 /* arch-tag: e3ec0e65-db55-4346-99c7-b6d4fc59dbcd
  */
@@ -22,8 +22,10 @@
 
 #include <iostream>
 #include <pthread.h>
+#include <sys/poll.h>
 
 #include "thread_support.h"
+#include "spsc_ring.h"
 
 void *
 Y::Connection::dispatchThreadLauncher(void *arg)
@@ -41,6 +43,7 @@ Y::Connection::runThreaded ()
   if (state != none)
     abort();
   state = threaded;
+  poll_thread = pthread_self();
   unlock_mutex(oldtype);
 
   if (pthread_create(&dispatch_thread, NULL, &dispatchThreadLauncher, this) != 0)
@@ -48,11 +51,17 @@ Y::Connection::runThreaded ()
 
   pollThreadMain();
 
-  stopping = false;
-
   if (pthread_join(dispatch_thread, NULL) != 0)
     abort();
 
+  stopping = false;
+
+  /* throw away anything that arrived too late to be dispatched */
+  Message *m;
+  while (inbound_ring->pop(m))
+    delete m;
+  inbound_stalled = false;
+
   lock_mutex(state_mutex, oldtype);
   state = none;
   pthread_cond_broadcast(&state_cond);
@@ -63,6 +72,8 @@ void
 Y::Connection::stopThreaded ()
 {
   stopping = true;
+  wake(poll_wakeup);
+  wake(dispatch_wakeup);
 
   /* If we are one of the threads associated with the connection,
    * terminate ourselves. We may not return.
@@ -70,10 +81,15 @@ Y::Connection::stopThreaded ()
   if (pthread_equal(dispatch_thread, pthread_self()))
     pthread_exit(NULL);
 
+  /* The poll thread is the one that ends runThreaded, so it must
+   * not wait for itself */
+  if (pthread_equal(poll_thread, pthread_self()))
+    return;
+
   /* Wait for the other threads to shut down */
   int oldtype;
   lock_mutex(state_mutex, oldtype);
-  while (state == running)
+  while (state == threaded)
     pthread_cond_wait(&state_cond, &state_mutex);
   unlock_mutex(oldtype);
 }
@@ -81,39 +97,58 @@ Y::Connection::stopThreaded ()
 void
 Y::Connection::pollThreadMain ()
 {
+  /* Anything that should interrupt the poll writes to poll_wakeup,
+   * so there is no need for a timeout; timers are the dispatch
+   * thread's business.
+   */
   while (!stopping)
     {
-      int oldtype;
-
-      size_t old_length;
+      doPoll(-1);
 
-      lock_mutex(inbound_mutex, oldtype);
-      old_length = inbound_buffer.length();
-      unlock_mutex(oldtype);
-
-      doPoll(100);
+      if (parseInbound())
+        wake(dispatch_wakeup);
+    }
+}
 
-      bool signal_dispatch = false;
+/* Move as many complete messages as will fit from inbound_buffer to
+ * the ring.  Returns whether there were any.
+ */
+bool
+Y::Connection::parseInbound ()
+{
+  bool parsed = false;
 
-      lock_mutex(inbound_mutex, oldtype);
-      if (inbound_buffer.length() > old_length)
-        signal_dispatch = true;
-      unlock_mutex(oldtype);
-      struct timeval now;
-      gettimeofday (&now, NULL);
+  int oldtype;
+  lock_mutex(inbound_mutex, oldtype);
+  for (;;)
+    {
+      if (inbound_ring->full())
+        {
+          /* Ask to be woken when there is room, then look again in
+           * case the dispatch thread emptied the ring before it could
+           * see the request.
+           */
+          __atomic_store_n(&inbound_stalled, true, __ATOMIC_SEQ_CST);
+          __atomic_thread_fence(__ATOMIC_SEQ_CST);
+          if (inbound_ring->full())
+            break;
+        }
 
-      lock_mutex(timers_mutex, oldtype);
-      if (!timers.empty() && timers.begin()->ready(now))
-        signal_dispatch = true;
-      unlock_mutex(oldtype);
+      Message *m = nextInboundMessage();
+      if (m == NULL)
+        break;
 
-      if (signal_dispatch)
+      if (debug_messages)
         {
-          lock_mutex(dispatch_mutex, oldtype);
-          pthread_cond_signal(&dispatch_cond);
-          unlock_mutex(oldtype);
+          std::cerr << "Read message " << *m << std::endl;
         }
+
+      inbound_ring->push(m);
+      parsed = true;
     }
+  unlock_mutex(oldtype);
+
+  return parsed;
 }
 
 void
@@ -121,62 +156,29 @@ Y::Connection::dispatchThreadMain ()
 {
   while (!stopping)
     {
-      for(;;)
-        {
-          int oldtype;
-          Message *m;
-          lock_mutex(inbound_mutex, oldtype);
-          m = Message::parseStream(inbound_buffer);
-          unlock_mutex(oldtype);
-
-          if (m == NULL)
-            break;
-            
-          if (debug_messages)
-            {
-              std::cerr << "Read message " << *m << std::endl;
-            }
-
-          lock_mutex(messages_mutex, oldtype);
-          messages.push_back (m);
-          unlock_mutex(oldtype);
-        }
-
-      for (;;)
+      Message *m;
+      while (inbound_ring->pop(m))
         {
-          int oldtype;
-          bool empty;
-          lock_mutex(messages_mutex, oldtype);
-          empty = messages.empty();
-          unlock_mutex(oldtype);
-
-          if (empty)
-            break;
-
-          Message *m;
-          lock_mutex(messages_mutex, oldtype);
-          m = messages.front();
-          messages.pop_front();
-          unlock_mutex(oldtype);
-
           processMessage (m);
           delete m;
         }
 
-      /* Note that we don't have a while loop here. The actual
-       * conditional is really complicated, but it doesn't really
-       * matter if we go around the loop when we don't need to, so
-       * long as it doesn't happen very often. So, we leave it to the
-       * polling loop to figure out when to wake us up, and then we
-       * just wait once.
-       *
-       * This is a minor abuse of conditional waits, but it's the best
-       * I can come up with for pthreads.
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_exchange_n(&inbound_stalled, false, __ATOMIC_SEQ_CST))
+        wake(poll_wakeup);
+
+      runTimers();
+
+      /* The poll thread wakes us after every batch of messages, and
+       * setTimer and stopThreaded wake us too, so all we need to wait
+       * for besides is the next timer.
        */
-      int oldtype;
-      lock_mutex(dispatch_mutex, oldtype);
-      pthread_cond_wait(&dispatch_cond, &dispatch_mutex);
-      unlock_mutex(oldtype);
+      struct pollfd ufd;
+      ufd.fd = dispatch_wakeup;
+      ufd.events = POLLIN;
+      ufd.revents = 0;
+      if (::poll(&ufd, 1, timerTimeout(-1)) > 0)
+        drainWakeup(dispatch_wakeup);
     }
 }
 
@@ -41,6 +41,7 @@ Y::Connection::unixInitialise (const char *display)
     }
 
   server_fd = fd;
+  pass_fds = true;
 }
 
 /* arch-tag: c5315195-82c1-4c90-ba8c-d3dd4ec0bcad
@@ -0,0 +1,251 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef Y_CPP_COROUTINE_H
+#define Y_CPP_COROUTINE_H
+
+#ifndef __cpp_impl_coroutine
+#error "Y/c++/coroutine.h needs a C++ compiler with coroutines enabled"
+#endif
+
+#include <Y/c++/connection.h>
+#include <Y/c++/message.h>
+#include <Y/c++/reply.h>
+#include <Y/c++/timer.h>
+#include <Y/c++/exception.h>
+
+#include <coroutine>
+#include <exception>
+
+/** \defgroup coroutines Coroutines
+ *
+ * Clients built with C++20 coroutines can co_await replies, timers
+ * and file descriptors, rather than waiting in callbacks or blocking.
+ * Whatever a coroutine waits for resumes it from the connection's own
+ * loop, on whichever thread dispatches messages, runs timers or polls
+ * descriptors, so no threads are added.
+ *
+ * Nothing here is compiled into the library; it is all built on
+ * Y::Reply::onReply, Y::Timer and Y::Connection::registerFD.
+ *
+ * \code
+ * Y::Task
+ * blink (Y::Connection *y, Y::Label *label)
+ * {
+ *   std::string text = co_await Y::get (label->text);
+ *   for (;;)
+ *     {
+ *       label->text.set ("");
+ *       co_await Y::sleep (y, 500);
+ *       label->text.set (text);
+ *       co_await Y::sleep (y, 500);
+ *     }
+ * }
+ * \endcode
+ */
+
+namespace Y
+{
+  /** \brief Coroutine left to run by itself
+   * \ingroup coroutines
+   *
+   * A coroutine returning a Task runs as soon as it is called, and
+   * returns to its caller when it first waits.  It frees itself when
+   * it finishes.  An exception escaping it is fatal.
+   */
+  class Task
+  {
+  public:
+    class promise_type
+    {
+    public:
+      Task get_return_object () {return Task();}
+      std::suspend_never initial_suspend () noexcept {return {};}
+      std::suspend_never final_suspend () noexcept {return {};}
+      void return_void () {}
+      void unhandled_exception () {std::terminate();}
+    };
+  };
+
+  /** \brief Wait for a reply
+   * \ingroup coroutines
+   *
+   * Takes over the reply, and gives its tuple, or throws Y::error if
+   * the server answered with an error.
+   */
+  class ReplyAwaiter
+  {
+  public:
+    explicit ReplyAwaiter (Reply *reply_) : reply(reply_), op(YMO_ERROR) {}
+    ReplyAwaiter (const ReplyAwaiter &) = delete;
+    ~ReplyAwaiter () {delete reply;}
+
+    bool await_ready () const {return reply == NULL || reply->hasTuple();}
+
+    void await_suspend (std::coroutine_handle<> h)
+    {
+      handle = h;
+      /* the reply is the connection's now, and if it has arrived in
+       * the meantime this resumes the coroutine straight away, so
+       * nothing may be touched afterwards */
+      Reply *r = reply;
+      reply = NULL;
+      r->onReply(&arrived, this);
+    }
+
+    Message::Members await_resume ()
+    {
+      if (reply)
+        {
+          take(reply);
+          delete reply;
+          reply = NULL;
+        }
+      if (op == YMO_ERROR)
+        throw error(tuple);
+      return tuple;
+    }
+
+  protected:
+    /* for when the reply is only known after construction */
+    void expect (Reply *r) {reply = r;}
+
+  private:
+    static void arrived (Reply *r, void *data)
+    {
+      ReplyAwaiter *self = static_cast<ReplyAwaiter *>(data);
+      self->take(r);
+      self->handle.resume();
+    }
+
+    void take (Reply *r)
+    {
+      op = r->op();
+      tuple = r->tuple();
+    }
+
+    Reply *reply;
+    std::coroutine_handle<> handle;
+    enum YMessageOperation op;
+    Message::Members tuple;
+  };
+
+  /** \brief Wait for a property's value
+   * \ingroup coroutines
+   *
+   * If the object has the value cached, this doesn't wait at all.
+   */
+  template <class P>
+  class PropertyAwaiter : public ReplyAwaiter
+  {
+  public:
+    explicit PropertyAwaiter (P &property_)
+      : ReplyAwaiter(NULL), property(property_), value(), generation(0),
+        cached(property_.lookup(value, generation))
+    {
+      if (!cached)
+        expect(property.getReply());
+    }
+
+    bool await_ready () const {return cached || ReplyAwaiter::await_ready();}
+
+    typename P::Type await_resume ()
+    {
+      if (cached)
+        return value;
+      Message::Members m = ReplyAwaiter::await_resume();
+      property.cache(m, generation);
+      return P::value(m);
+    }
+
+  private:
+    P &property;
+    typename P::Type value;
+    unsigned int generation;
+    bool cached;
+  };
+
+  /** \brief Wait until a number of milliseconds have passed
+   * \ingroup coroutines
+   */
+  class SleepAwaiter : public Timer
+  {
+  public:
+    SleepAwaiter (Connection *y, unsigned long msec_) : Timer(y), msec(msec_) {}
+
+    bool await_ready () const {return false;}
+    void await_suspend (std::coroutine_handle<> h) {handle = h; set(msec);}
+    void await_resume () {}
+
+  protected:
+    /* Timer calls this last, as resuming may well delete us */
+    virtual void onTick () {handle.resume();}
+
+  private:
+    unsigned long msec;
+    std::coroutine_handle<> handle;
+  };
+
+  /** \brief Wait until a file descriptor is readable
+   * \ingroup coroutines
+   *
+   * The descriptor is registered with the connection while waiting,
+   * so it mustn't be registered already.
+   */
+  class ReadableAwaiter
+  {
+  public:
+    ReadableAwaiter (Connection *y_, int fd_) : y(y_), fd(fd_) {}
+
+    bool await_ready () const {return false;}
+
+    void await_suspend (std::coroutine_handle<> h)
+    {
+      handle = h;
+      y->registerFD(fd, Y_LISTEN_READ, this, &readable);
+    }
+
+    void await_resume () {}
+
+  private:
+    static void readable (int fd, int mask, void *data)
+    {
+      ReadableAwaiter *self = static_cast<ReadableAwaiter *>(data);
+      self->y->unregisterFD(fd);
+      self->handle.resume();
+    }
+
+    Connection *y;
+    int fd;
+    std::coroutine_handle<> handle;
+  };
+
+  /** co_await the reply to a method invocation, such as
+   * Y::Class::invokeMethod */
+  inline ReplyAwaiter reply (Reply *r) {return ReplyAwaiter(r);}
+  /** co_await the value of a property of an object */
+  template <class P>
+  inline PropertyAwaiter<P> get (P &property) {return PropertyAwaiter<P>(property);}
+  inline SleepAwaiter sleep (Connection *y, unsigned long msec) {return SleepAwaiter(y, msec);}
+  inline ReadableAwaiter readable (Connection *y, int fd) {return ReadableAwaiter(y, fd);}
+}
+
+#endif
+
+/* arch-tag: 0e6f3b57-2c84-4d19-9a7e-5bd1c83f60a4
+ */
@@ -34,7 +34,16 @@ Y::GridLayout::addWidget (Widget *child, int x, int y, int w, int h)
 {
   if (child != NULL)
     {
-      invokeMethod ("addWidget", child->id(), x, y, w, h, false);
+      Y::Message::Members v;
+      v.push_back("addWidget");
+      v.push_back(0u);
+      v.push_back(x);
+      v.push_back(y);
+      v.push_back(w);
+      v.push_back(h);
+      ObjectReferences references;
+      references[1] = child;
+      invokeMethod (v, references, false);
       child->parent = this;
     }
 }
@@ -44,7 +53,12 @@ Y::GridLayout::removeWidget (Widget *child)
 {
   if (child != NULL && child->parent == this)
     {
-      invokeMethod ("removeWidget", child->id(), false);
+      Y::Message::Members v;
+      v.push_back("removeWidget");
+      v.push_back(0u);
+      ObjectReferences references;
+      references[1] = child;
+      invokeMethod (v, references, false);
       child->parent = NULL;
     }
 }
@@ -29,9 +29,18 @@ Y::Menu::Menu (Y::Connection *y) : Widget(y, "Menu")
 void
 Y::Menu::addItem (int id, const std::string &text, Menu *submenu)
 {
-  invokeMethod("addItem", id, text, (submenu == NULL ? 0 : submenu -> id()));
+  Y::Message::Members v;
+  v.push_back("addItem");
+  v.push_back(id);
+  v.push_back(text);
+  v.push_back(0u);
+  ObjectReferences references;
   if (submenu != NULL)
-    submenu->parent = this;
+    {
+      references[3] = submenu;
+      submenu->parent = this;
+    }
+  invokeMethod(v, references, false);
 }
 
 Y::Menu::~Menu ()
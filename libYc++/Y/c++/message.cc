@@ -25,6 +25,9 @@
 #include <Y/c++/connection.h>
 #include <Y/c++/message.h>
 
+#include <cstdlib>
+#include <cstring>
+
 #include <unistd.h>
 #include <netinet/in.h>
 #include <assert.h>
@@ -43,82 +46,72 @@ Y::Message::nextSeq()
 Y::Message*
 Y::Message::parseStream(std::string& buffer)
 {
-  uint32_t npacket_len;
-  if (buffer.length() < sizeof(npacket_len))
-    return NULL;
+  size_t offset = 0;
+  Message *m = parseStream(buffer, offset);
+  if (m != NULL)
+    buffer.erase(0, offset);
+  return m;
+}
 
-  buffer.copy((char *)&npacket_len, sizeof(npacket_len));
-  uint32_t packet_len = ntohl(npacket_len);
-  if (buffer.length() < packet_len)
+/* Read a network order word from an unaligned position */
+static inline uint32_t
+read_uint32(const char *p)
+{
+  uint32_t n;
+  memcpy(&n, p, sizeof(n));
+  return ntohl(n);
+}
+
+Y::Message*
+Y::Message::parseStream(const std::string& buffer, size_t& offset)
+{
+  if (buffer.length() - offset < sizeof(uint32_t))
     return NULL;
 
-  std::string packet = buffer.substr(sizeof(npacket_len), packet_len);
-  buffer.erase(0, sizeof(npacket_len));
-  buffer.erase(0, packet_len);
+  const char *p = buffer.data() + offset;
+  uint32_t packet_len = read_uint32(p);
+  if (buffer.length() - offset - sizeof(uint32_t) < packet_len)
+    return NULL;
 
-  return new Y::Message::Message(packet);
+  Message *m = new Y::Message(p + sizeof(uint32_t), packet_len);
+  offset += sizeof(uint32_t) + packet_len;
+  return m;
 }
 
-/* Most annoyingly, std::string::copy only throws an exception if idx
- * is past the end; if I want to check len, I must check the return
- * value.
- */
-static inline std::string::size_type
-safe_copy(const std::string& str, char *buf, std::string::size_type len, std::string::size_type idx)
-  throw(std::out_of_range)
+Y::Message::Message (const char *data, size_t length)
 {
-  std::string::size_type copied = str.copy(buf, len, idx);
-  if (copied < len)
-    throw std::out_of_range("Y::Message/safe_copy(std::string&, ...)");
-  return copied;
-}
+  const uint32_t header_words = 7;
+  if (length < header_words * sizeof(uint32_t))
+    throw std::out_of_range("Y::Message::Message(const char *, size_t) (header not all present)");
 
-#define do_safe_copy(B, S, P) safe_copy((B), (char*)&(S), sizeof(S), (P))
+  v.seq = read_uint32(data);
+  v.to = read_uint32(data + 4);
+  v.from = read_uint32(data + 8);
+  v.op = read_uint32(data + 12);
+  v.id = read_uint32(data + 16);
+  v.meta = read_uint32(data + 20);
+  uint32_t members = read_uint32(data + 24);
 
-Y::Message::Message (const std::string& buffer)
-{
-  uint32_t nto;
-  uint32_t nfrom;
-  uint32_t nid;
-  uint32_t nop;
-  uint32_t nmeta;
-  uint32_t nseq;
-  uint32_t nmembers, members;
-
-  size_t pos = 0;
-
-  pos += do_safe_copy(buffer, nseq, pos);
-  pos += do_safe_copy(buffer, nto, pos);
-  pos += do_safe_copy(buffer, nfrom, pos);
-  pos += do_safe_copy(buffer, nop, pos);
-  pos += do_safe_copy(buffer, nid, pos);
-  pos += do_safe_copy(buffer, nmeta, pos);
-  pos += do_safe_copy(buffer, nmembers, pos);
-
-  members = ntohl(nmembers);
-  v.seq = ntohl(nseq);
-  v.to = ntohl(nto);
-  v.from = ntohl(nfrom);
-  v.id = ntohl(nid);
-  v.op = ntohl(nop);
-  v.meta = ntohl(nmeta);
+  size_t pos = header_words * sizeof(uint32_t);
+
+  /* every member takes at least its length word */
+  if (members <= (length - pos) / sizeof(uint32_t))
+    v.tuple.reserve(members);
 
   for (uint32_t i = 0; i < members; i++)
     {
-      uint32_t nvlen;
-      pos += do_safe_copy(buffer, nvlen, pos);
-      uint32_t vlen = ntohl(nvlen);
-      std::string vstr = buffer.substr(pos, vlen);
+      if (length - pos < sizeof(uint32_t))
+        throw std::out_of_range("Y::Message::Message(const char *, size_t) (member not all present)");
+      uint32_t vlen = read_uint32(data + pos);
+      pos += sizeof(uint32_t);
+      if (length - pos < vlen)
+        throw std::out_of_range("Y::Message::Message(const char *, size_t) (member not all present)");
+      v.tuple.push_back(Message::Member::parse(data + pos, vlen));
       pos += vlen;
-      if (buffer.length() < pos)
-        throw std::out_of_range("Y::Message::Message(const std::string&) (member not all present)");
-      v.tuple.push_back(Message::Member::parse(vstr));
     }
 
-  assert(pos <= buffer.length());
-
-  if (pos != buffer.length())
-    throw std::out_of_range("Y::Message::Message(const std::string&) (too much data at end of packet)");
+  if (pos != length)
+    throw std::out_of_range("Y::Message::Message(const char *, size_t) (too much data at end of packet)");
 }
 
 void
@@ -150,28 +143,27 @@ Y::Message::serialise(std::string& buffer) const
 }
 
 Y::Message::Member
-Y::Message::Member::parse(const std::string& buffer)
+Y::Message::Member::parse(const char *data, size_t length)
 {
-  uint32_t ntype;
-
-  size_t pos = 0;
+  if (length < sizeof(uint32_t))
+    throw std::out_of_range("Y::Message::Member::parse (no type)");
 
-  pos += do_safe_copy(buffer, ntype, pos);
-
-  enum memberType type = static_cast<enum memberType>(ntohl(ntype));
+  enum memberType type = static_cast<enum memberType>(read_uint32(data));
+  data += sizeof(uint32_t);
+  length -= sizeof(uint32_t);
 
   switch(type)
     {
     case t_string:
-      return Member(buffer.substr(pos));
+      return Member(std::string(data, length));
     case t_uint32:
-      uint32_t nuint32;
-      pos += do_safe_copy(buffer, nuint32, pos);
-      return Member(static_cast<uint32_t>(htonl(nuint32)));
+      if (length < sizeof(uint32_t))
+        throw std::out_of_range("Y::Message::Member::parse (short uint32)");
+      return Member(static_cast<uint32_t>(read_uint32(data)));
     case t_int32:
-      int32_t nint32;
-      pos += do_safe_copy(buffer, nint32, pos);
-      return Member(static_cast<int32_t>(htonl(nint32)));
+      if (length < sizeof(int32_t))
+        throw std::out_of_range("Y::Message::Member::parse (short int32)");
+      return Member(static_cast<int32_t>(read_uint32(data)));
     default:
       abort();
     }
@@ -221,6 +213,7 @@ Y::Message::expectReply() const
       return false;
       /* Messages that expect a reply */
     case YMO_FIND_CLASS:
+    case YMO_FIND_ATOM:
       return true;
       /* Messages that might do either, so we need to peek inside them */
     case YMO_INVOKE_CLASS_METHOD:
@@ -256,6 +249,9 @@ operator<< (std::ostream& strm, enum YMessageOperation op)
     case YMO_INVOKE_INSTANCE_METHOD:
       strm << "YMO_INVOKE_INSTANCE_METHOD";
       break;
+    case YMO_FIND_ATOM:
+      strm << "YMO_FIND_ATOM";
+      break;
     default:
       strm << (int)op;
       break;
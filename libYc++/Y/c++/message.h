@@ -34,6 +34,8 @@ namespace Y
    */
   class Message
   {
+    friend class Connection;
+
   public:
     /** \brief Value in a tuple
      */
@@ -63,7 +65,7 @@ namespace Y
       void serialise(std::string& buffer) const;
 
     private:
-      static Member parse(const std::string &str);
+      static Member parse(const char *data, size_t length);
 
       enum memberType type_v;
       std::string s_v;
@@ -81,6 +83,11 @@ namespace Y
     
     /* This is for parsing received messages */
     static Message* parseStream(std::string &str);
+    /* As above, but parse the message starting at offset and move
+     * offset past it, leaving the buffer alone.  Parsing a whole
+     * backlog this way copies each byte once, into the members.
+     */
+    static Message* parseStream(const std::string &str, size_t &offset);
 
     /* This is for creating messages to send */
     Message (uint32_t to_, uint32_t from_, uint32_t id_, enum YMessageOperation op_, uint32_t meta_,
@@ -107,7 +114,7 @@ namespace Y
     const Members& tuple () const {return v.tuple;}
 
   private:
-    Message (const std::string& buffer);
+    Message (const char *data, size_t length);
 
     static uint32_t nextSeq();
 
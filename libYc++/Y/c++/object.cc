@@ -23,6 +23,8 @@
 
 #include <string>
 
+#include "thread_support.h"
+
 /** \defgroup remote Remote objects
  *
  * Each local object corresponds to one on the server, and provides an
@@ -33,36 +35,64 @@
  *
  * \note This is not a conventional RPC system. Most methods are
  * dispatched asynchronously, and results are accessed via a Y::Reply
- * object. All object constructors return asynchronously, but most
- * further operations on the object will block until it has been
- * constructed on the server.
+ * object. All object constructors return asynchronously, and methods
+ * invoked on an object, or passing it, before it has been constructed
+ * on the server are sent once it has been. Only asking for its id, or
+ * waiting for a reply, blocks.
  */
 
 Y::Object::Object (Y::Connection *y_, std::string className)
-  : y(y_), createReply(NULL), c_v(y->findClass(className)), id_v(0)
+  : y(y_), c_v(y->findClass(className)), id_v(0), created(false), failed(false),
+    watching(false)
 {
-  createReply = c()->instantiate();
+  pthread_mutex_init(&created_mutex, NULL);
+  pthread_cond_init(&created_cond, NULL);
+  pthread_mutex_init(&watching_mutex, NULL);
+  pthread_mutex_init(&properties_mutex, NULL);
+
+  Reply *createReply = c()->instantiate();
+  if (createReply)
+    createReply->onReply(&createdCallback, this);
+  else
+    created = true;
 }
 
 Y::Object::~Object ()
 {
   y->destroyObject(id());
-  delete createReply;
+  y->forgetHeld(this);
 }
 
-uint32_t
-Y::Object::id () throw(Y::error)
+void
+Y::Object::createdCallback (Reply *reply, void *data)
 {
-  if (createReply)
+  Object *o = static_cast<Object *>(data);
+  Connection *y = o->y;
+  int oldtype;
+  lock_mutex(o->created_mutex, oldtype);
+  if (reply->op() == YMO_ERROR)
     {
-      if (createReply->op() == YMO_ERROR)
-        throw error(createReply->tuple());
-      Y::Message::Members res = createReply->tuple();
-      id_v = res[0].uint32();
-      delete createReply;
-      createReply = NULL;
-      y->createdObject(this);
+      o->failed = true;
+      o->error_v = reply->tuple();
     }
+  else
+    o->id_v = reply->tuple().at(0).uint32();
+  if (!o->failed)
+    y->createdObject(o);
+  __atomic_store_n(&o->created, true, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&o->created_cond);
+  unlock_mutex(oldtype);
+
+  /* and send whatever was waiting for it */
+  y->releaseHeld();
+}
+
+uint32_t
+Y::Object::id ()
+{
+  y->waitFor(created, created_mutex, created_cond);
+  if (failed)
+    throw error(error_v);
   return id_v;
 }
 
@@ -72,12 +102,145 @@ Y::Object::subscribeSignal (const std::string &name)
   invokeMethod("subscribeSignal", name, false);
 }
 
+void
+Y::Object::watchProperties ()
+{
+  if (__atomic_load_n(&watching, __ATOMIC_ACQUIRE))
+    return;
+
+  /* Nothing may be read until the subscription has been sent, or a
+   * change made in between would never be heard about. */
+  int oldtype;
+  lock_mutex(watching_mutex, oldtype);
+  if (!watching)
+    {
+      subscribeSignal("propertyChanged");
+      __atomic_store_n(&watching, true, __ATOMIC_RELEASE);
+    }
+  unlock_mutex(oldtype);
+}
+
+bool
+Y::Object::cachedProperty (const std::string &name, Message::Members &value,
+                           unsigned int &generation)
+{
+  watchProperties();
+
+  bool found;
+  int oldtype;
+  lock_mutex(properties_mutex, oldtype);
+  CachedProperty &p = properties[name];
+  found = p.valid;
+  if (found)
+    value = p.value;
+  generation = p.generation;
+  unlock_mutex(oldtype);
+  return found;
+}
+
+void
+Y::Object::cacheProperty (const std::string &name, const Message::Members &value,
+                          unsigned int generation)
+{
+  int oldtype;
+  lock_mutex(properties_mutex, oldtype);
+  CachedProperty &p = properties[name];
+  /* A change we have heard about since the request was sent may be
+   * newer than the reply, and one of ours still on its way certainly
+   * is */
+  if (p.generation == generation && p.pending == 0)
+    {
+      p.valid = true;
+      p.value = value;
+    }
+  unlock_mutex(oldtype);
+}
+
+void
+Y::Object::setProperty (const std::string &name, const Message::Member &value)
+{
+  if (__atomic_load_n(&watching, __ATOMIC_ACQUIRE))
+    {
+      /* The server will tell us when it has the new value.  If it
+       * refuses it we never hear, and the property just stays
+       * uncached. */
+      int oldtype;
+      lock_mutex(properties_mutex, oldtype);
+      CachedProperty &p = properties[name];
+      p.valid = false;
+      ++p.generation;
+      ++p.pending;
+      unlock_mutex(oldtype);
+    }
+
+  Y::Message::Members v;
+  v.push_back("setProperty");
+  v.push_back(name);
+  v.push_back(value);
+  invokeMethod(v, false);
+}
+
+void
+Y::Object::propertyChanged (const Message::Members &params)
+{
+  /* (name, whether we changed it, new value), with no value if it
+   * was unset */
+  if (params.size() < 2 || !params[0].isstring())
+    return;
+
+  int oldtype;
+  lock_mutex(properties_mutex, oldtype);
+  CachedProperty &p = properties[params[0].string()];
+  bool current = true;
+  if (params[1].uint32() && p.pending > 0)
+    --p.pending;
+  else if (p.pending > 0)
+    /* from before our own change reached the server */
+    current = false;
+  if (current)
+    {
+      ++p.generation;
+      p.valid = p.pending == 0 && params.size() > 2;
+      if (p.valid)
+        p.value.assign(params.begin() + 2, params.begin() + 3);
+    }
+  unlock_mutex(oldtype);
+}
+
 Y::Reply*
 Y::Object::invokeMethod (const Y::Message::Members& params, bool expectReturn)
 {
-  Message req(0, 0, id(), YMO_INVOKE_INSTANCE_METHOD, expectReturn ? 0x01 : 0x00, params);
+  Y::Message::Members v(params);
+  if (!v.empty() && v[0].isstring())
+    v[0] = y->methodName(v[0].string());
+  Message req(0, 0, 0, YMO_INVOKE_INSTANCE_METHOD, expectReturn ? 0x01 : 0x00, v);
+
+  return y->sendMessage (&req, -1, true, NULL, this, ObjectReferences());
+}
+
+Y::Reply*
+Y::Object::invokeMethodWithFD (const Y::Message::Members& params, int fd,
+                               bool expectReturn)
+{
+  Y::Message::Members v(params);
+  if (!v.empty() && v[0].isstring())
+    v[0] = y->methodName(v[0].string());
+  Message req(0, 0, 0, YMO_INVOKE_INSTANCE_METHOD, expectReturn ? 0x01 : 0x00, v);
 
-  return y->sendMessage (&req);
+  return y->sendMessage (&req, fd, true, NULL, this, ObjectReferences());
+}
+
+Y::Reply*
+Y::Object::invokeMethod (const Y::Message::Members& params,
+                         const ObjectReferences& references,
+                         bool expectReturn)
+{
+  Y::Message::Members v(params);
+  if (!v.empty() && v[0].isstring())
+    v[0] = y->methodName(v[0].string());
+  Message req(0, 0, 0, YMO_INVOKE_INSTANCE_METHOD, expectReturn ? 0x01 : 0x00, v);
+
+  return y->sendMessage (&req, -1, true, NULL, this, references);
 }
 
 Y::Reply*
@@ -170,5 +333,12 @@ Y::Object::Property<std::string>::Value::getValue(const Y::Message::Members& m)
   return m.at(0).string();
 }
 
+template <>
+uint32_t
+Y::Object::Property<uint32_t>::Value::getValue(const Y::Message::Members& m)
+{
+  return m.at(0).uint32();
+}
+
 /* arch-tag: fc2ef8c6-795a-484e-8b3a-73d63112d415
  */
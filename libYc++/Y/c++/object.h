@@ -26,6 +26,7 @@
 
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include <sigc++/sigc++.h>
 
@@ -43,6 +44,14 @@ namespace Y
    * Every remote object should inherit from this class, and construct
    * it with the object's class name. It will then construct the
    * object on the server, asynchronously.
+   *
+   * Methods may be invoked on it straight away.  Until the server has
+   * told us its id, they are held back by the connection, so nothing
+   * waits for the server unless it needs an answer from it.
+   *
+   * Once any of its properties has been read, the object subscribes
+   * to the server's propertyChanged events for it, and keeps the
+   * values it has seen, so reading them again needs no round trip.
    */
   class Object : public SigC::Object
   {
@@ -61,12 +70,15 @@ namespace Y
     public:
       Property(Object* o_, std::string n_) : o(o_), n(n_) {}
 
+      typedef T Type;
+
       /** \brief Remote property value
        * \ingroup remote
        *
        * A template thunk around a Y::Reply object; it behaves like
        * Y::Reply, but converts the reply tuple into the relevant type
-       * for the property.
+       * for the property.  If the value was cached there is no reply,
+       * and it is available straight away.
        */
       class Value
       {
@@ -74,23 +86,29 @@ namespace Y
       public:
         virtual ~Value ();
 
-        bool hasValue() const {return rep->hasTuple();}
+        bool hasValue() const {return rep == NULL || rep->hasTuple();}
         T value()
         {
           if (rep)
             {
               v = getValue(rep->tuple());
+              if (rep->op() != YMO_ERROR)
+                p->cache(rep->tuple(), generation);
               delete rep;
               rep = NULL;
             }
           return v;
         }
       private:
-        Value(Reply *rep_) : rep(rep_) {}
+        Value(Reply *rep_, Property *p_, unsigned int generation_)
+          : rep(rep_), p(p_), generation(generation_) {}
+        Value(const T& v_) : rep(NULL), p(NULL), generation(0), v(v_) {}
 
         static T getValue(const Message::Members& m);
 
         Reply* rep;
+        Property* p;
+        unsigned int generation;
         T v;
       };
 
@@ -98,6 +116,17 @@ namespace Y
       std::string name() const {return n;}
       void set(const T value);
       Value* get();
+      /* As get(), but the reply is left to the caller to wait for as
+       * it likes; value() converts its tuple.  This always asks the
+       * server. */
+      Reply* getReply();
+      static T value(const Message::Members& m) {return Value::getValue(m);}
+
+      /* The cached value, if there is one.  If not, pass generation to
+       * cache() along with the server's answer to a getReply() sent
+       * afterwards. */
+      bool lookup(T& value, unsigned int& generation);
+      void cache(const Message::Members& value, unsigned int generation);
 
     private:
       Object* o;
@@ -108,7 +137,8 @@ namespace Y
     virtual ~Object ();
 
     Class *c () const {return c_v;}
-    uint32_t id () throw(Y::error);
+    /* Throws Y::error if the server couldn't construct it */
+    uint32_t id ();
 
     void subscribeSignal (const std::string &name);
 
@@ -123,6 +153,13 @@ namespace Y
     virtual bool onEvent (const std::string &, const Y::Message::Members&) = 0;
 
     Reply* invokeMethod (const Y::Message::Members& params, bool expectReturn);
+    Reply* invokeMethodWithFD (const Y::Message::Members& params, int fd,
+                               bool expectReturn);
+    /* As above, where the arguments in references name other objects;
+     * their ids are filled in, whether or not they are known yet. */
+    Reply* invokeMethod (const Y::Message::Members& params,
+                         const ObjectReferences& references,
+                         bool expectReturn);
     Reply* invokeMethod (const std::string& name,
                          bool expectReturn);
     Reply* invokeMethod (const std::string& name,
@@ -152,10 +189,49 @@ namespace Y
                          bool expectReturn);
 
   private:
-    Reply *createReply;
+    static void createdCallback (Reply *reply, void *data);
+
+    /* The property cache, for Property; these take the values as
+     * tuples so that they work for every type */
+    void watchProperties ();
+    bool cachedProperty (const std::string &name, Message::Members &value,
+                         unsigned int &generation);
+    void cacheProperty (const std::string &name, const Message::Members &value,
+                        unsigned int generation);
+    void setProperty (const std::string &name, const Message::Member &value);
+    /* a propertyChanged event from the server */
+    void propertyChanged (const Message::Members &params);
 
     Class *c_v;
     uint32_t id_v;
+
+    /* set once the server has answered the constructor; if it failed,
+     * error_v holds what it said */
+    bool created;
+    bool failed;
+    Y::Message::Members error_v;
+    pthread_mutex_t created_mutex;
+    pthread_cond_t created_cond;
+
+    struct CachedProperty
+    {
+      CachedProperty () : valid(false), generation(0), pending(0) {}
+
+      bool valid;
+      Message::Members value;
+      /* bumped by every change, so that a reply which raced with one
+       * isn't cached */
+      unsigned int generation;
+      /* our own sets that the server hasn't told us about yet; until
+       * it has, any other change it tells us about is older */
+      unsigned int pending;
+    };
+
+    /* set once we have subscribed to propertyChanged */
+    bool watching;
+    pthread_mutex_t watching_mutex;
+    std::map<std::string, CachedProperty> properties;
+    pthread_mutex_t properties_mutex;
   };
 }
 
@@ -163,21 +239,47 @@ template <class T>
 void
 Y::Object::Property<T>::set(const T value)
 {
-  Y::Message::Members v;
-  v.push_back("setProperty");
-  v.push_back(name());
-  v.push_back(value);
-  object()->invokeMethod(v, false);
+  object()->setProperty(name(), value);
 }
 
 template <class T>
 typename Y::Object::Property<T>::Value*
 Y::Object::Property<T>::get()
+{
+  T value = T();
+  unsigned int generation;
+  if (lookup(value, generation))
+    return new Value(value);
+  return new Value(getReply(), this, generation);
+}
+
+template <class T>
+Y::Reply*
+Y::Object::Property<T>::getReply()
 {
   Y::Message::Members v;
   v.push_back("getProperty");
   v.push_back(name());
-  return new Value(object()->invokeMethod(v, true));
+  return object()->invokeMethod(v, true);
+}
+
+template <class T>
+bool
+Y::Object::Property<T>::lookup(T& value, unsigned int& generation)
+{
+  Y::Message::Members v;
+  if (!object()->cachedProperty(name(), v, generation))
+    return false;
+  value = Value::getValue(v);
+  return true;
+}
+
+template <class T>
+void
+Y::Object::Property<T>::cache(const Message::Members& value,
+                              unsigned int generation)
+{
+  object()->cacheProperty(name(), value, generation);
 }
 
 template <class T>
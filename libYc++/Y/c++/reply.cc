@@ -56,27 +56,30 @@ Y::Reply::dispatch(Message* reply)
 void
 Y::Reply::wait()
 {
-  if (got_tuple)
-    return;
+  y->waitFor(got_tuple, got_tuple_mutex, got_tuple_cond);
+}
 
-  bool use_threads;
+void
+Y::Reply::onReply(Callback callback_, void *data)
+{
+  /* the connection looks for a callback under replies_mutex, and
+   * dispatches replies without one before letting go of it, so
+   * either it will see this callback or the reply is here already */
+  bool arrived;
   int oldtype;
-  lock_mutex(y->state_mutex, oldtype);
-  use_threads = y->state == Y::Connection::threaded;
-  unlock_mutex(oldtype);
-
-  if (use_threads)
+  lock_mutex(y->replies_mutex, oldtype);
+  arrived = got_tuple;
+  if (!arrived)
     {
-      int oldtype;
-      lock_mutex(got_tuple_mutex, oldtype);
-      while (!got_tuple)
-        pthread_cond_wait(&got_tuple_cond, &got_tuple_mutex);
-      unlock_mutex(oldtype);
+      callback = callback_;
+      callback_data = data;
     }
-  else
+  unlock_mutex(oldtype);
+
+  if (arrived)
     {
-      while (!got_tuple)
-        y->poll(10);
+      callback_(this, data);
+      delete this;
     }
 }
 
@@ -35,12 +35,18 @@ namespace Y
 
   /** \brief %Message reply thunk
    * \ingroup comm
+   *
+   * A reply can be waited for, by asking for its contents, or handed
+   * a callback to be called when it arrives, so that any number of
+   * requests can be outstanding at once.
    */
   class Reply
   {
     friend class Connection;
 
   public:
+    typedef void (*Callback)(Reply *reply, void *data);
+
     virtual ~Reply();
 
     const Y::Message::Members& tuple() {wait(); return v.tuple;}
@@ -49,8 +55,17 @@ namespace Y
     enum YMessageOperation op() {wait(); return v.op;}
     bool hasTuple() const {return got_tuple;}
 
+    /* Call callback with the reply when it arrives, or at once if it
+     * already has.  It is called by whoever dispatches messages: the
+     * dispatch thread of a threaded connection, or else whoever calls
+     * run() or poll().  From then on the reply belongs to the
+     * connection, which deletes it after the callback returns.
+     */
+    void onReply(Callback callback, void *data);
+
   private:
-    Reply(Connection *y_, uint32_t seq_) : y(y_), seq(seq_), got_tuple(false)
+    Reply(Connection *y_, uint32_t seq_)
+      : y(y_), seq(seq_), got_tuple(false), callback(NULL), callback_data(NULL)
       {
         pthread_mutex_init(&got_tuple_mutex, NULL);
         pthread_cond_init(&got_tuple_cond, NULL);
@@ -66,6 +81,10 @@ namespace Y
     pthread_mutex_t got_tuple_mutex;
     pthread_cond_t got_tuple_cond;
 
+    /* protected by the connection's replies_mutex */
+    Callback callback;
+    void *callback_data;
+
     struct
     {
       enum YMessageOperation op;
@@ -0,0 +1,79 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+
+namespace Y
+{
+  /* A fixed size ring buffer for passing values from exactly one
+   * producer thread to exactly one consumer thread without locking.
+   * Each index is only ever written by one side, and is published
+   * with release semantics after the slot it covers is filled or
+   * emptied.  Size must be a power of two.
+   */
+  template <class T, size_t Size>
+  class SpscRing
+  {
+  public:
+    SpscRing () : head(0), tail(0) {}
+
+    /* Producer only.  Returns false if the ring is full. */
+    bool push (const T &value)
+    {
+      size_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+      if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == Size)
+        return false;
+      slots[t & (Size - 1)] = value;
+      __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+
+    /* Consumer only.  Returns false if the ring is empty. */
+    bool pop (T &value)
+    {
+      size_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+      if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+        return false;
+      value = slots[h & (Size - 1)];
+      __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+
+    /* Either side; only a hint while the other side is running */
+    bool full () const
+    {
+      return __atomic_load_n(&tail, __ATOMIC_ACQUIRE)
+           - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == Size;
+    }
+
+  private:
+    T slots[Size];
+    /* keep the two sides' indices on separate cache lines */
+    size_t head;
+    char pad[64 - sizeof(size_t)];
+    size_t tail;
+  };
+}
+
+#endif
+
+/* arch-tag: 4b9e07c2-1d6a-4f35-a8e3-92c5f0d7b614
+ */
@@ -29,8 +29,9 @@ Y::Timer::doTick ()
 {
   delete e;
   e = NULL;
-  onTick();
   tick();
+  /* last, so that it may delete the timer */
+  onTick();
 }
 
 void
@@ -46,6 +47,7 @@ Y::Timer::cancel ()
 {
   if (e)
     y->unsetTimer(e);
+  e = NULL;
 }
 
 Y::Timer::~Timer ()
@@ -50,6 +50,8 @@ namespace Y
 
     /** Signalled when the timer has elapsed */
     SigC::Signal0<void> tick;
+    /** Called after tick has been signalled; the timer may be deleted
+     * by the time it returns */
     virtual void onTick ();
 
   private:
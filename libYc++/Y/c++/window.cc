@@ -49,7 +49,12 @@ Y::Window::setChild (Widget *w)
 {
   if (w != NULL)
     {
-      invokeMethod ("setChild", w->id(), false);
+      Y::Message::Members v;
+      v.push_back("setChild");
+      v.push_back(0u);
+      ObjectReferences references;
+      references[1] = w;
+      invokeMethod (v, references, false);
       w->parent = this;
     }
 }
@@ -59,7 +64,12 @@ Y::Window::setFocussed (Widget *w)
 {
   if (w != NULL)
     {
-      invokeMethod ("setFocussed", w->id(), false);
+      Y::Message::Members v;
+      v.push_back("setFocussed");
+      v.push_back(0u);
+      ObjectReferences references;
+      references[1] = w;
+      invokeMethod (v, references, false);
     }
 }
 
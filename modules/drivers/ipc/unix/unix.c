@@ -42,6 +42,13 @@
 
 #define MESSAGE_HEADER_SIZE (4 * 8)
 
+/* the most file descriptors accepted with one read */
+#define UNIX_MAX_FDS 16
+/* How much to read from a client at once */
+#define UNIX_READ_SIZE 65536
+/* Most pieces of a buffer to read or write in one call */
+#define UNIX_MAX_IOVECS 32
+
 struct UnixData
 {
   char *path;
@@ -89,40 +96,69 @@ unixClose (struct Client *self_c)
   yfree (self);
 }
 
-static void
+/* Returns false if the client has been closed, and self freed */
+static bool
 doRead(struct UnixClient *self)
 {
-  char buf[4096];
-
-  ssize_t ret = read(self->fd, buf, sizeof(buf));
+  char control[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS)];
+  struct iovec iov[UNIX_MAX_IOVECS];
+  /* read straight into the free space at the end of the receive queue */
+  int iovcnt = dbuffer_reserve_iovec(self->client.recvq, UNIX_READ_SIZE,
+                                     iov, UNIX_MAX_IOVECS);
+  struct msghdr msg =
+    {
+      .msg_iov = iov,
+      .msg_iovlen = iovcnt,
+      .msg_control = control,
+      .msg_controllen = sizeof(control)
+    };
+
+  ssize_t ret = recvmsg(self->fd, &msg, MSG_CMSG_CLOEXEC);
+  dbuffer_commit(self->client.recvq, ret > 0 ? ret : 0);
   if (ret < 0)
     {
       int e = errno;
       if (e == EINTR || e == EAGAIN)
-        return;
-      Y_TRACE ("Read error from client %d: %s (%d)", clientGetID(&self->client), strerror(e), ret);
+        return true;
+      Y_TRACE ("Read error from client %d: %s (%zd)", clientGetID(&self->client), strerror(e), ret);
       clientClose (&(self -> client));
-      return;
+      return false;
     }
 
   if (ret == 0)
     {
       Y_TRACE ("Connection closed by client %d", clientGetID(&self->client));
       clientClose (&(self -> client));
-      return;
+      return false;
+    }
+
+  /* queue any file descriptors that came with the data before handling
+   * the messages that might use them; they belong to whichever message
+   * holds the last byte just read */
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+      int *fds = (int *)CMSG_DATA(cmsg);
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < count; ++i)
+        clientQueueFileDescriptor(&self->client, fds[i]);
     }
+  if (msg.msg_flags & MSG_CTRUNC)
+    Y_WARN ("Client %d passed more than %d file descriptors at once; "
+            "some were discarded", clientGetID(&self->client), UNIX_MAX_FDS);
 
-  dbuffer_add(self->client.recvq, buf, ret);
-  clientReadData(&self->client);
+  return clientReadData(&self->client);
 }
 
 static void
 doWrite(struct UnixClient *self)
 {
-  char buf[4096];
-  size_t len = dbuffer_get(self->client.sendq, buf, sizeof(buf));
+  struct iovec iov[UNIX_MAX_IOVECS];
+  int iovcnt = dbuffer_get_iovec(self->client.sendq, iov, UNIX_MAX_IOVECS);
 
-  ssize_t ret = write(self->fd, buf, len);
+  ssize_t ret = writev(self->fd, iov, iovcnt);
   if (ret < 0)
     {
       int e = errno;
@@ -143,8 +179,8 @@ static void
 unixClientReady (int fd, int causeMask, void *data_v)
 {
   struct UnixClient *self = data_v;
-  if (causeMask & CONTROL_WATCH_READ)
-    doRead(self);
+  if ((causeMask & CONTROL_WATCH_READ) && !doRead(self))
+    return;
   if (causeMask & CONTROL_WATCH_WRITE)
     doWrite(self);
 }
@@ -78,6 +78,7 @@ struct FBDevVideoDriverData
   uint32_t *data;
   unsigned long dataOffset;
   struct Viewport *viewport;
+  struct SWBackBuffer *backBuffer;
   struct Index *modes;
   enum FBDevSwitchState switchState;
   int updating;
@@ -172,6 +173,32 @@ fbdevGetPixelDimensions (struct VideoDriver *self, int *x, int *y)
   *y = data -> vscreeninfo.yres;
 }
 
+static int
+fbdevGetRefreshRate (struct VideoDriver *self)
+{
+  struct FBDevVideoDriverData *data = self -> d;
+  const struct fb_var_screeninfo *v = &(data -> vscreeninfo);
+  uint64_t htotal = v -> left_margin + v -> xres + v -> right_margin
+                    + v -> hsync_len;
+  uint64_t vtotal = v -> upper_margin + v -> yres + v -> lower_margin
+                    + v -> vsync_len;
+
+  /* pixclock is the length of a pixel in picoseconds */
+  if (v -> pixclock == 0 || htotal == 0 || vtotal == 0)
+    return 0;
+  return (int)(UINT64_C(1000000000000) / (v -> pixclock * htotal * vtotal));
+}
+
+static int
+fbdevWaitForVSync (struct VideoDriver *self)
+{
+  struct FBDevVideoDriverData *data = self -> d;
+  __u32 crtc = 0;
+  if (ioctl (data -> fbfd, FBIO_WAITFORVSYNC, &crtc) < 0)
+    return -1;
+  return 0;
+}
+
 static void
 fbdevBeginUpdates (struct VideoDriver *self)
 {
@@ -183,6 +210,7 @@ static void
 fbdevEndUpdates (struct VideoDriver *self)
 {
   struct FBDevVideoDriverData *data = self -> d;
+  swbackbufferPresent (data -> backBuffer);
   if (data -> switchState == FBDEV_SWITCH_REQUEST_RELEASE)
     {
       fbdevReleaseConsole (self);
@@ -264,7 +292,7 @@ fbdevGetRenderer (struct VideoDriver *self, const struct Rectangle *rect)
   if (data -> renderSimply)
     return simplerendererGetRenderer (simplerendererCreate (self, rect)); 
   else
-    return swrendererGetRenderer (swrendererCreate (self, rect));
+    return swrendererGetRenderer (swrendererCreate (data -> backBuffer, rect));
 }
 
 static void
@@ -564,6 +592,7 @@ initialise (struct Module *module, const struct Tuple *args)
   const char *ttypath = NULL;
   const char *dbpath = NULL;
   const char *mode = NULL;
+  int vsync = 0;
 
   if (fbdevInstance != NULL)
     {
@@ -601,6 +630,8 @@ initialise (struct Module *module, const struct Tuple *args)
         dbpath = arg + 3;
       if (strncmp (arg, "mode=", 5) == 0)
         mode = arg + 5;
+      if (strcmp (arg, "vsync") == 0)
+        vsync = 1;
     }
 
   if (fbpath == NULL || strlen (fbpath) == 0)
@@ -837,9 +868,12 @@ initialise (struct Module *module, const struct Tuple *args)
   videodriver -> drawFilledRectangle = fbdevDrawFilledRectangle;
   videodriver -> blit                = fbdevBlit;  
   videodriver -> getRenderer         = fbdevGetRenderer;
+  videodriver -> getRefreshRate      = fbdevGetRefreshRate;
+  videodriver -> waitForVSync        = vsync ? fbdevWaitForVSync : NULL;
 
   module -> data = videodriver;
 
+  data -> backBuffer = swbackbufferCreate (videodriver);
   data -> viewport = viewportCreate (videodriver);
   screenRegisterViewport (data -> viewport);
 
@@ -857,6 +891,7 @@ finalise (struct Module *module)
 
   screenUnregisterViewport (data -> viewport);
   viewportDestroy (data -> viewport);
+  swbackbufferDestroy (data -> backBuffer);
   munmap (data -> data, data -> fscreeninfo.smem_len);
   if (ioctl (data -> fbfd, FBIOPUT_VSCREENINFO, &(data -> old_vscreeninfo)) < 0)
     Y_WARN ("Failed to restore screen settings: %s", strerror (errno));
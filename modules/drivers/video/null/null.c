@@ -0,0 +1,448 @@
+/************************************************************************
+ *   Copyright (C) Mark Thomas <markbt@efaref.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* A video driver with no display: everything is rendered into a
+ * framebuffer in memory.  This lets the server run, and be measured,
+ * on machines with no screen.
+ *
+ * Arguments:
+ *   res=WxH          size of the framebuffer (default 800x600)
+ *   dump=DIR         write every frame shown to DIR/frame-NNNNNN.ppm
+ *   format=png       ... or as PNG instead
+ *   checksums=FILE   append "frame checksum" to FILE for every frame
+ *
+ * Calls (through Screen.call):
+ *   update           render any damage now; returns (frames, checksum)
+ *   checksum         returns (frames, checksum) without rendering
+ *   dump FILE        write the framebuffer to FILE (.png or .ppm)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <png.h>
+#include <Y/message/tuple.h>
+#include <Y/modules/videodriver_interface.h>
+#include <Y/modules/module_interface.h>
+#include <Y/screen/viewport.h>
+#include <Y/screen/screen.h>
+#include <Y/screen/swrenderer.h>
+#include <Y/util/colour.h>
+#include <Y/util/yutil.h>
+#include <Y/util/log.h>
+
+struct NullVideoDriverData
+{
+  struct Viewport *viewport;
+  struct SWBackBuffer *backBuffer;
+  int width, height;
+  uint32_t *framebuffer;
+  struct VideoResolution curRes;
+
+  uint32_t frames;
+  char *dumpDir;
+  bool dumpPNG;
+  FILE *checksums;
+};
+
+static inline struct NullVideoDriverData *
+nullData (struct VideoDriver *self)
+{
+  return (struct NullVideoDriverData *)(self -> d);
+}
+
+/* Clip a rectangle, given by its corners, to the framebuffer; returns
+ * false if nothing is left */
+static bool
+nullClip (struct VideoDriver *self, int *x1, int *y1, int *x2, int *y2)
+{
+  *x1 = MAX (*x1, 0);
+  *y1 = MAX (*y1, 0);
+  *x2 = MIN (*x2, nullData (self) -> width);
+  *y2 = MIN (*y2, nullData (self) -> height);
+  return *x1 < *x2 && *y1 < *y2;
+}
+
+/* FNV-1a over the colour of every pixel; alpha is ignored as the
+ * screen is opaque */
+static uint32_t
+nullChecksum (struct NullVideoDriverData *data)
+{
+  uint32_t hash = 2166136261u;
+  int n = data -> width * data -> height;
+  for (int i = 0; i < n; ++i)
+    {
+      uint32_t pixel = data -> framebuffer[i];
+      for (int shift = 16; shift >= 0; shift -= 8)
+        {
+          hash ^= (pixel >> shift) & 0xFF;
+          hash *= 16777619u;
+        }
+    }
+  return hash;
+}
+
+/* Fill ROW with the RGB bytes of line Y of the framebuffer */
+static void
+nullGetRGBRow (struct NullVideoDriverData *data, int y, uint8_t *row)
+{
+  const uint32_t *line = data -> framebuffer + y * data -> width;
+  for (int x = 0; x < data -> width; ++x)
+    {
+      *row++ = (line[x] >> 16) & 0xFF;
+      *row++ = (line[x] >> 8) & 0xFF;
+      *row++ = line[x] & 0xFF;
+    }
+}
+
+static bool
+nullWritePPM (struct NullVideoDriverData *data, FILE *file)
+{
+  uint8_t row[data -> width * 3];
+  fprintf (file, "P6\n%d %d\n255\n", data -> width, data -> height);
+  for (int y = 0; y < data -> height; ++y)
+    {
+      nullGetRGBRow (data, y, row);
+      if (fwrite (row, sizeof (row), 1, file) != 1)
+        return false;
+    }
+  return true;
+}
+
+static bool
+nullWritePNG (struct NullVideoDriverData *data, FILE *file)
+{
+  png_structp png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING,
+    (png_voidp) NULL, NULL, NULL);
+  if (!png_ptr)
+    return false;
+
+  png_infop info_ptr = png_create_info_struct (png_ptr);
+  if (!info_ptr)
+    {
+      png_destroy_write_struct (&png_ptr, (png_infopp) NULL);
+      return false;
+    }
+
+  uint8_t *row = ymalloc (data -> width * 3);
+  if (setjmp (png_jmpbuf (png_ptr)))
+    {
+      png_destroy_write_struct (&png_ptr, &info_ptr);
+      yfree (row);
+      return false;
+    }
+
+  png_init_io (png_ptr, file);
+  png_set_IHDR (png_ptr, info_ptr, data -> width, data -> height, 8,
+                PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info (png_ptr, info_ptr);
+  for (int y = 0; y < data -> height; ++y)
+    {
+      nullGetRGBRow (data, y, row);
+      png_write_row (png_ptr, row);
+    }
+  png_write_end (png_ptr, info_ptr);
+  png_destroy_write_struct (&png_ptr, &info_ptr);
+  yfree (row);
+  return true;
+}
+
+static bool
+nullDump (struct NullVideoDriverData *data, const char *filename, bool png)
+{
+  FILE *file = fopen (filename, "wb");
+  if (file == NULL)
+    {
+      Y_ERROR ("null: can't open %s: %s", filename, strerror (errno));
+      return false;
+    }
+  bool ok = png ? nullWritePNG (data, file) : nullWritePPM (data, file);
+  if (fclose (file) != 0)
+    ok = false;
+  if (!ok)
+    Y_ERROR ("null: failed to write %s", filename);
+  return ok;
+}
+
+static void
+nullGetPixelDimensions (struct VideoDriver *self, int *x, int *y)
+{
+  *x = nullData (self) -> width;
+  *y = nullData (self) -> height;
+}
+
+static const char *
+nullGetName (struct VideoDriver *self)
+{
+  return self -> module -> name;
+}
+
+static struct llist *
+nullGetResolutions (struct VideoDriver *self)
+{
+  struct NullVideoDriverData *data = nullData (self);
+  struct llist *resolutions = new_llist ();
+  yfree (data -> curRes.name);
+  data -> curRes.name = ymalloc (50);
+  sprintf (data -> curRes.name, "%dx%d", data -> width, data -> height);
+  llist_add_tail (resolutions, &(data -> curRes));
+  return resolutions;
+}
+
+static void
+nullSetPointer (struct VideoDriver *self, const uint8_t *data, int width,
+                int height, int bpp, int hot_x, int hot_y)
+{
+  /* there is no pointer to draw */
+}
+
+static struct Tuple *
+nullSpecial (struct VideoDriver *self, const struct Tuple *args)
+{
+  struct NullVideoDriverData *data = nullData (self);
+
+  if (args->count < 1)
+    return NULL;
+  if (args->list[0].type != t_string)
+    return NULL;
+
+  const char *command = args->list[0].string.data;
+
+  if (strcasecmp (command, "update") == 0)
+    {
+      viewportUpdate (data -> viewport);
+      return tupleBuild (tb_uint32 (data -> frames),
+                         tb_uint32 (nullChecksum (data)));
+    }
+  if (strcasecmp (command, "checksum") == 0)
+    return tupleBuild (tb_uint32 (data -> frames),
+                       tb_uint32 (nullChecksum (data)));
+  if (strcasecmp (command, "dump") == 0)
+    {
+      if (args->count < 2 || args->list[1].type != t_string)
+        return tupleBuildError (tb_string ("dump needs a file name"));
+      const char *filename = args->list[1].string.data;
+      size_t len = strlen (filename);
+      bool png = len >= 4 && strcasecmp (filename + len - 4, ".png") == 0;
+      if (!nullDump (data, filename, png))
+        return tupleBuildError (tb_string ("Could not write the frame"));
+      return NULL;
+    }
+  return NULL;
+}
+
+static void
+nullBeginUpdates (struct VideoDriver *self)
+{
+}
+
+static void
+nullEndUpdates (struct VideoDriver *self)
+{
+  struct NullVideoDriverData *data = nullData (self);
+  swbackbufferPresent (data -> backBuffer);
+  data -> frames++;
+
+  if (data -> checksums != NULL)
+    {
+      fprintf (data -> checksums, "%u %08x\n", data -> frames,
+               nullChecksum (data));
+      fflush (data -> checksums);
+    }
+
+  if (data -> dumpDir != NULL)
+    {
+      char filename[strlen (data -> dumpDir) + 32];
+      snprintf (filename, sizeof (filename), "%s/frame-%06u.%s",
+                data -> dumpDir, data -> frames, data -> dumpPNG ? "png" : "ppm");
+      nullDump (data, filename, data -> dumpPNG);
+    }
+}
+
+static void
+nullDrawPixel (struct VideoDriver *self, uint32_t col, int x, int y)
+{
+  struct NullVideoDriverData *data = nullData (self);
+  if (x < 0 || y < 0 || x >= data -> width || y >= data -> height)
+    return;
+  uint32_t *p = data -> framebuffer + y * data -> width + x;
+  unsigned pixel;
+  colourBlendSourceOver (&pixel, *p << 8, col, 0xFF);
+  *p = pixel;
+}
+
+static void
+nullDrawFilledRectangle (struct VideoDriver *self, uint32_t colour,
+                         int x1, int y1, int x2, int y2)
+{
+  struct NullVideoDriverData *data = nullData (self);
+  if (!nullClip (self, &x1, &y1, &x2, &y2))
+    return;
+  for (int y = y1; y < y2; ++y)
+    {
+      uint32_t *p = data -> framebuffer + y * data -> width;
+      for (int x = x1; x < x2; ++x)
+        p[x] = colour;
+    }
+}
+
+static void
+nullDrawRectangle (struct VideoDriver *self, uint32_t colour,
+                   int x1, int y1, int x2, int y2)
+{
+  nullDrawFilledRectangle (self, colour, x1, y1, x2, y1 + 1);
+  nullDrawFilledRectangle (self, colour, x1, y2, x2, y2 + 1);
+  nullDrawFilledRectangle (self, colour, x1, y1, x1 + 1, y2);
+  nullDrawFilledRectangle (self, colour, x2, y1, x2 + 1, y2);
+}
+
+static void
+nullBlit (struct VideoDriver *self, uint32_t *source,
+          int x, int y, int w, int h, int stepping)
+{
+  struct NullVideoDriverData *data = nullData (self);
+  int x1 = x, y1 = y, x2 = x + w, y2 = y + h;
+  if (!nullClip (self, &x1, &y1, &x2, &y2))
+    return;
+  for (int j = y1; j < y2; ++j)
+    memcpy (data -> framebuffer + j * data -> width + x1,
+            source + (j - y) * stepping + (x1 - x),
+            (x2 - x1) * sizeof (uint32_t));
+}
+
+static struct Renderer *
+nullGetRenderer (struct VideoDriver *self, const struct Rectangle *rect)
+{
+  struct Renderer *renderer = swrendererGetRenderer (swrendererCreate (
+    nullData (self) -> backBuffer, rect));
+  rendererSetOption (renderer, "hardware pointer", "yes");
+  return renderer;
+}
+
+int
+initialise (struct Module *module, const struct Tuple *args)
+{
+  struct VideoDriver *videodriver;
+  int width = 800;
+  int height = 600;
+  const char *dumpDir = NULL;
+  const char *checksums = NULL;
+  bool dumpPNG = false;
+
+  for (uint32_t i = 0; i < args->count; ++i)
+    {
+      if (args->list[i].type != t_string)
+        continue;
+
+      const char *arg = args->list[i].string.data;
+
+      if (strncmp (arg, "res=", 4) == 0)
+        {
+          const char *res = arg + 4;
+          const char *xloc = strchr (res, 'x');
+          if (xloc == NULL
+              || strtol (res, NULL, 0) <= 0 || strtol (xloc + 1, NULL, 0) <= 0)
+            Y_ERROR ("null: can't parse resolution string %s", res);
+          else
+            {
+              width = strtol (res, NULL, 0);
+              height = strtol (xloc + 1, NULL, 0);
+            }
+        }
+      else if (strncmp (arg, "dump=", 5) == 0)
+        dumpDir = arg + 5;
+      else if (strcmp (arg, "format=png") == 0)
+        dumpPNG = true;
+      else if (strcmp (arg, "format=ppm") == 0)
+        dumpPNG = false;
+      else if (strncmp (arg, "checksums=", 10) == 0)
+        checksums = arg + 10;
+      else
+        Y_ERROR ("null: unknown argument %s", arg);
+    }
+
+  videodriver = ymalloc (sizeof (struct VideoDriver));
+  videodriver -> d = ymalloc (sizeof (struct NullVideoDriverData));
+  videodriver -> module = module;
+
+  videodriver -> getPixelDimensions = nullGetPixelDimensions;
+  videodriver -> getName = nullGetName;
+  videodriver -> getResolutions = nullGetResolutions;
+  videodriver -> setResolution = NULL;
+  videodriver -> setPointer = nullSetPointer;
+  videodriver -> special = nullSpecial;
+  videodriver -> beginUpdates = nullBeginUpdates;
+  videodriver -> endUpdates = nullEndUpdates;
+  videodriver -> drawPixel = nullDrawPixel;
+  videodriver -> drawRectangle = nullDrawRectangle;
+  videodriver -> drawFilledRectangle = nullDrawFilledRectangle;
+  videodriver -> blit = nullBlit;
+  videodriver -> getRenderer = nullGetRenderer;
+  videodriver -> getRefreshRate = NULL;
+  videodriver -> waitForVSync = NULL;
+
+  static char moduleName[] = "Null Video Driver";
+  module -> name = moduleName;
+  module -> data = videodriver;
+
+  nullData (videodriver) -> width = width;
+  nullData (videodriver) -> height = height;
+  nullData (videodriver) -> framebuffer =
+    ymalloc (width * height * sizeof (uint32_t));
+  memset (nullData (videodriver) -> framebuffer, 0,
+          width * height * sizeof (uint32_t));
+  nullData (videodriver) -> curRes.name = NULL;
+  nullData (videodriver) -> frames = 0;
+  nullData (videodriver) -> dumpDir = dumpDir ? ystrdup (dumpDir) : NULL;
+  nullData (videodriver) -> dumpPNG = dumpPNG;
+  nullData (videodriver) -> checksums = NULL;
+  if (checksums != NULL)
+    {
+      nullData (videodriver) -> checksums = fopen (checksums, "a");
+      if (nullData (videodriver) -> checksums == NULL)
+        Y_ERROR ("null: can't open %s: %s", checksums, strerror (errno));
+    }
+  nullData (videodriver) -> backBuffer = swbackbufferCreate (videodriver);
+  nullData (videodriver) -> viewport = viewportCreate (videodriver);
+  screenRegisterViewport (nullData (videodriver) -> viewport);
+
+  return 0;
+}
+
+int
+finalise (struct Module *module)
+{
+  struct VideoDriver *videodriver = module -> data;
+  screenUnregisterViewport (nullData (videodriver) -> viewport);
+  viewportDestroy (nullData (videodriver) -> viewport);
+  swbackbufferDestroy (nullData (videodriver) -> backBuffer);
+  yfree (nullData (videodriver) -> curRes.name);
+  yfree (nullData (videodriver) -> dumpDir);
+  if (nullData (videodriver) -> checksums != NULL)
+    fclose (nullData (videodriver) -> checksums);
+  yfree (nullData (videodriver) -> framebuffer);
+  yfree (nullData (videodriver));
+  yfree (videodriver);
+  return 0;
+}
+
+/* arch-tag: 2a8e5f14-c7d3-4b96-a01e-9f63d8b2c475
+ */
@@ -50,6 +50,7 @@ struct SDLVideoDriverData
 {
   SDL_Surface *sdlSurface;
   struct Viewport *viewport;
+  struct SWBackBuffer *backBuffer;
   int pollingID;
   enum SDLRenderMode renderMode;
   uint32_t bufferContextID;
@@ -287,6 +288,7 @@ sdlBeginUpdates (struct VideoDriver *self)
 static void
 sdlEndUpdates (struct VideoDriver *self)
 {
+  swbackbufferPresent (sdlData (self) -> backBuffer);
   SDL_Flip (sdlData(self) -> sdlSurface);
 }
 
@@ -542,7 +544,8 @@ sdlGetRenderer (struct VideoDriver *self, const struct Rectangle *rect)
       renderer = simplerendererGetRenderer (simplerendererCreate (self, rect));
       break;
     case SDL_RENDERMODE_SOFTWARE_BLEND:
-      renderer = swrendererGetRenderer (swrendererCreate (self, rect));
+      renderer = swrendererGetRenderer (swrendererCreate (
+        sdlData (self) -> backBuffer, rect));
       break;
     case SDL_RENDERMODE_SDL_BLEND:
       renderer = hwrendererGetRenderer (hwrendererCreate (self, rect,
@@ -657,6 +660,8 @@ initialise (struct Module *module, const struct Tuple *args)
   videodriver -> drawFilledRectangle = sdlDrawFilledRectangle;
   videodriver -> blit = sdlBlit;  
   videodriver -> getRenderer = sdlGetRenderer;
+  videodriver -> getRefreshRate = NULL;
+  videodriver -> waitForVSync = NULL;
 
   static char moduleName[] = "SDL Video Driver";
   module -> name = moduleName;
@@ -667,6 +672,7 @@ initialise (struct Module *module, const struct Tuple *args)
   sdlData (videodriver) -> renderMode = renderMode;
   sdlData (videodriver) -> swcursor = swcursor;
   sdlData (videodriver) -> native_pointer = native_pointer;
+  sdlData (videodriver) -> backBuffer = swbackbufferCreate (videodriver);
   sdlData (videodriver) -> viewport = viewportCreate (videodriver);
   sdlData (videodriver) -> bufferContextID = bufferNewContextID ();
   sdlData (videodriver) -> bufferContexts = indexCreate (
@@ -690,6 +696,7 @@ finalise (struct Module *module)
   keyboardReset ();
   screenUnregisterViewport (sdlData (videodriver) -> viewport);
   viewportDestroy (sdlData (videodriver) -> viewport);
+  swbackbufferDestroy (sdlData (videodriver) -> backBuffer);
   controlCancelTimerDelay (sdlData (videodriver) -> pollingID);
   if (sdlData (videodriver) -> cursor)
     SDL_FreeCursor(sdlData (videodriver) -> cursor);
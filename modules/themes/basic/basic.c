@@ -41,6 +41,7 @@ static struct Theme basicTheme =
 
   windowInit:          basicWindowInit,
   windowPaint:         basicWindowPaint,
+  windowGetOpaqueRegion: basicWindowGetOpaqueRegion,
   windowGetRegion:     basicWindowGetRegion,
   windowPointerMotion: basicWindowPointerMotion,
   windowPointerButton: basicWindowPointerButton,
@@ -20,6 +20,7 @@
 #include <Y/widget/widget.h>
 #include <Y/object/object.h>
 #include <Y/screen/screen.h>
+#include <Y/util/region.h>
 #include <Y/text/font.h>
 #include <Y/modules/windowmanager.h>
 #include <Y/modules/theme.h>
@@ -181,6 +182,47 @@ basicWindowPaint (struct Window *window, struct Painter *painter)
     }
 }
 
+struct Region *
+basicWindowGetOpaqueRegion (struct Window *window)
+{
+  struct Rectangle *rect = widgetGetRectangle (windowToWidget (window));
+  const struct Value *bgcolourProperty = objectGetProperty (windowToObject (window), "background");
+  bool opaqueContent = bgcolourProperty == NULL
+                       || (bgcolourProperty->uint32 & 0xFF000000) == 0xFF000000;
+  struct Region *opaque = regionCreate ();
+  struct Rectangle title, content;
+
+  /* the title bar is always opaque; the content area is opaque when
+   * its background is, and the border only when the window is
+   * selected */
+  if (windowGetSizeState (window) == WINDOW_SIZE_NORMAL)
+    {
+      if (opaqueContent && wmSelectedWindow () == window)
+        {
+          struct Rectangle all = { 0, 0, rect -> w, rect -> h };
+          regionUnionRectangle (opaque, &all);
+          rectangleDestroy (rect);
+          return opaque;
+        }
+      title = (struct Rectangle) { 5, 5, rect -> w - 10, 18 };
+      content = (struct Rectangle) { 5, 23, rect -> w - 10, rect -> h - 28 };
+    }
+  else
+    {
+      /* maximised windows leave a gap under the title bar */
+      title = (struct Rectangle) { 0, 0, rect -> w, 19 };
+      content = (struct Rectangle) { 0, 20, rect -> w, rect -> h - 20 };
+    }
+
+  if (title.w > 0 && title.h > 0)
+    regionUnionRectangle (opaque, &title);
+  if (opaqueContent && content.w > 0 && content.h > 0)
+    regionUnionRectangle (opaque, &content);
+
+  rectangleDestroy (rect);
+  return opaque;
+}
+
 int
 basicWindowGetRegion (struct Window *window, int32_t x, int32_t y)
 {
@@ -24,6 +24,7 @@
 
 void basicWindowInit (struct Window *);
 void basicWindowPaint (struct Window *, struct Painter *);
+struct Region *basicWindowGetOpaqueRegion (struct Window *);
 int  basicWindowGetRegion (struct Window *, int32_t, int32_t);
 int  basicWindowPointerMotion (struct Window *, int32_t, int32_t, int32_t, int32_t);
 int  basicWindowPointerButton (struct Window *, int32_t, int32_t, uint32_t, bool);